@@ -0,0 +1,350 @@
+#ifndef CONCURRENT_DATA_STORE_H_
+#define CONCURRENT_DATA_STORE_H_
+
+#include "DataStore.h"
+#include "DataStoreReader.h"
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace rct {
+
+//!  Concurrent Data Store
+/*!
+ * Data store for many reader threads alongside concurrent writers.
+ * Published records are immutable and the record table is a directory of
+ * fixed size segments behind a single root pointer.  A reader copies the
+ * root once and sees a consistent snapshot for as long as it holds it; it
+ * never waits on a writer beyond that pointer copy.  Appends fill the next
+ * unpublished slot of the last segment in place.  Updates edit a private
+ * copy of the record, copy the one segment holding it and swap that
+ * segment into its directory slot; the directory itself is only replaced
+ * when appends need another segment.  Every publication has a version and
+ * a replaced segment stays linked behind its successor, so a snapshot
+ * reads the newest version of a segment that is not newer than itself.
+ * Versions no live snapshot can reach are unlinked by later updates.
+ * Updates lock a stripe chosen by row id, so writers to different records
+ * build their copies in parallel and only the segment swap is serialized.
+ */
+class ConcurrentDataStore
+{
+public:
+    typedef DataStore::IndexType IndexType;
+    typedef DataStore::DataStr DataStr;
+    typedef boost::shared_ptr<const DataStore::DataStoreRecord> RecordPtr;
+    //! Edits a private copy of the record; return false to discard the edit
+    typedef boost::function<bool (DataStore::DataStoreRecord&)> RecordUpdate;
+private:
+    static const size_t SegmentRows = 1024;
+    static const size_t WriterStripes = 64;
+
+    //Slots past the table's record count are unpublished and only touched by the writer holding publishLock_
+    struct SegmentVersion
+    {
+        std::vector<RecordPtr> records_;
+        //Version of the publication that made this the segment's newest version
+        boost::uint64_t version_;
+        //The version this one replaced; read and cut with the atomic shared_ptr functions
+        mutable boost::shared_ptr<const SegmentVersion> older_;
+
+        SegmentVersion() : records_(SegmentRows), version_(0) {}
+
+        ~SegmentVersion()
+        {
+            //Unlinks long chains one version at a time instead of recursively
+            boost::shared_ptr<const SegmentVersion> older;
+            older.swap(older_);
+            while (older && older.unique())
+            {
+                boost::shared_ptr<const SegmentVersion> next;
+                next.swap(older->older_);
+                older = next;
+            }
+        }
+    };
+
+    //Slots are swapped with the atomic shared_ptr functions; the vector is copied only to grow it
+    typedef std::vector<boost::shared_ptr<SegmentVersion>> Directory;
+
+    struct Table
+    {
+        boost::shared_ptr<Directory> directory_;
+        IndexType count_;
+        boost::uint64_t version_;
+        Table() : directory_(boost::make_shared<Directory>()), count_(0), version_(0) {}
+    };
+public:
+    //! Point in time view of the store; cheap to copy and usable from any thread
+    class Snapshot
+    {
+        friend class ConcurrentDataStore;
+    private:
+        boost::shared_ptr<const Table> table_;
+    private:
+        explicit Snapshot(const boost::shared_ptr<const Table>& table) : table_(table) {}
+    public:
+        IndexType GetNumberRecords() const
+        {
+            return(table_->count_);
+        }
+
+        bool GetDataRecord(IndexType id, RecordPtr& record) const
+        {
+            if (id >= table_->count_)return(false);
+            boost::shared_ptr<const SegmentVersion> segment = boost::atomic_load(&(*table_->directory_)[id / SegmentRows]);
+            while (segment && segment->version_ > table_->version_)
+            {
+                segment = boost::atomic_load(&segment->older_);
+            }
+            if (!segment)return(false);
+            record = segment->records_[id % SegmentRows];
+            return(true);
+        }
+    };
+private:
+    boost::shared_ptr<const Table> root_;
+    //Column dictionary of published records; replaced, never changed, once readers can see it
+    DataStore::DataStoreRecord::SchemaPtr schema_;
+    //Tables that may still be held, oldest first; the first one alive is the oldest version readers can ask for.
+    //Holds only tables alive at the last publish, plus the new one
+    std::deque<boost::weak_ptr<const Table>> published_;
+    boost::mutex publishLock_;
+    boost::mutex stripes_[WriterStripes];
+private:
+    ConcurrentDataStore(const ConcurrentDataStore& rhs);
+    void operator=(const ConcurrentDataStore& rhs);
+
+    boost::shared_ptr<const Table> currentTable() const
+    {
+        return(boost::atomic_load(&root_));
+    }
+
+    //Called with publishLock_ held
+    void publish(const boost::shared_ptr<Directory>& directory, IndexType count, boost::uint64_t version)
+    {
+        boost::shared_ptr<Table> table = boost::make_shared<Table>();
+        table->directory_ = directory;
+        table->count_ = count;
+        table->version_ = version;
+        boost::shared_ptr<const Table> published(table);
+        boost::atomic_store(&root_, published);
+        //Swept whole, not just from the front, so one long held old table does not keep every later one listed
+        published_.erase(std::remove_if(published_.begin(), published_.end(), boost::bind(&boost::weak_ptr<const Table>::expired, _1)), published_.end());
+        published_.push_back(published);
+    }
+
+    //Oldest version a reader holds or can still get; called with publishLock_ held
+    boost::uint64_t oldestVersion()
+    {
+        while (!published_.empty())
+        {
+            boost::shared_ptr<const Table> table = published_.front().lock();
+            if (table)return(table->version_);
+            published_.pop_front();
+        }
+        return(this->currentTable()->version_);
+    }
+
+    //Rebinds the record to the published dictionary, first extending a copy of it with any new column names
+    void adoptSchema(DataStore::DataStoreRecord* record)
+    {
+        if (record->schema_ == schema_)return;
+        std::vector<DataStr> missing;
+        if (record->schema_)
+        {
+            for (size_t c = 0; c < record->schema_->GetNumberColumns(); ++c)
+            {
+                const DataStr& name = record->schema_->GetName(static_cast<DataStoreSchema::ColumnId>(c));
+                DataStoreSchema::ColumnId id = DataStoreSchema::InvalidColumn;
+                if (!schema_->Find(name, id))missing.push_back(name);
+            }
+        }
+        if (!missing.empty())
+        {
+            //Readers may be looking names up in the current dictionary, so it is never interned into
+            DataStore::DataStoreRecord::SchemaPtr extended = boost::make_shared<DataStoreSchema>();
+            for (size_t c = 0; c < schema_->GetNumberColumns(); ++c)
+            {
+                extended->Intern(schema_->GetName(static_cast<DataStoreSchema::ColumnId>(c)));
+            }
+            for (size_t i = 0; i < missing.size(); ++i)
+            {
+                extended->Intern(missing[i]);
+            }
+            schema_ = extended;
+        }
+        record->bindSchema(schema_);
+    }
+
+    //Appends to a directory no reader can see yet; publishLock_ must be held
+    void appendPrivate(Directory& directory, IndexType row, boost::uint64_t version, DataStore::DataStoreRecord* record)
+    {
+        adoptSchema(record);
+        if (row % SegmentRows == 0)
+        {
+            directory.push_back(boost::make_shared<SegmentVersion>());
+            directory.back()->version_ = version;
+        }
+        directory[row / SegmentRows]->records_[row % SegmentRows] = RecordPtr(record);
+    }
+
+    static bool isDetached(const DataStore::DataStoreRecord* record)
+    {
+        //Records owned by a DataStore, or living in its arena, cannot be shared across threads
+        return(record != nullptr && record->owner_ == nullptr && record->arena_ == nullptr);
+    }
+public:
+    ConcurrentDataStore() :
+        root_(boost::make_shared<Table>()),
+        schema_(boost::make_shared<DataStoreSchema>())
+    {
+        published_.push_back(root_);
+    }
+
+    //Creates a detached record for AddDataRecord; delete it yourself if it is never added
+    DataStore::DataStoreRecord* CreateRecord(IndexType id) const
+    {
+        return(new DataStore::DataStoreRecord(id));
+    }
+
+    //Takes ownership of a record allocated with new; readers see it once this returns
+    bool AddDataRecord(DataStore::DataStoreRecord* record, IndexType& row)
+    {
+        if (!isDetached(record))return(false);
+        boost::lock_guard<boost::mutex> lock(publishLock_);
+        boost::shared_ptr<const Table> table = this->currentTable();
+        boost::shared_ptr<Directory> directory = table->directory_;
+        row = table->count_;
+        if (row % SegmentRows == 0)
+        {
+            //Last segment is full - snapshots taken before this keep the old directory
+            directory = boost::make_shared<Directory>(*directory);
+        }
+        //The slot is past every published count, so no reader is looking at it
+        this->appendPrivate(*directory, row, table->version_ + 1, record);
+        this->publish(directory, row + 1, table->version_ + 1);
+        return(true);
+    }
+
+    bool AddDataRecord(DataStore::DataStoreRecord* record)
+    {
+        IndexType row = 0;
+        return(this->AddDataRecord(record, row));
+    }
+
+    //Applies the update to a copy of the record and publishes the copy; concurrent readers keep the old version
+    bool UpdateRecord(IndexType id, const RecordUpdate& update)
+    {
+        if (update.empty())return(false);
+        boost::lock_guard<boost::mutex> stripeLock(stripes_[id % WriterStripes]);
+        RecordPtr current;
+        if (!this->GetDataRecord(id, current))return(false);
+        boost::shared_ptr<DataStore::DataStoreRecord> copy(current->Clone());
+        if (!update(*copy))return(false);
+
+        boost::lock_guard<boost::mutex> lock(publishLock_);
+        boost::shared_ptr<const Table> table = this->currentTable();
+        boost::shared_ptr<SegmentVersion>& slot = (*table->directory_)[id / SegmentRows];
+        //Only writers holding publishLock_ change the slot, so it is read without the atomic functions
+        boost::shared_ptr<SegmentVersion> segment = slot;
+        //The stripe lock keeps other updates of this row out; a mismatch means the store was reloaded or cleared
+        if (id >= table->count_ || segment->records_[id % SegmentRows] != current)return(false);
+        adoptSchema(copy.get());
+        boost::shared_ptr<SegmentVersion> updated = boost::make_shared<SegmentVersion>();
+        updated->records_ = segment->records_;
+        updated->records_[id % SegmentRows] = copy;
+        updated->version_ = table->version_ + 1;
+        updated->older_ = segment;
+        //Versions behind the newest one every reader can see are unreachable
+        boost::uint64_t oldest = this->oldestVersion();
+        boost::shared_ptr<const SegmentVersion> keep = segment;
+        while (keep && keep->version_ > oldest)keep = boost::atomic_load(&keep->older_);
+        if (keep)boost::atomic_store(&keep->older_, boost::shared_ptr<const SegmentVersion>());
+        boost::atomic_store(&slot, updated);
+        this->publish(table->directory_, table->count_, table->version_ + 1);
+        return(true);
+    }
+
+    Snapshot GetSnapshot() const
+    {
+        return(Snapshot(this->currentTable()));
+    }
+
+    //Single lookups against the latest snapshot; the record stays valid while it is held
+    bool GetDataRecord(IndexType id, RecordPtr& record) const
+    {
+        return(this->GetSnapshot().GetDataRecord(id, record));
+    }
+
+    IndexType GetNumberRecords() const
+    {
+        return(this->currentTable()->count_);
+    }
+
+    void Clear()
+    {
+        boost::lock_guard<boost::mutex> lock(publishLock_);
+        schema_ = boost::make_shared<DataStoreSchema>();
+        this->publish(boost::make_shared<Directory>(), 0, this->currentTable()->version_ + 1);
+    }
+
+    //Replaces the contents with a data store file; readers see the old contents until the new ones are complete
+    bool Load(const rct::UTF8String& fileName)
+    {
+        DataStoreReader reader;
+        if (!reader.Open(fileName))return(false);
+        boost::lock_guard<boost::mutex> lock(publishLock_);
+        DataStore::DataStoreRecord::SchemaPtr oldSchema = schema_;
+        schema_ = boost::make_shared<DataStoreSchema>();
+        boost::shared_ptr<Directory> directory = boost::make_shared<Directory>();
+        boost::uint64_t version = this->currentTable()->version_ + 1;
+        IndexType count = 0;
+        DataStore::DataStoreRecord* record = nullptr;
+        while (reader.Next(&record))
+        {
+            this->appendPrivate(*directory, count++, version, record);
+        }
+        if (count != reader.GetNumberRecords())
+        {
+            //Error occurred - keep the published contents
+            schema_ = oldSchema;
+            return(false);
+        }
+        this->publish(directory, count, version);
+        return(true);
+    }
+
+    //Saves a consistent snapshot while writers carry on
+    bool Save(const rct::UTF8String& fileName, DataStore::StorageFormat format = DataStore::DATASTORE_FORMAT_BINARY) const
+    {
+        Snapshot snapshot = this->GetSnapshot();
+        std::vector<DataStore::DataStoreRecord*> copies;
+        copies.reserve(snapshot.GetNumberRecords());
+        bool rt = true;
+        {
+            DataStore store(L"snapshot");
+            RecordPtr record;
+            for (IndexType i = 0; rt && i < snapshot.GetNumberRecords(); ++i)
+            {
+                snapshot.GetDataRecord(i, record);
+                copies.push_back(record->Clone());
+                rt = store.AddDataRecord(copies.back());
+            }
+            rt = rt && store.Save(fileName, format);
+        }
+        //The temporary store has let go of the copies
+        for (size_t i = 0; i < copies.size(); ++i)delete copies[i];
+        return(rt);
+    }
+};
+
+} //namespace rct
+
+#endif //CONCURRENT_DATA_STORE_H_
@@ -1,589 +1,2606 @@
-#ifndef DATA_STORE_H_
-#define DATA_STORE_H_
-
-#include "UTF8String.h"
-#include "BaseObject.h"
-#include <map>
-#include <iostream>
-#include "FileReader.h"
-#include "FileWriter.h"
-#include "FileUtilities.h"
-#include <boost/tokenizer.hpp>
-
-namespace rct {
-
-class DataStore : protected rct::Object<>
-{
-public:
-    typedef unsigned long IndexType;
-    typedef rct::Object<>::KeyType DataStr;
-public:
-    class DataStoreRecord : public rct::Object<>
-    {
-    public:
-        class RecordResult
-        {
-        public:
-            typedef struct Result
-            {
-                DataStr* dataStr_;
-                void* dataObj_;
-            };
-
-        private:
-            void operator=(const RecordResult& rhs);
-            RecordResult(const RecordResult& rhs);
-        private:
-            DataStr stringData_;
-            void* objectData_;
-            bool isObject_;
-        public:
-            explicit RecordResult(const DataStr& data) : stringData_(data), objectData_(nullptr), isObject_(false) {}
-            explicit RecordResult(void* data)              : stringData_(rct::EMPTY_STRING), objectData_(data), isObject_(true) {}
-            RecordResult(RecordResult&& other) { *this = std::move(other); }
-            const RecordResult& operator=(RecordResult&& other)
-            {
-                if (this != &other)
-                {                  
-                    this->stringData_ = std::move(other.stringData_);
-                    this->objectData_ = other.objectData_;
-                    this->isObject_   = other.isObject_;
-
-                    //Clear other
-                    other.objectData_ = nullptr;
-                    other.isObject_ = false;
-                }
-                return(*this);
-            }
-            bool IsObject() const { return(this->isObject_); }
-
-            RecordResult::Result&& GetResult(bool& isObj)
-            {
-                isObj = isObject_;
-                RecordResult::Result r;
-                if (isObject_)
-                {
-                    r.dataObj_ = objectData_;
-                }
-                else
-                {
-                    r.dataStr_ = &stringData_;
-                }
-                return(std::move(r)); 
-            }
-        };
-    private:
-        IndexType id_;
-        IndexType nextColumnIdx_;
-        IndexType nextObjectColumnIdx_;
-        std::map<IndexType, DataStr> indexToColumnStringMap_;
-        std::map<IndexType, DataStr> indexToColumnObjectMap_;
-    public:
-        explicit DataStoreRecord(IndexType id) : 
-            rct::Object<DataStr>(rct::UTF8String(boost::str(boost::format("%d") % id)).c_str()),
-            id_(id),
-            nextColumnIdx_(0),
-            nextObjectColumnIdx_(0)
-        {}
-
-        IndexType GetNumberPropertyColumns() const
-        {
-            return(nextColumnIdx_);
-        }
-
-        IndexType GetNumberObjectColumns() const
-        {
-            return(nextObjectColumnIdx_);
-        }
-
-        std::vector<DataStr>&& GetPropertyColumnNames() const
-        {
-            auto cIter = indexToColumnStringMap_.cbegin();
-            auto eIter = indexToColumnStringMap_.cend();
-            std::vector<DataStr> rt;
-            for (; cIter != eIter; ++cIter)
-            {
-                rt.push_back(cIter->second);
-            }
-            return(std::move(rt));
-        }
-
-        std::vector<DataStr>&& GetObjectColumnNames() const
-        {
-            auto cIter = indexToColumnObjectMap_.cbegin();
-            auto eIter = indexToColumnObjectMap_.cend();
-            std::vector<DataStr> rt;
-            for (; cIter != eIter; ++cIter)
-            {
-                rt.push_back(cIter->second);
-            }
-            return(std::move(rt));
-        }
-
-        bool AddColumn(const DataStr& name, const DataStr& val)
-        {
-            if (name.empty())return(false);
-            if (this->Set(name, val))
-            {
-                this->indexToColumnStringMap_[this->nextColumnIdx_++] = name;
-                return(true);
-            }
-            return(false);
-        }
-
-        bool AddColumn(const DataStr& name, rct::Object<>::UnknownObjValType val, rct::Object<>::UnknownObjSizeType size)
-        {
-            if (name.empty())return(false);
-            if (this->SetObject(name, val, size))
-            {
-                this->indexToColumnObjectMap_[this->nextObjectColumnIdx_++] = name;
-                return(true);
-            }
-            return(false);
-        }
-
-        bool GetColumn(const DataStr& name, RecordResult&& result)
-        {
-            if (name.empty())
-            {
-                result = std::move(RecordResult(nullptr));
-                return(false);
-            }
-            auto stringMapFind = this->properties_.find(name);
-            auto objectMapFind = this->objects_.find(name);
-            bool notInStringIdx = (stringMapFind == this->properties_.end());
-            bool notInObjectIdx = (objectMapFind == this->objects_.end());
-            if (notInStringIdx && notInObjectIdx)
-            {
-                return(false);
-            }
-            else
-            {
-                if (!notInStringIdx)
-                {
-                    //Retrieve object from string property map
-                    result = std::move(RecordResult(stringMapFind->second));
-                }
-                else
-                {
-                    //Retrieve object from object map
-                    result = std::move(RecordResult(objectMapFind->second.GetData()));
-                }
-                return(true);
-            }
-            return(false);
-        }
-
-        bool OutputToStream(std::wostream& output)
-        {
-            //Output id and counters
-            output << id_ << '|' << nextColumnIdx_ << '|' << nextObjectColumnIdx_ << '|' << L"\r\n";
-            //Output string objects
-            if (!this->properties_.empty())
-            {
-                output << L"PROPERTIES" << '|' << this->properties_.size() << '|' << L"\r\n";
-                std::map<DataStr, DataStr>::iterator pIter = this->properties_.begin();
-                std::map<DataStr, DataStr>::iterator eIter = this->properties_.end();
-                for (; pIter != eIter; ++pIter)
-                {
-                    rct::UTF8String firstS(pIter->first);
-                    rct::UTF8String secondS(pIter->second);
-                    output << L'\"' << firstS.str() << L'\"' << L':' << L'\"' << secondS.str() << L'\"' << L"\r\n";
-                }
-                output << "\r\n";
-            }
-            if (!this->objects_.empty())
-            {
-                output << L"OBJECTS" << L'|' << this->objects_.size() << L'|' << L"\r\n";
-                std::map<DataStr, rct::Object<>::UnkObjType>::iterator pIter = this->objects_.begin();
-                std::map<DataStr, rct::Object<>::UnkObjType>::iterator eIter = this->objects_.end();
-                CryptoPP::HexEncoder hexEncoder;
-                for (; pIter != eIter; ++pIter)
-                {
-                    rct::Object<>::UnkObjType& obj = pIter->second;
-                    std::string outputResult;
-                    if (obj.GetSize() > 0)
-                    {
-                        CryptoPP::StringSink* strSink = new CryptoPP::StringSink(outputResult);
-                        hexEncoder.Attach(strSink);
-                        hexEncoder.Put((unsigned char*)obj.GetData(), obj.GetSize(), true);
-                        //End encoding
-                        hexEncoder.MessageEnd();
-
-                        rct::UTF8String firstS(pIter->first);
-                        output << L'\"' << firstS.str() << L'\"' << L':' << L'\"' << obj.GetSize() << L'\"' << L':' <<  L'\"' << rct::UTF8String(outputResult).str() << L'\"' << L"\r\n";
-                        output.flush();
-                        outputResult.clear();
-                        //Cleanup string sink
-                        //delete strSink;
-                    }
-                }
-                output << L"\r\n";
-            }
-            output.flush();
-            return(true);
-        }
-
-        bool InputFromStream(std::wistream& input)
-        {
-            DataStr::value_type firstLineBuffer[2048];
-            DataStr::value_type tempChar;
-            std::wstring endLine;
-            //std::istream& iStr = input.getline(firstLineBuffer, 2048, '|');
-            //Read Id, next column idx, and next object column idx
-            input >> id_ >> tempChar >> nextColumnIdx_ >> tempChar >> nextObjectColumnIdx_ >> tempChar;// >> endLine;
-            IndexType columnSz = nextColumnIdx_;
-            IndexType colObjSz = nextObjectColumnIdx_;
-            //Reset next column index and next object column index
-            nextColumnIdx_ = 0;
-            nextObjectColumnIdx_ = 0;
-
-            //Create the tokenizer
-            typedef boost::tokenizer<boost::char_separator<DataStr::value_type>, DataStr::const_iterator, DataStr> TokenizerType;
-            boost::char_separator<DataStr::value_type> sep(L":|\'\"");
-
-            //See if we even have any properties
-            if (columnSz > 0)
-            {
-                DataStr workstring;
-                DataStr propertiesId;
-                IndexType amountProps = 0;
-                input >> workstring;
-                TokenizerType tokens(workstring, sep);
-                TokenizerType::const_iterator tokIter = tokens.begin();
-                propertiesId = rct::UTF8String(*tokIter).c_str();
-                ++tokIter;
-                amountProps = boost::lexical_cast<IndexType, DataStr>(rct::UTF8String(*tokIter).c_str());
-                
-                //Amount props should match column size
-                if (propertiesId == L"PROPERTIES" && columnSz == amountProps)
-                {
-                    rct::UTF8String propName;
-                    rct::UTF8String propVal;
-                    for (unsigned int i = 0; i < amountProps; ++i)
-                    {
-                        try
-                        {
-                            input >> workstring;
-                            tokens.assign(workstring, sep);
-                            tokIter = tokens.begin();
-                            const DataStr pName = *tokIter;
-                            ++tokIter;
-                            const DataStr pVal = *tokIter; 
-                            this->AddColumn(pName, pVal);
-                            //std::string propNameS = propName.nstr();
-                            //std::string propValS = propVal.nstr();
-                        }
-                        catch(std::runtime_error& rErr)
-                        {
-                        }
-                        catch(std::exception& rEx)
-                        {
-                        }
-                        catch(...)
-                        {
-                        }
-                    }
-                }
-                else
-                {
-                    //Error
-                    return(false);
-                }
-            }
-
-            //See if we have any object properties
-            if (colObjSz > 0)
-            {
-                DataStr workstring;
-                DataStr objectsId;
-                IndexType amountObjProps;
-                input >> workstring;//objectsId >> tempChar >> amountObjProps >> tempChar >> endLine;
-                TokenizerType tokens(workstring, sep);
-                TokenizerType::const_iterator tokIter = tokens.begin();
-                objectsId = rct::UTF8String(*tokIter).c_str();
-                ++tokIter;
-                amountObjProps = boost::lexical_cast<IndexType, DataStr>(rct::UTF8String(*tokIter).c_str());
-
-                CryptoPP::HexDecoder hexDecoder;
-                //Amount obj props should match column size
-                if (objectsId == L"OBJECTS" && colObjSz == amountObjProps)
-                {
-                    for (unsigned int i = 0; i < colObjSz; ++i)
-                    {
-                        rct::UTF8String propName;
-                        IndexType propSize;
-                        rct::UTF8String propData;
-                        input >> workstring; //quoteChar >> propName >> quoteChar >> semiColonChar >> quoteChar >> propSize >> quoteChar >> semiColonChar >> quoteChar >> propData >> quoteChar >> tempChar >> endLine;
-                        tokens.assign(workstring, sep);
-                        tokIter = tokens.begin();
-                        propName.Set(*tokIter);
-                        ++tokIter;
-                        propSize = boost::lexical_cast<IndexType, DataStr>(rct::UTF8String(*tokIter).c_str());
-                        ++tokIter;
-                        propData.Set(*tokIter);
-                        //Decode the hex if properly captured
-                        std::string outputResult;
-                        if (!propData.isEmpty())
-                        {
-                            //CryptoPP::StringSource* strSrc = new CryptoPP::StringSource(propData);
-                            CryptoPP::StringSink* strSink = new CryptoPP::StringSink(outputResult);
-                            //hexDecoder.Detach(strSrc);
-                            hexDecoder.Attach(strSink);
-                            unsigned char buffer[2];
-                            unsigned int shiftIdx;
-                            for (unsigned int i = 0; i < propSize; ++i)
-                            {
-                                shiftIdx = i<<1;
-                                buffer[0] = propData[shiftIdx];
-                                buffer[1] = propData[shiftIdx+1];
-                                hexDecoder.Put(buffer, 2);
-                            }
-                            //End encoding
-                            hexDecoder.MessageEnd();
-                            //hexDecoder.
-
-                            rct::UTF8String propS(outputResult);
-                            AddColumn(propName.c_str(), (void*)outputResult.data(), propSize);
-                            //outputResult.clear();
-                            //Cleanup string sink
-                            //delete strSink;
-                        }
-                        else
-                        {
-                            //Error occurred
-                            return(false);
-                        }
-                    }
-                    //Read next endline
-//                    input >> endLine;
-                }
-                else
-                {
-                    //Error
-                    return(false);
-                }
-            }
-            return(true);
-        }
-    };
-protected:
-    bool AddRecord(DataStore::DataStoreRecord* record)
-    {
-        DataStr rowId = rct::UTF8String(boost::str(boost::format("%d") % nextRowIdx_)).c_str();
-        bool rt = this->SetObjectProperty(rowId, static_cast<rct::Object<>::UnknownObjValType>(record), sizeof(DataStore::DataStoreRecord*));
-        if (rt)nextRowIdx_++;
-        return(rt);
-    }
-
-    bool GetRecord(IndexType id, DataStore::DataStoreRecord** record)
-    {
-        if (record == nullptr)return(false);
-        std::wstring rowId = rct::UTF8String(boost::str(boost::format("%d") % id)).c_str();
-        unsigned int size;
-        void* vRec = this->GetObjectProperty(rowId, size);
-        if (vRec != nullptr)
-        {
-            *record = static_cast<DataStore::DataStoreRecord*>(vRec);
-            return(true);
-        }
-        return(false);
-    }
-
-    bool GetRecord(const DataStr& id, DataStore::DataStoreRecord** record)
-    {
-        if (record == nullptr)return(false);
-        unsigned int size;
-        void* vRec = this->GetObjectProperty(id, size);
-        if (vRec != nullptr)
-        {
-            *record = static_cast<DataStore::DataStoreRecord*>(vRec);
-            return(true);
-        }
-        return(false);
-    }
-
-    bool GetRecords(std::vector<DataStore::DataStoreRecord*>& result)
-    {
-        if (this->objects_.empty())return(false);
-        result.reserve(this->objects_.size());
-        auto bIter = this->objects_.begin();
-        auto eIter = this->objects_.end();
-        bool addedRecords = false;
-        for (; bIter != eIter; ++bIter)
-        {
-            auto curVal = *bIter;
-            void* curDataPtr = curVal.second.GetData();
-            if (curDataPtr == nullptr)continue;
-            result.push_back(static_cast<DataStore::DataStoreRecord*>(curDataPtr));
-            addedRecords = true;
-        }
-        return(addedRecords && !result.empty());
-    }
-
-    bool WriteToFile(const rct::UTF8String& fileName)
-    {
-        if (nextRowIdx_ == 0)return(false);
-        rct::FileWriter fWriter;
-        if (fWriter.OpenFile(fileName, false, true))
-        {           
-            fWriter.WriteLine(boost::str(boost::format("%d") % nextRowIdx_));
-            std::vector<DataStore::DataStoreRecord*> records;
-            bool failure = false;
-            if (GetRecords(records))
-            {
-                std::vector<DataStore::DataStoreRecord*>::iterator cIter = records.begin();
-                std::vector<DataStore::DataStoreRecord*>::iterator eIter = records.end();
-                for (; cIter != eIter; ++cIter)
-                {
-                    std::wstringstream buffer;
-                    DataStore::DataStoreRecord* curRecord = static_cast<DataStore::DataStoreRecord*>(*cIter);
-                    if (curRecord == nullptr)continue;
-                    curRecord->OutputToStream(buffer);
-                    if (!fWriter.Write(buffer.str()))
-                    {
-                        failure = true;
-                        break;
-                    }
-                }
-            }
-            if (!failure)
-            {
-                failure = !fWriter.CloseFile();
-            }
-            return(!failure);
-        }
-        return(false);
-    }
-
-    bool ReadFromFile(const rct::UTF8String& fileName)
-    {
-        //Reset data
-        this->nextRowIdx_ = 0;
-        this->objects_.clear();
-        rct::FileReader fReader;
-        if (fReader.OpenFile(fileName))
-        {
-            rct::UTF8String firstLine;
-            if (!fReader.ReadLine(firstLine))
-            {
-                //Could not read first line
-                return(false);
-            }
-            this->nextRowIdx_ = boost::lexical_cast<IndexType, DataStr>(firstLine.str());
-            if (this->nextRowIdx_ > 0)
-            {
-                //Set next row index into counter and reset next row index
-                IndexType recordCount = this->nextRowIdx_;
-                this->nextRowIdx_ = 0;
-                rct::UTF8String buffer;
-                if (fReader.Read(buffer))
-                {
-                    //std::wstring bufferStr = buffer
-                    std::wstringbuf sBuff(buffer.c_str());
-                    std::wistream iStr(&sBuff, true);
-                    for (unsigned int i = 0; i < recordCount; ++i)
-                    {
-                        //Create new data record with id of 0, id's are read in by the data store record clss
-                        DataStore::DataStoreRecord* dStoreRec = new DataStore::DataStoreRecord(0);
-                        if (dStoreRec != nullptr)
-                        {
-                            if (dStoreRec->InputFromStream(iStr))
-                            {
-                                if (!this->AddRecord(dStoreRec))
-                                {
-                                    //Error occurred - could not add record to the data store
-                                    return(false);
-                                }
-                            }
-                            else
-                            {
-                                //Error occurred - could not read from the input stream
-                                return(false);
-                            }
-                        }
-                        else
-                        {
-                            //Error occurred - could not create new data record
-                            return(false);
-                        }
-                    }
-                    //Clear the input stream - we are finished
-                    iStr.clear();
-                }
-                else
-                {
-                    //Error occurred while reading
-                    return(false);
-                }
-            }
-            else
-            {
-                //Error occurred - next row index read is zero
-                return(false);
-            }
-        }
-        else
-        {
-            //Error occured - could not open file
-            return(false);
-        }
-        //If we get here, we are successful
-        return(true);
-    }
-public:
-    DataStore(const DataStr& name) : 
-        rct::Object<>(name), 
-        nextRowIdx_(0)
-    {
-    }
-
-    bool AddDataRecord(DataStore::DataStoreRecord* record)
-    {
-        return(this->AddRecord(record));
-    }
-
-    bool GetDataRecord(IndexType id, DataStore::DataStoreRecord** record)
-    {
-        return(this->GetRecord(id, record));
-    }
-
-    bool GetDataRecord(const DataStr& name, DataStore::DataStoreRecord** record)
-    {
-        return(this->GetRecord(name, record));
-    }
-
-    bool Save(const rct::UTF8String& fileName)
-    {
-        return(this->WriteToFile(fileName));
-    }
-
-    bool Load(const rct::UTF8String& fileName)
-    {
-        return(this->ReadFromFile(fileName));
-    }
-
-    IndexType GetNumberRecords() const
-    {
-        return(nextRowIdx_);
-    }
-
-    std::vector<DataStr>&& GetRecordIds() const
-    {
-        auto cIter = this->objects_.cbegin();
-        auto eIter = this->objects_.cend();
-        std::vector<DataStr> rt;
-        for (; cIter != eIter; ++cIter)
-        {
-            rt.push_back(cIter->first);
-        }
-        return(std::move(rt));
-    }
-
-private:
-    IndexType nextRowIdx_;
-};
-
-} //namespace rct
-
+#ifndef DATA_STORE_H_
+#define DATA_STORE_H_
+
+#include "UTF8String.h"
+#include "BaseObject.h"
+#include <map>
+#include <iostream>
+#include "FileReader.h"
+#include "FileWriter.h"
+#include "FileUtilities.h"
+#include "DataStoreBinaryFormat.h"
+#include "DataStoreMappedFile.h"
+#include "DataStoreLazyFile.h"
+#include "DataStoreSchema.h"
+#include "DataStoreTextStream.h"
+#include "DataStoreLog.h"
+#include "DataStoreColumnStore.h"
+#include "DataStoreIndex.h"
+#include "DataStoreArena.h"
+#include "DataStoreHex.h"
+#include "WorkerPool.h"
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/tokenizer.hpp>
+
+namespace rct {
+
+class ConcurrentDataStore;
+
+class DataStore : protected rct::Object<>
+{
+public:
+    typedef unsigned long IndexType;
+    typedef rct::Object<>::KeyType DataStr;
+
+    typedef enum StorageFormat
+    {
+        DATASTORE_FORMAT_AUTO,
+        DATASTORE_FORMAT_TEXT,
+        DATASTORE_FORMAT_BINARY
+    };
+public:
+    class DataStoreRecord : public rct::Object<>
+    {
+        friend class DataStore;
+        friend class ConcurrentDataStore;
+    public:
+        class RecordResult
+        {
+        public:
+            typedef struct Result
+            {
+                DataStr* dataStr_;
+                void* dataObj_;
+            };
+
+        private:
+            void operator=(const RecordResult& rhs);
+            RecordResult(const RecordResult& rhs);
+        private:
+            DataStr stringData_;
+            void* objectData_;
+            size_t objectSize_;
+            //Bit pattern of an int64, double, bool or timestamp value
+            boost::uint64_t scalarData_;
+            DataStoreValueType type_;
+        public:
+            explicit RecordResult(const DataStr& data) : stringData_(data), objectData_(nullptr), objectSize_(0), scalarData_(0), type_(DATASTORE_VALUE_STRING) {}
+            explicit RecordResult(void* data)              : stringData_(rct::EMPTY_STRING), objectData_(data), objectSize_(0), scalarData_(0), type_(DATASTORE_VALUE_BYTES) {}
+            RecordResult(void* data, size_t size)          : stringData_(rct::EMPTY_STRING), objectData_(data), objectSize_(size), scalarData_(0), type_(DATASTORE_VALUE_BYTES) {}
+            RecordResult(DataStoreValueType type, boost::uint64_t bits) : stringData_(rct::EMPTY_STRING), objectData_(nullptr), objectSize_(0), scalarData_(bits), type_(type) {}
+            RecordResult(RecordResult&& other) { *this = std::move(other); }
+            const RecordResult& operator=(RecordResult&& other)
+            {
+                if (this != &other)
+                {                  
+                    this->stringData_ = std::move(other.stringData_);
+                    this->objectData_ = other.objectData_;
+                    this->objectSize_ = other.objectSize_;
+                    this->scalarData_ = other.scalarData_;
+                    this->type_       = other.type_;
+
+                    //Clear other
+                    other.objectData_ = nullptr;
+                    other.objectSize_ = 0;
+                    other.type_ = DATASTORE_VALUE_NONE;
+                }
+                return(*this);
+            }
+            bool IsObject() const { return(this->type_ == DATASTORE_VALUE_BYTES); }
+            DataStoreValueType GetType() const { return(this->type_); }
+
+            const DataStr& GetString() const { return(this->stringData_); }
+            void* GetObjectData() const { return(this->objectData_); }
+            size_t GetObjectSize() const { return(this->objectSize_); }
+            boost::int64_t GetInt64() const { return(static_cast<boost::int64_t>(this->scalarData_)); }
+            double GetDouble() const { return(DataStoreBinaryFormat::BitsToDouble(this->scalarData_)); }
+            bool GetBool() const { return(this->scalarData_ != 0); }
+            boost::int64_t GetTimestamp() const { return(static_cast<boost::int64_t>(this->scalarData_)); }
+
+            //Int64, double, bool and timestamp results as a double; false for strings and objects
+            bool GetNumber(double& val) const
+            {
+                switch (this->type_)
+                {
+                case DATASTORE_VALUE_INT64:
+                case DATASTORE_VALUE_TIMESTAMP:
+                    val = static_cast<double>(GetInt64());
+                    return(true);
+                case DATASTORE_VALUE_DOUBLE:
+                    val = GetDouble();
+                    return(true);
+                case DATASTORE_VALUE_BOOL:
+                    val = GetBool() ? 1.0 : 0.0;
+                    return(true);
+                default:
+                    return(false);
+                }
+            }
+
+            //String and object results only - typed results are read through the typed getters
+            RecordResult::Result GetResult(bool& isObj)
+            {
+                isObj = IsObject();
+                RecordResult::Result r;
+                r.dataStr_ = nullptr;
+                r.dataObj_ = nullptr;
+                if (isObj)
+                {
+                    r.dataObj_ = objectData_;
+                }
+                else if (type_ == DATASTORE_VALUE_STRING)
+                {
+                    r.dataStr_ = &stringData_;
+                }
+                return(r);
+            }
+        };
+    public:
+        typedef DataStoreSchema::ColumnId ColumnId;
+        typedef boost::shared_ptr<DataStoreSchema> SchemaPtr;
+    private:
+        //Column payloads live in the arena of the store that created the record, or on the heap
+        typedef std::basic_string<DataStr::value_type, DataStr::traits_type, DataStoreArenaAllocator<DataStr::value_type>> SlotString;
+        typedef std::vector<unsigned char, DataStoreArenaAllocator<unsigned char>> SlotBytes;
+
+        //Value storage for one column; slots are indexed by the schema column id
+        struct ColumnSlot
+        {
+            SlotString stringData_;
+            SlotBytes objectData_;
+            //Typed values, see DataStoreBinaryFormat::DoubleToBits for doubles
+            boost::uint64_t scalarData_;
+            DataStoreValueType kind_;
+            explicit ColumnSlot(DataStoreArena* arena = nullptr) :
+                stringData_(DataStoreArenaAllocator<DataStr::value_type>(arena)),
+                objectData_(DataStoreArenaAllocator<unsigned char>(arena)),
+                scalarData_(0),
+                kind_(DATASTORE_VALUE_NONE)
+            {}
+
+            DataStr GetString() const
+            {
+                return(DataStr(stringData_.data(), stringData_.size()));
+            }
+        };
+        typedef std::vector<ColumnSlot, DataStoreArenaAllocator<ColumnSlot>> SlotVector;
+
+        //Column values of a record.  Snapshots share it with the record; the
+        //record copies it before the first change made while it is shared
+        struct ColumnData
+        {
+            SlotVector slots_;
+            //Column ids in the order they were added
+            std::vector<ColumnId> propertyColumns_;
+            std::vector<ColumnId> objectColumns_;
+            std::vector<ColumnId> typedColumns_;
+            explicit ColumnData(DataStoreArena* arena) : slots_(DataStoreArenaAllocator<ColumnSlot>(arena)) {}
+
+            const ColumnSlot* getSlot(ColumnId id) const
+            {
+                if (id >= slots_.size() || slots_[id].kind_ == DATASTORE_VALUE_NONE)return(nullptr);
+                return(&slots_[id]);
+            }
+
+            DataStoreValueType GetColumnType(ColumnId id) const
+            {
+                if (id >= slots_.size())return(DATASTORE_VALUE_NONE);
+                return(slots_[id].kind_);
+            }
+
+            bool GetInt64Column(ColumnId id, boost::int64_t& val) const
+            {
+                if (GetColumnType(id) != DATASTORE_VALUE_INT64)return(false);
+                val = static_cast<boost::int64_t>(slots_[id].scalarData_);
+                return(true);
+            }
+
+            bool GetDoubleColumn(ColumnId id, double& val) const
+            {
+                if (GetColumnType(id) != DATASTORE_VALUE_DOUBLE)return(false);
+                val = DataStoreBinaryFormat::BitsToDouble(slots_[id].scalarData_);
+                return(true);
+            }
+
+            bool GetBoolColumn(ColumnId id, bool& val) const
+            {
+                if (GetColumnType(id) != DATASTORE_VALUE_BOOL)return(false);
+                val = (slots_[id].scalarData_ != 0);
+                return(true);
+            }
+
+            bool GetTimestampColumn(ColumnId id, boost::int64_t& val) const
+            {
+                if (GetColumnType(id) != DATASTORE_VALUE_TIMESTAMP)return(false);
+                val = static_cast<boost::int64_t>(slots_[id].scalarData_);
+                return(true);
+            }
+
+            bool GetNumericColumn(ColumnId id, double& val) const
+            {
+                switch (GetColumnType(id))
+                {
+                case DATASTORE_VALUE_INT64:
+                case DATASTORE_VALUE_TIMESTAMP:
+                    val = static_cast<double>(static_cast<boost::int64_t>(slots_[id].scalarData_));
+                    return(true);
+                case DATASTORE_VALUE_DOUBLE:
+                    val = DataStoreBinaryFormat::BitsToDouble(slots_[id].scalarData_);
+                    return(true);
+                case DATASTORE_VALUE_BOOL:
+                    val = (slots_[id].scalarData_ != 0) ? 1.0 : 0.0;
+                    return(true);
+                default:
+                    return(false);
+                }
+            }
+
+            bool GetColumn(ColumnId id, RecordResult&& result) const
+            {
+                const ColumnSlot* slot = getSlot(id);
+                if (slot == nullptr)return(false);
+                if (slot->kind_ == DATASTORE_VALUE_STRING)
+                {
+                    //Retrieve value from the property slot
+                    result = std::move(RecordResult(slot->GetString()));
+                }
+                else if (slot->kind_ == DATASTORE_VALUE_BYTES)
+                {
+                    //Retrieve object from the object slot
+                    result = std::move(RecordResult(slot->objectData_.empty() ? nullptr : static_cast<void*>(const_cast<unsigned char*>(&slot->objectData_[0])), slot->objectData_.size()));
+                }
+                else
+                {
+                    //Typed values keep their native representation
+                    result = std::move(RecordResult(slot->kind_, slot->scalarData_));
+                }
+                return(true);
+            }
+        };
+        typedef boost::shared_ptr<ColumnData> DataPtr;
+    private:
+        IndexType id_;
+        SchemaPtr schema_;
+        //Store the record was added to and its row there; column changes are reported to it
+        DataStore* owner_;
+        IndexType row_;
+        //Arena the record was placed in by its store, null for records allocated with new
+        DataStoreArena* arena_;
+        DataPtr data_;
+    private:
+        //Column data and its control block go to the record's arena, like the record itself
+        static DataPtr newData(DataStoreArena* arena)
+        {
+            return(boost::allocate_shared<ColumnData>(DataStoreArenaAllocator<ColumnData>(arena), arena));
+        }
+
+        //Column data that is safe to change; shared data is copied first, leaving snapshots as they were.
+        //Snapshots are only taken on the thread that changes the store, so the check cannot race a new share
+        ColumnData& mutableData()
+        {
+            if (!data_.unique())data_ = boost::allocate_shared<ColumnData>(DataStoreArenaAllocator<ColumnData>(arena_), *data_);
+            return(*data_);
+        }
+
+        //Decimal id, as "%d" writes it; formatted by hand since every record created pays for it
+        static DataStr recordName(IndexType id)
+        {
+            DataStr::value_type digits[24];
+            size_t pos = sizeof(digits) / sizeof(digits[0]);
+            do
+            {
+                digits[--pos] = static_cast<DataStr::value_type>(L'0' + id % 10);
+                id /= 10;
+            } while (id != 0);
+            return(DataStr(digits + pos, digits + sizeof(digits) / sizeof(digits[0])));
+        }
+
+        static SchemaPtr copySchema(const SchemaPtr& schema)
+        {
+            SchemaPtr rt = boost::make_shared<DataStoreSchema>();
+            if (schema)
+            {
+                //Interning in id order keeps every column id of the copy the same
+                for (size_t c = 0; c < schema->GetNumberColumns(); ++c)
+                {
+                    rt->Intern(schema->GetName(static_cast<ColumnId>(c)));
+                }
+            }
+            return(rt);
+        }
+
+        DataStoreSchema& schema()
+        {
+            //Records created outside of a store get a private schema on first use
+            if (!schema_)schema_ = boost::make_shared<DataStoreSchema>();
+            return(*schema_);
+        }
+
+        const ColumnSlot* getSlot(ColumnId id) const
+        {
+            return(data_->getSlot(id));
+        }
+
+        std::vector<ColumnId>& orderFor(DataStoreValueType kind)
+        {
+            if (kind == DATASTORE_VALUE_STRING)return(data_->propertyColumns_);
+            if (kind == DATASTORE_VALUE_BYTES)return(data_->objectColumns_);
+            return(data_->typedColumns_);
+        }
+
+        ColumnSlot& prepareSlot(ColumnId id, DataStoreValueType kind)
+        {
+            mutableData();
+            if (id >= data_->slots_.size())data_->slots_.resize(id + 1, ColumnSlot(arena_));
+            ColumnSlot& slot = data_->slots_[id];
+            if (slot.kind_ != kind)
+            {
+                //Replacing a column of another kind moves it to the new kind's order list
+                std::vector<ColumnId>& newOrder = orderFor(kind);
+                if (slot.kind_ == DATASTORE_VALUE_NONE)
+                {
+                    newOrder.push_back(id);
+                }
+                else if (&orderFor(slot.kind_) != &newOrder)
+                {
+                    std::vector<ColumnId>& oldOrder = orderFor(slot.kind_);
+                    oldOrder.erase(std::find(oldOrder.begin(), oldOrder.end(), id));
+                    newOrder.push_back(id);
+                }
+                slot.stringData_.clear();
+                slot.objectData_.clear();
+                slot.scalarData_ = 0;
+                slot.kind_ = kind;
+            }
+            return(slot);
+        }
+
+        bool setScalar(ColumnId id, DataStoreValueType kind, boost::uint64_t bits)
+        {
+            if (!schema_ || id >= schema_->GetNumberColumns())return(false);
+            if (owner_ != nullptr)
+            {
+                unsigned char encoded[8];
+                size_t width = DataStoreValueWidth(kind);
+                DataStoreBinaryFormat::EncodeFixed(bits, width, encoded);
+                if (!owner_->columnChanging(row_, id, kind, encoded, width))return(false);
+            }
+            prepareSlot(id, kind).scalarData_ = bits;
+            return(true);
+        }
+
+        static const wchar_t* typeName(DataStoreValueType kind)
+        {
+            switch (kind)
+            {
+            case DATASTORE_VALUE_INT64:     return(L"int64");
+            case DATASTORE_VALUE_DOUBLE:    return(L"double");
+            case DATASTORE_VALUE_BOOL:      return(L"bool");
+            case DATASTORE_VALUE_TIMESTAMP: return(L"timestamp");
+            default:                        return(L"");
+            }
+        }
+
+        static DataStoreValueType parseTypeName(const DataStr& name)
+        {
+            if (name == L"int64")return(DATASTORE_VALUE_INT64);
+            if (name == L"double")return(DATASTORE_VALUE_DOUBLE);
+            if (name == L"bool")return(DATASTORE_VALUE_BOOL);
+            if (name == L"timestamp")return(DATASTORE_VALUE_TIMESTAMP);
+            return(DATASTORE_VALUE_NONE);
+        }
+
+        //Text form of a typed value; doubles are written with enough digits to read back exactly
+        static DataStr formatScalar(DataStoreValueType kind, boost::uint64_t bits)
+        {
+            if (kind == DATASTORE_VALUE_BOOL)return((bits != 0) ? L"true" : L"false");
+            if (kind == DATASTORE_VALUE_DOUBLE)return(boost::lexical_cast<DataStr>(DataStoreBinaryFormat::BitsToDouble(bits)));
+            return(boost::lexical_cast<DataStr>(static_cast<boost::int64_t>(bits)));
+        }
+
+        static bool parseScalar(DataStoreValueType kind, const DataStr& text, boost::uint64_t& bits)
+        {
+            try
+            {
+                if (kind == DATASTORE_VALUE_BOOL)
+                {
+                    if (text != L"true" && text != L"false")return(false);
+                    bits = (text == L"true") ? 1 : 0;
+                }
+                else if (kind == DATASTORE_VALUE_DOUBLE)
+                {
+                    bits = DataStoreBinaryFormat::DoubleToBits(boost::lexical_cast<double>(text));
+                }
+                else
+                {
+                    bits = static_cast<boost::uint64_t>(boost::lexical_cast<boost::int64_t>(text));
+                }
+            }
+            catch(boost::bad_lexical_cast& castEx)
+            {
+                return(false);
+            }
+            return(true);
+        }
+
+        std::vector<DataStr> getColumnNames(const std::vector<ColumnId>& order) const
+        {
+            std::vector<DataStr> rt;
+            rt.reserve(order.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                rt.push_back(schema_->GetName(order[i]));
+            }
+            return(rt);
+        }
+
+        //Re-keys the slots against another schema; a no-op when already bound to it
+        void bindSchema(const SchemaPtr& target)
+        {
+            if (schema_ == target)return;
+            if (!schema_ || data_->slots_.empty())
+            {
+                schema_ = target;
+                return;
+            }
+            std::vector<ColumnId> translation(data_->slots_.size(), static_cast<ColumnId>(DataStoreSchema::InvalidColumn));
+            for (size_t i = 0; i < data_->propertyColumns_.size(); ++i)
+            {
+                translation[data_->propertyColumns_[i]] = target->Intern(schema_->GetName(data_->propertyColumns_[i]));
+            }
+            for (size_t i = 0; i < data_->objectColumns_.size(); ++i)
+            {
+                translation[data_->objectColumns_[i]] = target->Intern(schema_->GetName(data_->objectColumns_[i]));
+            }
+            for (size_t i = 0; i < data_->typedColumns_.size(); ++i)
+            {
+                translation[data_->typedColumns_[i]] = target->Intern(schema_->GetName(data_->typedColumns_[i]));
+            }
+            remapSchema(target, translation);
+        }
+
+        //Moves every slot from its id in the current schema to translation[id] in the target
+        void remapSchema(const SchemaPtr& target, const std::vector<ColumnId>& translation)
+        {
+            mutableData();
+            SlotVector oldSlots(data_->slots_.get_allocator());
+            oldSlots.swap(data_->slots_);
+            std::vector<ColumnId> oldProperties;
+            std::vector<ColumnId> oldObjects;
+            std::vector<ColumnId> oldTyped;
+            oldProperties.swap(data_->propertyColumns_);
+            oldObjects.swap(data_->objectColumns_);
+            oldTyped.swap(data_->typedColumns_);
+            for (size_t i = 0; i < oldProperties.size(); ++i)
+            {
+                prepareSlot(translation[oldProperties[i]], DATASTORE_VALUE_STRING).stringData_.swap(oldSlots[oldProperties[i]].stringData_);
+            }
+            for (size_t i = 0; i < oldObjects.size(); ++i)
+            {
+                prepareSlot(translation[oldObjects[i]], DATASTORE_VALUE_BYTES).objectData_.swap(oldSlots[oldObjects[i]].objectData_);
+            }
+            for (size_t i = 0; i < oldTyped.size(); ++i)
+            {
+                const ColumnSlot& oldSlot = oldSlots[oldTyped[i]];
+                prepareSlot(translation[oldTyped[i]], oldSlot.kind_).scalarData_ = oldSlot.scalarData_;
+            }
+            schema_ = target;
+        }
+
+        //Records placed in a store's arena - see DataStore::createRecord
+        DataStoreRecord(IndexType id, const SchemaPtr& schema, DataStoreArena* arena) : 
+            rct::Object<DataStr>(recordName(id).c_str()),
+            id_(id),
+            schema_(schema),
+            owner_(nullptr),
+            row_(0),
+            arena_(arena),
+            data_(newData(arena))
+        {}
+
+        //Read only record over column data shared with a snapshot - see DataStore::Snapshot::Save
+        DataStoreRecord(IndexType id, const SchemaPtr& schema, const DataPtr& data) : 
+            rct::Object<DataStr>(recordName(id).c_str()),
+            id_(id),
+            schema_(schema),
+            owner_(nullptr),
+            row_(0),
+            arena_(nullptr),
+            data_(data)
+        {}
+    public:
+        explicit DataStoreRecord(IndexType id) : 
+            rct::Object<DataStr>(recordName(id).c_str()),
+            id_(id),
+            owner_(nullptr),
+            row_(0),
+            arena_(nullptr),
+            data_(newData(nullptr))
+        {}
+
+        DataStoreRecord(IndexType id, const SchemaPtr& schema) : 
+            rct::Object<DataStr>(recordName(id).c_str()),
+            id_(id),
+            schema_(schema),
+            owner_(nullptr),
+            row_(0),
+            arena_(nullptr),
+            data_(newData(nullptr))
+        {}
+
+        IndexType GetId() const
+        {
+            return(id_);
+        }
+
+        IndexType GetNumberPropertyColumns() const
+        {
+            return(data_->propertyColumns_.size());
+        }
+
+        IndexType GetNumberObjectColumns() const
+        {
+            return(data_->objectColumns_.size());
+        }
+
+        std::vector<DataStr> GetPropertyColumnNames() const
+        {
+            return(getColumnNames(data_->propertyColumns_));
+        }
+
+        std::vector<DataStr> GetObjectColumnNames() const
+        {
+            return(getColumnNames(data_->objectColumns_));
+        }
+
+        IndexType GetNumberTypedColumns() const
+        {
+            return(data_->typedColumns_.size());
+        }
+
+        std::vector<DataStr> GetTypedColumnNames() const
+        {
+            return(getColumnNames(data_->typedColumns_));
+        }
+
+        bool AddColumn(const DataStr& name, const DataStr& val)
+        {
+            if (name.empty())return(false);
+            return(AddColumn(schema().Intern(name), val));
+        }
+
+        bool AddColumn(const DataStr& name, rct::Object<>::UnknownObjValType val, rct::Object<>::UnknownObjSizeType size)
+        {
+            if (name.empty())return(false);
+            return(AddColumn(schema().Intern(name), val, size));
+        }
+
+        //Direct slot access by schema column id - see DataStore::GetColumnId
+        bool AddColumn(ColumnId id, const DataStr& val)
+        {
+            if (!schema_ || id >= schema_->GetNumberColumns())return(false);
+            //The owning store logs the change before it is applied
+            if (owner_ != nullptr && !owner_->propertyChanging(row_, id, val))return(false);
+            prepareSlot(id, DATASTORE_VALUE_STRING).stringData_.assign(val.data(), val.size());
+            return(true);
+        }
+
+        bool AddColumn(ColumnId id, rct::Object<>::UnknownObjValType val, rct::Object<>::UnknownObjSizeType size)
+        {
+            if (!schema_ || id >= schema_->GetNumberColumns() || (val == nullptr && size > 0))return(false);
+            if (owner_ != nullptr && !owner_->columnChanging(row_, id, DATASTORE_VALUE_BYTES, val, size))return(false);
+            const unsigned char* bytes = static_cast<const unsigned char*>(val);
+            prepareSlot(id, DATASTORE_VALUE_BYTES).objectData_.assign(bytes, bytes + size);
+            return(true);
+        }
+
+        //Typed columns keep their native value; bytes columns are the object AddColumn above
+        bool AddInt64Column(const DataStr& name, boost::int64_t val)
+        {
+            if (name.empty())return(false);
+            return(AddInt64Column(schema().Intern(name), val));
+        }
+
+        bool AddInt64Column(ColumnId id, boost::int64_t val)
+        {
+            return(setScalar(id, DATASTORE_VALUE_INT64, static_cast<boost::uint64_t>(val)));
+        }
+
+        bool AddDoubleColumn(const DataStr& name, double val)
+        {
+            if (name.empty())return(false);
+            return(AddDoubleColumn(schema().Intern(name), val));
+        }
+
+        bool AddDoubleColumn(ColumnId id, double val)
+        {
+            return(setScalar(id, DATASTORE_VALUE_DOUBLE, DataStoreBinaryFormat::DoubleToBits(val)));
+        }
+
+        bool AddBoolColumn(const DataStr& name, bool val)
+        {
+            if (name.empty())return(false);
+            return(AddBoolColumn(schema().Intern(name), val));
+        }
+
+        bool AddBoolColumn(ColumnId id, bool val)
+        {
+            return(setScalar(id, DATASTORE_VALUE_BOOL, val ? 1 : 0));
+        }
+
+        //Milliseconds since the Unix epoch
+        bool AddTimestampColumn(const DataStr& name, boost::int64_t val)
+        {
+            if (name.empty())return(false);
+            return(AddTimestampColumn(schema().Intern(name), val));
+        }
+
+        bool AddTimestampColumn(ColumnId id, boost::int64_t val)
+        {
+            return(setScalar(id, DATASTORE_VALUE_TIMESTAMP, static_cast<boost::uint64_t>(val)));
+        }
+
+        //Sets a column from the encoding used by files and logs: UTF-8, object bytes or a little endian fixed width value
+        bool AddEncodedColumn(ColumnId id, DataStoreValueType type, const unsigned char* data, size_t size)
+        {
+            if (type == DATASTORE_VALUE_STRING)
+            {
+                return(AddColumn(id, rct::UTF8String(std::string(reinterpret_cast<const char*>(data), size)).str()));
+            }
+            if (type == DATASTORE_VALUE_BYTES)
+            {
+                return(AddColumn(id, static_cast<rct::Object<>::UnknownObjValType>(const_cast<unsigned char*>(data)), static_cast<rct::Object<>::UnknownObjSizeType>(size)));
+            }
+            size_t width = DataStoreValueWidth(type);
+            if (width == 0 || size != width)return(false);
+            return(setScalar(id, type, DataStoreBinaryFormat::DecodeFixed(data, width)));
+        }
+
+        DataStoreValueType GetColumnType(ColumnId id) const
+        {
+            return(data_->GetColumnType(id));
+        }
+
+        bool GetInt64Column(ColumnId id, boost::int64_t& val) const
+        {
+            return(data_->GetInt64Column(id, val));
+        }
+
+        bool GetDoubleColumn(ColumnId id, double& val) const
+        {
+            return(data_->GetDoubleColumn(id, val));
+        }
+
+        bool GetBoolColumn(ColumnId id, bool& val) const
+        {
+            return(data_->GetBoolColumn(id, val));
+        }
+
+        bool GetTimestampColumn(ColumnId id, boost::int64_t& val) const
+        {
+            return(data_->GetTimestampColumn(id, val));
+        }
+
+        //Any typed column as a double, for aggregation without going through strings
+        bool GetNumericColumn(ColumnId id, double& val) const
+        {
+            return(data_->GetNumericColumn(id, val));
+        }
+
+        bool GetColumn(const DataStr& name, RecordResult&& result) const
+        {
+            if (name.empty())
+            {
+                result = std::move(RecordResult(nullptr));
+                return(false);
+            }
+            ColumnId id = DataStoreSchema::InvalidColumn;
+            if (!schema_ || !schema_->Find(name, id))return(false);
+            return(GetColumn(id, std::move(result)));
+        }
+
+        bool GetColumn(ColumnId id, RecordResult&& result) const
+        {
+            return(data_->GetColumn(id, std::move(result)));
+        }
+
+        const SchemaPtr& GetSchema() const
+        {
+            return(schema_);
+        }
+
+        //Heap copy with its own copy of the column dictionary, detached from any store
+        DataStoreRecord* Clone() const
+        {
+            DataStoreRecord* rt = new DataStoreRecord(id_, copySchema(schema_));
+            //Slot by slot, so the copy's payloads go to the heap rather than this record's arena
+            rt->data_->slots_.resize(data_->slots_.size());
+            for (size_t i = 0; i < data_->slots_.size(); ++i)
+            {
+                ColumnSlot& slot = rt->data_->slots_[i];
+                slot.stringData_.assign(data_->slots_[i].stringData_.data(), data_->slots_[i].stringData_.size());
+                slot.objectData_.assign(data_->slots_[i].objectData_.begin(), data_->slots_[i].objectData_.end());
+                slot.scalarData_ = data_->slots_[i].scalarData_;
+                slot.kind_ = data_->slots_[i].kind_;
+            }
+            rt->data_->propertyColumns_ = data_->propertyColumns_;
+            rt->data_->objectColumns_ = data_->objectColumns_;
+            rt->data_->typedColumns_ = data_->typedColumns_;
+            return(rt);
+        }
+
+        bool OutputToStream(std::wostream& output)
+        {
+            //Output id and counters; the typed counter is only written when needed so older readers still load the file
+            output << id_ << '|' << data_->propertyColumns_.size() << '|' << data_->objectColumns_.size() << '|';
+            if (!this->data_->typedColumns_.empty())output << data_->typedColumns_.size() << '|';
+            output << L"\r\n";
+            //Output string objects
+            if (!this->data_->propertyColumns_.empty())
+            {
+                output << L"PROPERTIES" << '|' << this->data_->propertyColumns_.size() << '|' << L"\r\n";
+                std::vector<ColumnId>::const_iterator pIter = this->data_->propertyColumns_.begin();
+                std::vector<ColumnId>::const_iterator eIter = this->data_->propertyColumns_.end();
+                for (; pIter != eIter; ++pIter)
+                {
+                    rct::UTF8String firstS(schema_->GetName(*pIter));
+                    rct::UTF8String secondS(data_->slots_[*pIter].GetString());
+                    output << L'\"' << firstS.str() << L'\"' << L':' << L'\"' << secondS.str() << L'\"' << L"\r\n";
+                }
+                output << "\r\n";
+            }
+            if (!this->data_->objectColumns_.empty())
+            {
+                output << L"OBJECTS" << L'|' << this->data_->objectColumns_.size() << L'|' << L"\r\n";
+                std::vector<ColumnId>::const_iterator pIter = this->data_->objectColumns_.begin();
+                std::vector<ColumnId>::const_iterator eIter = this->data_->objectColumns_.end();
+                //One buffer for every column; it only grows when a larger object comes along
+                DataStr hexData;
+                for (; pIter != eIter; ++pIter)
+                {
+                    const SlotBytes& obj = data_->slots_[*pIter].objectData_;
+                    if (obj.size() > 0)
+                    {
+                        hexData.resize(obj.size() * 2);
+                        DataStoreHex::Encode(&obj[0], obj.size(), &hexData[0]);
+
+                        rct::UTF8String firstS(schema_->GetName(*pIter));
+                        output << L'\"' << firstS.str() << L'\"' << L':' << L'\"' << obj.size() << L'\"' << L':' << L'\"';
+                        output.write(hexData.data(), hexData.size());
+                        output << L'\"' << L"\r\n";
+                    }
+                }
+                output << L"\r\n";
+            }
+            if (!this->data_->typedColumns_.empty())
+            {
+                output << L"TYPED" << L'|' << this->data_->typedColumns_.size() << L'|' << L"\r\n";
+                std::vector<ColumnId>::const_iterator pIter = this->data_->typedColumns_.begin();
+                std::vector<ColumnId>::const_iterator eIter = this->data_->typedColumns_.end();
+                for (; pIter != eIter; ++pIter)
+                {
+                    const ColumnSlot& slot = data_->slots_[*pIter];
+                    rct::UTF8String firstS(schema_->GetName(*pIter));
+                    output << L'\"' << firstS.str() << L'\"' << L':' << L'\"' << typeName(slot.kind_) << L'\"' << L':' << L'\"' << formatScalar(slot.kind_, slot.scalarData_) << L'\"' << L"\r\n";
+                }
+                output << L"\r\n";
+            }
+            output.flush();
+            return(true);
+        }
+
+        bool InputFromStream(std::wistream& input)
+        {
+            DataStr::value_type firstLineBuffer[2048];
+            DataStr::value_type tempChar;
+            std::wstring endLine;
+            //std::istream& iStr = input.getline(firstLineBuffer, 2048, '|');
+            //Read Id, next column idx, and next object column idx
+            IndexType columnSz = 0;
+            IndexType colObjSz = 0;
+            input >> id_ >> tempChar >> columnSz >> tempChar >> colObjSz >> tempChar;// >> endLine;
+            //Typed column counter - only present when the record has typed columns
+            IndexType typedSz = 0;
+            if (input.peek() >= L'0' && input.peek() <= L'9')
+            {
+                input >> typedSz >> tempChar;
+            }
+
+            //Create the tokenizer
+            typedef boost::tokenizer<boost::char_separator<DataStr::value_type>, DataStr::const_iterator, DataStr> TokenizerType;
+            boost::char_separator<DataStr::value_type> sep(L":|\'\"");
+
+            //See if we even have any properties
+            if (columnSz > 0)
+            {
+                DataStr workstring;
+                DataStr propertiesId;
+                IndexType amountProps = 0;
+                input >> workstring;
+                TokenizerType tokens(workstring, sep);
+                TokenizerType::const_iterator tokIter = tokens.begin();
+                propertiesId = rct::UTF8String(*tokIter).c_str();
+                ++tokIter;
+                amountProps = boost::lexical_cast<IndexType, DataStr>(rct::UTF8String(*tokIter).c_str());
+                
+                //Amount props should match column size
+                if (propertiesId == L"PROPERTIES" && columnSz == amountProps)
+                {
+                    rct::UTF8String propName;
+                    rct::UTF8String propVal;
+                    for (unsigned int i = 0; i < amountProps; ++i)
+                    {
+                        try
+                        {
+                            input >> workstring;
+                            tokens.assign(workstring, sep);
+                            tokIter = tokens.begin();
+                            const DataStr pName = *tokIter;
+                            ++tokIter;
+                            const DataStr pVal = *tokIter; 
+                            this->AddColumn(pName, pVal);
+                            //std::string propNameS = propName.nstr();
+                            //std::string propValS = propVal.nstr();
+                        }
+                        catch(std::runtime_error& rErr)
+                        {
+                        }
+                        catch(std::exception& rEx)
+                        {
+                        }
+                        catch(...)
+                        {
+                        }
+                    }
+                }
+                else
+                {
+                    //Error
+                    return(false);
+                }
+            }
+
+            //See if we have any object properties
+            if (colObjSz > 0)
+            {
+                DataStr workstring;
+                DataStr objectsId;
+                IndexType amountObjProps;
+                input >> workstring;//objectsId >> tempChar >> amountObjProps >> tempChar >> endLine;
+                TokenizerType tokens(workstring, sep);
+                TokenizerType::const_iterator tokIter = tokens.begin();
+                objectsId = rct::UTF8String(*tokIter).c_str();
+                ++tokIter;
+                amountObjProps = boost::lexical_cast<IndexType, DataStr>(rct::UTF8String(*tokIter).c_str());
+
+                //Amount obj props should match column size
+                if (objectsId == L"OBJECTS" && colObjSz == amountObjProps)
+                {
+                    std::vector<unsigned char> objectData;
+                    for (unsigned int i = 0; i < colObjSz; ++i)
+                    {
+                        rct::UTF8String propName;
+                        IndexType propSize;
+                        input >> workstring; //quoteChar >> propName >> quoteChar >> semiColonChar >> quoteChar >> propSize >> quoteChar >> semiColonChar >> quoteChar >> propData >> quoteChar >> tempChar >> endLine;
+                        tokens.assign(workstring, sep);
+                        tokIter = tokens.begin();
+                        propName.Set(*tokIter);
+                        ++tokIter;
+                        propSize = boost::lexical_cast<IndexType, DataStr>(rct::UTF8String(*tokIter).c_str());
+                        ++tokIter;
+                        //Decode the hex straight from the token into a buffer reused for every column
+                        const DataStr& hexData = *tokIter;
+                        if (propSize == 0 || hexData.size() != propSize * 2)
+                        {
+                            //Error occurred - object size does not match its hex
+                            return(false);
+                        }
+                        objectData.resize(propSize);
+                        if (!DataStoreHex::Decode(hexData.data(), propSize, &objectData[0]))
+                        {
+                            //Error occurred - not valid hex
+                            return(false);
+                        }
+                        AddColumn(propName.c_str(), static_cast<void*>(&objectData[0]), propSize);
+                    }
+                    //Read next endline
+//                    input >> endLine;
+                }
+                else
+                {
+                    //Error
+                    return(false);
+                }
+            }
+
+            //See if we have any typed columns
+            if (typedSz > 0)
+            {
+                DataStr workstring;
+                input >> workstring;
+                TokenizerType tokens(workstring, sep);
+                std::vector<DataStr> fields(tokens.begin(), tokens.end());
+                //Amount typed should match the typed column size
+                if (fields.size() != 2 || fields[0] != L"TYPED" || fields[1] != boost::lexical_cast<DataStr>(typedSz))
+                {
+                    //Error
+                    return(false);
+                }
+                for (IndexType i = 0; i < typedSz; ++i)
+                {
+                    input >> workstring;
+                    tokens.assign(workstring, sep);
+                    fields.assign(tokens.begin(), tokens.end());
+                    DataStoreValueType kind = (fields.size() == 3) ? parseTypeName(fields[1]) : DATASTORE_VALUE_NONE;
+                    boost::uint64_t bits = 0;
+                    if (kind == DATASTORE_VALUE_NONE || !parseScalar(kind, fields[2], bits) || !setScalar(schema().Intern(fields[0]), kind, bits))
+                    {
+                        //Error occurred - malformed typed value
+                        return(false);
+                    }
+                }
+            }
+            return(true);
+        }
+    };
+public:
+    //! Point in time view of the store from GetSnapshot; cheap to copy and usable from any thread
+    /*!
+     * A snapshot shares the column data of every record with the store.
+     * Records changed afterwards copy their column data first, so the
+     * snapshot keeps the values it was taken with while ingestion carries
+     * on.  It has its own copy of the column dictionary and keeps the
+     * store's arena memory alive if the store is cleared or destroyed.
+     */
+    class Snapshot
+    {
+        friend class DataStore;
+    private:
+        struct Rows
+        {
+            boost::shared_ptr<DataStoreArena> arena_;
+            DataStore::DataStoreRecord::SchemaPtr schema_;
+            std::vector<IndexType> ids_;
+            std::vector<DataStore::DataStoreRecord::DataPtr> data_;
+            unsigned int ioThreads_;
+            DataStoreCompression::Codec compression_;
+            Rows() : ioThreads_(0), compression_(DataStoreCompression::CODEC_NONE) {}
+        };
+    public:
+        //! Read only view of one record; valid while the snapshot it came from is held
+        class Record
+        {
+            friend class Snapshot;
+        private:
+            const DataStore::DataStoreRecord::ColumnData* data_;
+            const DataStoreSchema* schema_;
+            IndexType id_;
+        public:
+            Record() : data_(nullptr), schema_(nullptr), id_(0) {}
+
+            IndexType GetId() const
+            {
+                return(id_);
+            }
+
+            DataStoreValueType GetColumnType(DataStoreSchema::ColumnId id) const
+            {
+                return(data_->GetColumnType(id));
+            }
+
+            bool GetColumn(const DataStr& name, DataStore::DataStoreRecord::RecordResult&& result) const
+            {
+                DataStoreSchema::ColumnId id = DataStoreSchema::InvalidColumn;
+                if (name.empty() || !schema_->Find(name, id))return(false);
+                return(data_->GetColumn(id, std::move(result)));
+            }
+
+            bool GetColumn(DataStoreSchema::ColumnId id, DataStore::DataStoreRecord::RecordResult&& result) const
+            {
+                return(data_->GetColumn(id, std::move(result)));
+            }
+
+            bool GetInt64Column(DataStoreSchema::ColumnId id, boost::int64_t& val) const
+            {
+                return(data_->GetInt64Column(id, val));
+            }
+
+            bool GetDoubleColumn(DataStoreSchema::ColumnId id, double& val) const
+            {
+                return(data_->GetDoubleColumn(id, val));
+            }
+
+            bool GetBoolColumn(DataStoreSchema::ColumnId id, bool& val) const
+            {
+                return(data_->GetBoolColumn(id, val));
+            }
+
+            bool GetTimestampColumn(DataStoreSchema::ColumnId id, boost::int64_t& val) const
+            {
+                return(data_->GetTimestampColumn(id, val));
+            }
+
+            bool GetNumericColumn(DataStoreSchema::ColumnId id, double& val) const
+            {
+                return(data_->GetNumericColumn(id, val));
+            }
+        };
+    private:
+        boost::shared_ptr<const Rows> rows_;
+    private:
+        explicit Snapshot(const boost::shared_ptr<const Rows>& rows) : rows_(rows) {}
+    public:
+        //Empty until filled by DataStore::GetSnapshot
+        Snapshot() : rows_(boost::make_shared<Rows>()) {}
+
+        IndexType GetNumberRecords() const
+        {
+            return(rows_->data_.size());
+        }
+
+        //Column ids of the snapshot match the store's ids when it was taken
+        bool GetColumnId(const DataStr& name, DataStoreSchema::ColumnId& id) const
+        {
+            return(rows_->schema_ && rows_->schema_->Find(name, id));
+        }
+
+        bool GetDataRecord(IndexType row, Record& record) const
+        {
+            if (row >= rows_->data_.size())return(false);
+            record.data_ = rows_->data_[row].get();
+            record.schema_ = rows_->schema_.get();
+            record.id_ = rows_->ids_[row];
+            return(true);
+        }
+
+        //Writes the snapshot with the store's thread count and compression; the records written
+        //share the snapshot's column data, so nothing is copied
+        bool Save(const rct::UTF8String& fileName, StorageFormat format = DATASTORE_FORMAT_BINARY) const
+        {
+            std::vector<DataStore::DataStoreRecord*> views;
+            views.reserve(rows_->data_.size());
+            bool rt = true;
+            {
+                DataStore store(L"snapshot");
+                //A snapshot that was never filled saves as an empty store
+                if (rows_->schema_)store.schema_ = rows_->schema_;
+                store.SetThreadCount(rows_->ioThreads_);
+                store.SetCompression(rows_->compression_);
+                for (size_t i = 0; rt && i < rows_->data_.size(); ++i)
+                {
+                    views.push_back(new DataStore::DataStoreRecord(rows_->ids_[i], rows_->schema_, rows_->data_[i]));
+                    rt = store.AddRecord(views.back());
+                }
+                rt = rt && store.Save(fileName, format);
+            }
+            //The temporary store has let go of the records
+            for (size_t i = 0; i < views.size(); ++i)delete views[i];
+            return(rt);
+        }
+    };
+protected:
+    //Run of whole records parsed by one load worker
+    struct TextChunk
+    {
+        std::wstring text_;
+        DataStore::DataStoreRecord::SchemaPtr schema_;
+        std::vector<DataStore::DataStoreRecord*> records_;
+        //Filled by one worker, then adopted by the store arena
+        DataStoreArena* arena_;
+        TextChunk() : arena_(nullptr) {}
+    };
+
+    //Stores smaller than this are loaded and saved on the calling thread
+    static const IndexType ParallelRecordThreshold = 4096;
+    static const size_t TextBatchSize = 1024;
+    static const size_t TextChunkChars = 256 * 1024;
+
+    bool AddRecord(DataStore::DataStoreRecord* record)
+    {
+        //Mapped stores are read only; a record belongs to one store
+        if (mappedFile_ != nullptr || record == nullptr || record->owner_ != nullptr)return(false);
+        //Records share the store's column dictionary from here on
+        record->bindSchema(schema_);
+        //Row ids are dense - the row id is the position in the record table
+        record->owner_ = this;
+        record->row_ = records_.size();
+        records_.push_back(record);
+        if (columnStore_ != nullptr)this->addColumnStoreRow(record);
+        this->indexRecord(record);
+        nextRowIdx_++;
+        return(true);
+    }
+
+    bool GetRecord(IndexType id, DataStore::DataStoreRecord** record)
+    {
+        if (record == nullptr || id >= records_.size())return(false);
+        if (records_[id] == nullptr && !this->materializeRecord(id))return(false);
+        *record = records_[id];
+        return(true);
+    }
+
+    //Row names are the decimal row ids, so the name resolves by parsing it instead of a string keyed lookup
+    bool GetRecord(const DataStr& id, DataStore::DataStoreRecord** record)
+    {
+        IndexType rowIdx = 0;
+        if (!ParseRowId(id, rowIdx))return(false);
+        return(GetRecord(rowIdx, record));
+    }
+
+    bool GetRecords(std::vector<DataStore::DataStoreRecord*>& result)
+    {
+        if (records_.empty() || !this->materializeAll())return(false);
+        result.insert(result.end(), records_.begin(), records_.end());
+        return(true);
+    }
+
+    static bool ParseRowId(const DataStr& name, IndexType& id)
+    {
+        //Canonical decimal only ("%d" never writes signs or leading zeros)
+        if (name.empty() || (name.size() > 1 && name[0] == L'0'))return(false);
+        IndexType val = 0;
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            DataStr::value_type ch = name[i];
+            if (ch < L'0' || ch > L'9')return(false);
+            IndexType next = val * 10 + static_cast<IndexType>(ch - L'0');
+            if (next / 10 != val)return(false);
+            val = next;
+        }
+        id = val;
+        return(true);
+    }
+
+    //An empty store writes just the record count, which ReadFromFile loads back as an empty store
+    bool WriteToFile(const rct::UTF8String& fileName)
+    {
+        rct::FileWriter fWriter;
+        if (fWriter.OpenFile(fileName, false, true))
+        {           
+            fWriter.WriteLine(boost::str(boost::format("%d") % nextRowIdx_));
+            std::vector<DataStore::DataStoreRecord*> records;
+            bool failure = false;
+            if (records_.size() >= ParallelRecordThreshold && ioThreads_ != 1)
+            {
+                //Serialize batches concurrently and write them in order, one wave of batches at a time
+                unsigned int threads = (ioThreads_ == 0) ? WorkerPool::DefaultThreadCount() : ioThreads_;
+                size_t batchCount = (records_.size() + TextBatchSize - 1) / TextBatchSize;
+                std::vector<std::wstring> buffers(threads * 2);
+                for (size_t firstBatch = 0; firstBatch < batchCount && !failure; firstBatch += buffers.size())
+                {
+                    size_t waveCount = std::min(buffers.size(), batchCount - firstBatch);
+                    WorkerPool::ParallelFor(waveCount, threads,
+                        boost::bind(&DataStore::serializeTextBatch, this, firstBatch, boost::ref(buffers), _1));
+                    for (size_t i = 0; i < waveCount && !failure; ++i)
+                    {
+                        failure = !fWriter.Write(buffers[i]);
+                        buffers[i].clear();
+                    }
+                }
+            }
+            else if (GetRecords(records))
+            {
+                std::vector<DataStore::DataStoreRecord*>::iterator cIter = records.begin();
+                std::vector<DataStore::DataStoreRecord*>::iterator eIter = records.end();
+                for (; cIter != eIter; ++cIter)
+                {
+                    std::wstringstream buffer;
+                    DataStore::DataStoreRecord* curRecord = static_cast<DataStore::DataStoreRecord*>(*cIter);
+                    if (curRecord == nullptr)continue;
+                    curRecord->OutputToStream(buffer);
+                    if (!fWriter.Write(buffer.str()))
+                    {
+                        failure = true;
+                        break;
+                    }
+                }
+            }
+            if (!failure)
+            {
+                failure = !fWriter.CloseFile();
+            }
+            return(!failure);
+        }
+        return(false);
+    }
+
+    bool ReadFromFile(const rct::UTF8String& fileName)
+    {
+        //Reset data
+        this->ResetRecords();
+        this->generation_ = 0;
+        //Records are streamed out of a bounded buffer rather than reading the whole file up front
+        DataStoreTextStream textStream;
+        unsigned long recordCount = 0;
+        if (!textStream.Open(fileName.nstr(), recordCount))
+        {
+            //Error occured - could not open file or read the record count
+            return(false);
+        }
+        if (recordCount == 0)
+        {
+            //Empty store - nothing follows the count
+            return(true);
+        }
+        this->records_.reserve(recordCount);
+        if (recordCount >= ParallelRecordThreshold && ioThreads_ != 1)
+        {
+            return(this->parseTextParallel(textStream, recordCount));
+        }
+        std::wstring recordText;
+        for (unsigned long i = 0; i < recordCount; ++i)
+        {
+            if (!textStream.ReadRecords(recordText, 1))
+            {
+                //Error occurred - file ended before every record was read
+                return(false);
+            }
+            std::wistringstream iStr(recordText);
+            //Create new data record with id of 0, id's are read in by the data store record class
+            DataStore::DataStoreRecord* dStoreRec = this->createRecord(0, schema_, arena_);
+            if (!dStoreRec->InputFromStream(iStr))
+            {
+                //Error occurred - could not read from the input stream
+                this->destroyRecord(dStoreRec);
+                return(false);
+            }
+            if (!this->AddRecord(dStoreRec))
+            {
+                //Error occurred - could not add record to the data store
+                this->destroyRecord(dStoreRec);
+                return(false);
+            }
+        }
+        //If we get here, we are successful
+        return(true);
+    }
+
+    //An empty store is a header, the column dictionary and an empty record id block
+    bool WriteToBinaryFile(const rct::UTF8String& fileName)
+    {
+        const std::vector<DataStore::DataStoreRecord*>& records = records_;
+
+        //The store schema is the column dictionary; work out which kinds each column has
+        const DataStoreSchema& schema = *schema_;
+        std::set<std::pair<boost::uint32_t, DataStoreBinaryFormat::BlockType>> blocks;
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            DataStore::DataStoreRecord* curRecord = records[i];
+            for (size_t c = 0; c < curRecord->data_->propertyColumns_.size(); ++c)
+            {
+                blocks.insert(std::make_pair(curRecord->data_->propertyColumns_[c], DataStoreBinaryFormat::BLOCK_PROPERTY_COLUMN));
+            }
+            for (size_t c = 0; c < curRecord->data_->objectColumns_.size(); ++c)
+            {
+                blocks.insert(std::make_pair(curRecord->data_->objectColumns_[c], DataStoreBinaryFormat::BLOCK_OBJECT_COLUMN));
+            }
+            //Typed columns get one block per value type used in them
+            for (size_t c = 0; c < curRecord->data_->typedColumns_.size(); ++c)
+            {
+                DataStoreSchema::ColumnId id = curRecord->data_->typedColumns_[c];
+                blocks.insert(std::make_pair(id, DataStoreBinaryFormat::BlockTypeFor(curRecord->data_->slots_[id].kind_)));
+            }
+        }
+
+        std::ofstream output(fileName.nstr().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!output.is_open())return(false);
+
+        //File header and column dictionary
+        DataStoreBinaryFormat::BinaryWriter writer;
+        DataStoreBinaryFormat::FileHeader header;
+        header.version_ = DataStoreBinaryFormat::Version;
+        header.flags_ = DataStoreBinaryFormat::FLAG_BLOCK_INDEX;
+        header.recordCount_ = records.size();
+        header.columnCount_ = static_cast<boost::uint32_t>(schema.GetNumberColumns());
+        header.blockCount_ = static_cast<boost::uint32_t>(blocks.size() + 1);
+        header.generation_ = generation_;
+        DataStoreBinaryFormat::WriteFileHeader(writer, header);
+        size_t dictStart = writer.GetSize();
+        for (size_t i = 0; i < schema.GetNumberColumns(); ++i)
+        {
+            writer.WriteString(rct::UTF8String(schema.GetName(static_cast<DataStoreSchema::ColumnId>(i))).nstr());
+        }
+        writer.WriteUInt32(DataStoreBinaryFormat::ComputeCRC(writer.GetData() + dictStart, writer.GetSize() - dictStart));
+        writer.Align();
+
+        //Record id block; the offset of every block header goes into the index at the end of the file
+        std::vector<boost::uint64_t> blockOffsets;
+        blockOffsets.reserve(header.blockCount_);
+        blockOffsets.push_back(writer.GetSize());
+        DataStoreBinaryFormat::BinaryWriter idPayload;
+        idPayload.Reserve(records.size() * 8);
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            idPayload.WriteUInt64(records[i]->id_);
+        }
+        DataStoreBinaryFormat::BlockHeader idHeader;
+        idHeader.blockType_ = DataStoreBinaryFormat::BLOCK_RECORD_IDS;
+        idHeader.columnIdx_ = 0;
+        idHeader.rowCount_ = records.size();
+        idHeader.offsetWidth_ = 0;
+        DataStoreBinaryFormat::WriteBlock(writer, idHeader, idPayload.GetData(), idPayload.GetSize(), compression_);
+        output.write(reinterpret_cast<const char*>(writer.GetData()), writer.GetSize());
+        boost::uint64_t fileOffset = writer.GetSize();
+        writer.Clear();
+
+        //One block per column; blocks are built concurrently a wave at a time and flushed in order
+        std::vector<std::pair<boost::uint32_t, DataStoreBinaryFormat::BlockType>> blockList(blocks.begin(), blocks.end());
+        unsigned int threads = (ioThreads_ == 0) ? WorkerPool::DefaultThreadCount() : ioThreads_;
+        if (records.size() < ParallelRecordThreshold)threads = 1;
+        std::vector<DataStoreBinaryFormat::BinaryWriter> blockWriters(threads);
+        for (size_t firstBlock = 0; firstBlock < blockList.size() && output.good(); firstBlock += blockWriters.size())
+        {
+            size_t waveCount = std::min(blockWriters.size(), blockList.size() - firstBlock);
+            WorkerPool::ParallelFor(waveCount, threads,
+                boost::bind(&DataStore::buildColumnBlock, this, boost::cref(blockList), firstBlock, boost::ref(blockWriters), _1));
+            for (size_t i = 0; i < waveCount; ++i)
+            {
+                blockOffsets.push_back(fileOffset);
+                output.write(reinterpret_cast<const char*>(blockWriters[i].GetData()), blockWriters[i].GetSize());
+                fileOffset += blockWriters[i].GetSize();
+                blockWriters[i].Clear();
+            }
+        }
+        DataStoreBinaryFormat::WriteBlockIndex(writer, blockOffsets);
+        output.write(reinterpret_cast<const char*>(writer.GetData()), writer.GetSize());
+        output.close();
+        return(!output.fail());
+    }
+
+    bool buildColumnBlock(const std::vector<std::pair<boost::uint32_t, DataStoreBinaryFormat::BlockType>>& blockList, size_t firstBlock, std::vector<DataStoreBinaryFormat::BinaryWriter>& writers, size_t idx)
+    {
+        const std::pair<boost::uint32_t, DataStoreBinaryFormat::BlockType>& block = blockList[firstBlock + idx];
+        DataStoreValueType kind = DataStoreBinaryFormat::ValueTypeFor(block.second);
+        size_t width = DataStoreValueWidth(kind);
+        if (width > 0)
+        {
+            DataStoreBinaryFormat::FixedColumnBlockBuilder fixedBuilder(records_.size(), width);
+            for (size_t i = 0; i < records_.size(); ++i)
+            {
+                const DataStore::DataStoreRecord::ColumnSlot* slot = records_[i]->getSlot(block.first);
+                if (slot == nullptr || slot->kind_ != kind)fixedBuilder.AddNull();
+                else fixedBuilder.AddValue(slot->scalarData_);
+            }
+            fixedBuilder.Write(writers[idx], block.second, block.first, compression_);
+            return(true);
+        }
+        DataStoreBinaryFormat::ColumnBlockBuilder builder(records_.size());
+        for (size_t i = 0; i < records_.size(); ++i)
+        {
+            const DataStore::DataStoreRecord::ColumnSlot* slot = records_[i]->getSlot(block.first);
+            if (slot == nullptr || slot->kind_ != kind)
+            {
+                builder.AddNull();
+            }
+            else if (kind == DATASTORE_VALUE_BYTES)
+            {
+                builder.AddValue(slot->objectData_.empty() ? nullptr : &slot->objectData_[0], slot->objectData_.size());
+            }
+            else
+            {
+                std::string utf8Val = rct::UTF8String(slot->GetString()).nstr();
+                builder.AddValue(utf8Val.data(), utf8Val.size());
+            }
+        }
+        builder.Write(writers[idx], block.second, block.first, compression_);
+        return(true);
+    }
+
+    bool serializeTextBatch(size_t firstBatch, std::vector<std::wstring>& buffers, size_t idx)
+    {
+        size_t begin = (firstBatch + idx) * TextBatchSize;
+        size_t end = std::min(begin + TextBatchSize, records_.size());
+        std::wstringstream buffer;
+        for (size_t i = begin; i < end; ++i)
+        {
+            records_[i]->OutputToStream(buffer);
+        }
+        buffers[idx] = buffer.str();
+        return(true);
+    }
+
+    bool parseTextChunk(std::vector<TextChunk>& chunks, size_t idx)
+    {
+        //Each chunk interns into its own schema so workers never share one
+        TextChunk& chunk = chunks[idx];
+        chunk.schema_ = boost::make_shared<DataStoreSchema>();
+        chunk.arena_ = new DataStoreArena();
+        std::wistringstream iStr(chunk.text_);
+        for (;;)
+        {
+            iStr >> std::ws;
+            if (iStr.eof())break;
+            DataStore::DataStoreRecord* dStoreRec = this->createRecord(0, chunk.schema_, *chunk.arena_);
+            chunk.records_.push_back(dStoreRec);
+            if (!dStoreRec->InputFromStream(iStr) || iStr.fail())return(false);
+        }
+        return(true);
+    }
+
+    bool parseTextParallel(DataStoreTextStream& textStream, IndexType recordCount)
+    {
+        //Pull a window of record aligned chunks from the stream, parse them concurrently, append in order, repeat
+        unsigned int threads = (ioThreads_ == 0) ? WorkerPool::DefaultThreadCount() : ioThreads_;
+        std::vector<TextChunk> chunks(threads * 2);
+        bool success = true;
+        bool moreText = true;
+        while (success && moreText && records_.size() < recordCount)
+        {
+            size_t chunkCount = 0;
+            for (; chunkCount < chunks.size(); ++chunkCount)
+            {
+                TextChunk& chunk = chunks[chunkCount];
+                chunk.records_.clear();
+                if (!textStream.ReadRecords(chunk.text_, TextChunkChars))
+                {
+                    moreText = false;
+                    break;
+                }
+            }
+            success = WorkerPool::ParallelFor(chunkCount, threads,
+                boost::bind(&DataStore::parseTextChunk, this, boost::ref(chunks), _1));
+            success = this->appendTextChunks(chunks, chunkCount, success);
+        }
+        return(success && records_.size() == recordCount);
+    }
+
+    bool appendTextChunks(std::vector<TextChunk>& chunks, size_t chunkCount, bool success)
+    {
+        //Re-key each chunk onto the store schema with one translation table per chunk, in file order
+        for (size_t i = 0; i < chunkCount; ++i)
+        {
+            TextChunk& chunk = chunks[i];
+            std::vector<DataStoreSchema::ColumnId> translation;
+            if (success)
+            {
+                translation.reserve(chunk.schema_->GetNumberColumns());
+                for (size_t c = 0; c < chunk.schema_->GetNumberColumns(); ++c)
+                {
+                    translation.push_back(schema_->Intern(chunk.schema_->GetName(static_cast<DataStoreSchema::ColumnId>(c))));
+                }
+            }
+            for (size_t r = 0; r < chunk.records_.size(); ++r)
+            {
+                if (success)
+                {
+                    chunk.records_[r]->remapSchema(schema_, translation);
+                    success = this->AddRecord(chunk.records_[r]);
+                    if (success)continue;
+                }
+                //Error occurred - records not yet added to the store are discarded
+                this->destroyRecord(chunk.records_[r]);
+            }
+            arena_.Adopt(chunk.arena_);
+            chunk.arena_ = nullptr;
+        }
+        return(success);
+    }
+
+    bool ReadFromBinaryFile(const rct::UTF8String& fileName)
+    {
+        //Reset data
+        this->ResetRecords();
+        std::vector<unsigned char> fileData;
+        if (!DataStoreBinaryFormat::ReadFileBytes(fileName.nstr(), fileData))
+        {
+            //Error occured - could not read file
+            return(false);
+        }
+        DataStoreBinaryFormat::BinaryReader reader(&fileData[0], fileData.size());
+        DataStoreBinaryFormat::FileHeader header;
+        if (!DataStoreBinaryFormat::ReadFileHeader(reader, header))
+        {
+            //Error occurred - not a binary data store or header is damaged
+            return(false);
+        }
+        this->generation_ = header.generation_;
+
+        //Column dictionary - interned straight into the store schema
+        std::vector<DataStoreSchema::ColumnId> columnIds;
+        columnIds.reserve(header.columnCount_);
+        const unsigned char* dictStart = reader.GetCurrent();
+        for (boost::uint32_t i = 0; i < header.columnCount_; ++i)
+        {
+            std::string name;
+            if (!reader.ReadString(name))return(false);
+            columnIds.push_back(schema_->Intern(rct::UTF8String(name).str()));
+        }
+        size_t dictSize = reader.GetCurrent() - dictStart;
+        boost::uint32_t dictCrc = 0;
+        if (!reader.ReadUInt32(dictCrc) || dictCrc != DataStoreBinaryFormat::ComputeCRC(dictStart, dictSize))return(false);
+        if (!reader.Align())return(false);
+
+        //Blocks are checked and decompressed independently, so large files do it in parallel
+        std::vector<DataStoreBinaryFormat::BlockRef> blocks;
+        if (!DataStoreBinaryFormat::LocateBlocks(&fileData[0], fileData.size(), reader.GetPosition(), header, blocks))
+        {
+            //Error occurred - truncated file or damaged block index
+            return(false);
+        }
+        std::vector<std::vector<unsigned char>> inflated(blocks.size());
+        unsigned int threads = (ioThreads_ == 0) ? WorkerPool::DefaultThreadCount() : ioThreads_;
+        if (header.recordCount_ < ParallelRecordThreshold)threads = 1;
+        if (!WorkerPool::ParallelFor(blocks.size(), threads,
+            boost::bind(&DataStore::inflateBlock, this, boost::ref(blocks), boost::ref(inflated), _1)))
+        {
+            //Error occurred - damaged block
+            return(false);
+        }
+
+        //Records are owned locally until every block has been applied
+        std::vector<DataStore::DataStoreRecord*> records;
+        records.reserve(static_cast<size_t>(header.recordCount_));
+        bool failure = false;
+        for (size_t b = 0; b < blocks.size() && !failure; ++b)
+        {
+            const DataStoreBinaryFormat::BlockHeader& blockHeader = blocks[b].header_;
+            const unsigned char* payload = blocks[b].payload_;
+            if (blockHeader.rowCount_ != header.recordCount_)
+            {
+                //Error occurred - block does not cover every record
+                failure = true;
+                break;
+            }
+            if (blockHeader.blockType_ == DataStoreBinaryFormat::BLOCK_RECORD_IDS)
+            {
+                if (!records.empty() || blockHeader.payloadSize_ % 8 != 0 || blockHeader.rowCount_ != blockHeader.payloadSize_ / 8)
+                {
+                    failure = true;
+                    break;
+                }
+                DataStoreBinaryFormat::BinaryReader idReader(payload, static_cast<size_t>(blockHeader.payloadSize_));
+                for (boost::uint64_t i = 0; i < blockHeader.rowCount_; ++i)
+                {
+                    boost::uint64_t id = 0;
+                    idReader.ReadUInt64(id);
+                    records.push_back(this->createRecord(static_cast<IndexType>(id), schema_, arena_));
+                }
+                continue;
+            }
+
+            //Column blocks must follow the record id block and reference a known column
+            DataStoreValueType valueType = DataStoreBinaryFormat::ValueTypeFor(blockHeader.blockType_);
+            size_t width = DataStoreValueWidth(valueType);
+            DataStoreBinaryFormat::ColumnBlockView view;
+            DataStoreBinaryFormat::FixedColumnBlockView fixedView;
+            bool validView = (width > 0) ? (fixedView.Init(blockHeader, payload) && blockHeader.offsetWidth_ == width) : view.Init(blockHeader, payload);
+            if (records.empty() || valueType == DATASTORE_VALUE_NONE || blockHeader.columnIdx_ >= columnIds.size() || !validView)
+            {
+                failure = true;
+                break;
+            }
+            DataStoreSchema::ColumnId columnId = columnIds[blockHeader.columnIdx_];
+            for (size_t i = 0; i < records.size(); ++i)
+            {
+                const unsigned char* data = nullptr;
+                size_t size = 0;
+                bool present = (width > 0) ? fixedView.GetValue(i, data, size) : view.GetValue(i, data, size);
+                if (present)records[i]->AddEncodedColumn(columnId, valueType, data, size);
+            }
+        }
+
+        if (failure || records.size() != header.recordCount_)
+        {
+            //Error occurred - discard the partially loaded records
+            for (size_t i = 0; i < records.size(); ++i)this->destroyRecord(records[i]);
+            return(false);
+        }
+        this->records_.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            if (!this->AddRecord(records[i]))
+            {
+                //Error occurred - could not add record to the data store
+                for (size_t j = i; j < records.size(); ++j)this->destroyRecord(records[j]);
+                return(false);
+            }
+        }
+        return(true);
+    }
+
+    //Indexes where each record is; the rows stay empty until materializeRecord parses them
+    bool ReadLazy(const rct::UTF8String& fileName, bool binary)
+    {
+        //Reset data
+        this->ResetRecords();
+        this->generation_ = 0;
+        lazyFile_ = new DataStoreLazyFile();
+        if (!lazyFile_->Open(fileName, binary))
+        {
+            //Error occurred - could not open the file or find its records
+            this->closeLazy();
+            return(false);
+        }
+        if (binary)
+        {
+            const DataStoreMappedFile& mapped = lazyFile_->GetBinaryFile();
+            this->generation_ = mapped.GetGeneration();
+            lazyColumnIds_.reserve(mapped.GetNumberColumns());
+            for (size_t c = 0; c < mapped.GetNumberColumns(); ++c)
+            {
+                lazyColumnIds_.push_back(schema_->Intern(mapped.GetColumnName(c)));
+            }
+        }
+        lazyPending_ = static_cast<IndexType>(lazyFile_->GetNumberRecords());
+        records_.resize(lazyPending_, nullptr);
+        nextRowIdx_ = lazyPending_;
+        //The column store holds every row, so it takes the full parse
+        if (columnStore_ != nullptr)return(this->materializeAll());
+        return(true);
+    }
+
+    bool materializeRecord(IndexType row)
+    {
+        if (lazyFile_ == nullptr)return(false);
+        DataStore::DataStoreRecord* dStoreRec = nullptr;
+        if (lazyFile_->IsBinary())
+        {
+            const DataStoreMappedFile& mapped = lazyFile_->GetBinaryFile();
+            dStoreRec = this->createRecord(static_cast<IndexType>(mapped.GetRecordId(row)), schema_, arena_);
+            for (size_t c = 0; c < lazyColumnIds_.size(); ++c)
+            {
+                DataStoreMappedFile::MappedValue value;
+                if (!mapped.GetColumn(row, c, value))continue;
+                if (!dStoreRec->AddEncodedColumn(lazyColumnIds_[c], value.GetType(), value.GetData(), value.GetSize()))
+                {
+                    this->destroyRecord(dStoreRec);
+                    return(false);
+                }
+            }
+        }
+        else
+        {
+            std::wstring recordText;
+            if (!lazyFile_->GetRecordText(row, recordText))return(false);
+            std::wistringstream iStr(recordText);
+            dStoreRec = this->createRecord(0, schema_, arena_);
+            if (!dStoreRec->InputFromStream(iStr))
+            {
+                //Error occurred - the record text is damaged; the row stays unparsed
+                this->destroyRecord(dStoreRec);
+                return(false);
+            }
+        }
+        //Same as AddRecord, but into the row reserved for it
+        dStoreRec->owner_ = this;
+        dStoreRec->row_ = row;
+        records_[row] = dStoreRec;
+        if (columnStore_ != nullptr)this->addColumnStoreRow(dStoreRec);
+        //The file is not needed once every row has been parsed
+        if (--lazyPending_ == 0)this->closeLazy();
+        return(true);
+    }
+
+    //Parses every row a lazy load has not parsed yet; whole store operations start with this
+    bool materializeAll()
+    {
+        for (IndexType i = 0; lazyFile_ != nullptr && i < records_.size(); ++i)
+        {
+            if (records_[i] == nullptr && !this->materializeRecord(i))return(false);
+        }
+        return(true);
+    }
+
+    void closeLazy()
+    {
+        if (lazyFile_ != nullptr)
+        {
+            delete lazyFile_;
+            lazyFile_ = nullptr;
+        }
+        lazyColumnIds_.clear();
+        lazyPending_ = 0;
+    }
+
+    bool inflateBlock(std::vector<DataStoreBinaryFormat::BlockRef>& blocks, std::vector<std::vector<unsigned char>>& buffers, size_t idx)
+    {
+        return(DataStoreBinaryFormat::InflateBlock(blocks[idx], buffers[idx], true));
+    }
+
+    bool WriteMappedToFile(const rct::UTF8String& fileName)
+    {
+        //The mapping already is a binary snapshot - copy it verbatim
+        std::ofstream output(fileName.nstr().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!output.is_open())return(false);
+        output.write(reinterpret_cast<const char*>(mappedFile_->GetData()), mappedFile_->GetSize());
+        output.close();
+        return(!output.fail());
+    }
+
+    void CloseMapped()
+    {
+        if (mappedFile_ != nullptr)
+        {
+            delete mappedFile_;
+            mappedFile_ = nullptr;
+        }
+    }
+
+    DataStore::DataStoreRecord* createRecord(IndexType id, const DataStore::DataStoreRecord::SchemaPtr& schema, DataStoreArena& arena)
+    {
+        void* mem = arena.Allocate(sizeof(DataStore::DataStoreRecord), alignof(DataStore::DataStoreRecord));
+        return(new (mem) DataStore::DataStoreRecord(id, schema, &arena));
+    }
+
+    //Arena records are only destructed, their memory goes back with the arena
+    void destroyRecord(DataStore::DataStoreRecord* record)
+    {
+        if (record->arena_ != nullptr)record->~DataStoreRecord();
+        else delete record;
+    }
+
+    //Drops every record and releases the arena in one go.  Records the store created are
+    //destroyed; records allocated by the caller are left to the caller and stop reporting changes
+    void ResetRecords()
+    {
+        for (size_t i = 0; i < records_.size(); ++i)
+        {
+            //Rows of a lazy load that were never asked for have no record yet
+            if (records_[i] == nullptr)continue;
+            records_[i]->owner_ = nullptr;
+            if (records_[i]->arena_ != nullptr)records_[i]->~DataStoreRecord();
+        }
+        this->nextRowIdx_ = 0;
+        this->records_.clear();
+        this->closeLazy();
+        //Snapshots may still read column data in the arena; its memory moves to them and goes when they do
+        if (snapshotArena_ && !snapshotArena_.unique())snapshotArena_->Absorb(arena_);
+        snapshotArena_.reset();
+        //Also frees records from CreateRecord that were never added
+        this->arena_.Release();
+        this->schema_ = boost::make_shared<DataStoreSchema>();
+        if (columnStore_ != nullptr)columnStore_->Clear();
+        //Index definitions survive by name, see rebuildIndexes
+        this->indexById_.clear();
+        for (std::map<DataStr, DataStoreIndex*>::iterator iIter = indexes_.begin(); iIter != indexes_.end(); ++iIter)
+        {
+            iIter->second->Clear();
+        }
+    }
+
+    bool defineLogColumn(DataStoreSchema::ColumnId id)
+    {
+        if (log_->IsColumnDefined(id))return(true);
+        return(log_->DefineColumn(id, rct::UTF8String(schema_->GetName(id)).nstr()));
+    }
+
+    //Owned records report a change here before applying it; false cancels the change
+    bool propertyChanging(IndexType row, DataStoreSchema::ColumnId id, const DataStr& val)
+    {
+        if (log_ != nullptr && !replaying_)
+        {
+            std::string utf8Val = rct::UTF8String(val).nstr();
+            if (!this->logColumn(row, id, DATASTORE_VALUE_STRING, utf8Val.data(), utf8Val.size()))return(false);
+        }
+        if (columnStore_ != nullptr)columnStore_->ClearValue(row, id);
+        if (this->findIndex(id) != nullptr)
+        {
+            DataStoreIndex::Key newKey(val);
+            this->updateIndex(row, id, &newKey);
+        }
+        return(true);
+    }
+
+    //Same for object and typed values, which arrive in their file encoding
+    bool columnChanging(IndexType row, DataStoreSchema::ColumnId id, DataStoreValueType kind, const void* data, size_t size)
+    {
+        if (!this->logColumn(row, id, kind, data, size))return(false);
+        if (columnStore_ != nullptr)
+        {
+            size_t width = DataStoreValueWidth(kind);
+            boost::uint64_t bits = (width > 0) ? DataStoreBinaryFormat::DecodeFixed(static_cast<const unsigned char*>(data), width) : 0;
+            columnStore_->SetValue(row, id, kind, bits);
+        }
+        if (this->findIndex(id) != nullptr)
+        {
+            //Object values are not indexed, the row just drops out of the index
+            size_t width = DataStoreValueWidth(kind);
+            DataStoreIndex::Key newKey(kind, (width > 0) ? DataStoreBinaryFormat::DecodeFixed(static_cast<const unsigned char*>(data), width) : 0);
+            this->updateIndex(row, id, (width > 0) ? &newKey : nullptr);
+        }
+        return(true);
+    }
+
+    void addColumnStoreRow(DataStore::DataStoreRecord* record)
+    {
+        for (size_t c = 0; c < record->data_->typedColumns_.size(); ++c)
+        {
+            const DataStore::DataStoreRecord::ColumnSlot& slot = record->data_->slots_[record->data_->typedColumns_[c]];
+            columnStore_->SetValue(record->row_, record->data_->typedColumns_[c], slot.kind_, slot.scalarData_);
+        }
+    }
+
+    DataStoreIndex* findIndex(DataStoreSchema::ColumnId id) const
+    {
+        return((id < indexById_.size()) ? indexById_[id] : nullptr);
+    }
+
+    static bool slotKey(const DataStore::DataStoreRecord::ColumnSlot& slot, DataStoreIndex::Key& key)
+    {
+        if (slot.kind_ == DATASTORE_VALUE_NONE || slot.kind_ == DATASTORE_VALUE_BYTES)return(false);
+        if (slot.kind_ == DATASTORE_VALUE_STRING)key = DataStoreIndex::Key(slot.GetString());
+        else key = DataStoreIndex::Key(slot.kind_, slot.scalarData_);
+        return(true);
+    }
+
+    //Called before the record's slot changes, so the slot still holds the value to unindex
+    void updateIndex(IndexType row, DataStoreSchema::ColumnId id, const DataStoreIndex::Key* newKey)
+    {
+        DataStoreIndex* index = this->findIndex(id);
+        DataStoreIndex::Key oldKey;
+        const DataStore::DataStoreRecord::ColumnSlot* slot = records_[row]->getSlot(id);
+        if (slot != nullptr && slotKey(*slot, oldKey))index->Remove(oldKey, row);
+        if (newKey != nullptr)index->Insert(*newKey, row);
+    }
+
+    void indexRecord(DataStore::DataStoreRecord* record)
+    {
+        for (size_t id = 0; id < indexById_.size(); ++id)
+        {
+            if (indexById_[id] == nullptr)continue;
+            DataStoreIndex::Key key;
+            const DataStore::DataStoreRecord::ColumnSlot* slot = record->getSlot(static_cast<DataStoreSchema::ColumnId>(id));
+            if (slot != nullptr && slotKey(*slot, key))indexById_[id]->Insert(key, record->row_);
+        }
+    }
+
+    //Binds every index to its column id in the current schema and indexes all rows.
+    //Indexes need every row, so rows a lazy load has not parsed yet are parsed first
+    bool rebuildIndexes()
+    {
+        indexById_.clear();
+        bool rt = indexes_.empty() || this->materializeAll();
+        for (std::map<DataStr, DataStoreIndex*>::iterator iIter = indexes_.begin(); iIter != indexes_.end(); ++iIter)
+        {
+            DataStoreSchema::ColumnId id = schema_->Intern(iIter->first);
+            if (id >= indexById_.size())indexById_.resize(id + 1, nullptr);
+            indexById_[id] = iIter->second;
+            iIter->second->Clear();
+        }
+        this->indexRows(0, records_.size());
+        return(rt);
+    }
+
+    //Adds rows [firstRow, endRow) to every index, one index at a time so each sees the rows as one batch
+    void indexRows(IndexType firstRow, IndexType endRow)
+    {
+        std::vector<std::pair<DataStoreIndex::Key, DataStoreIndex::RowId>> entries;
+        for (size_t id = 0; id < indexById_.size(); ++id)
+        {
+            if (indexById_[id] == nullptr)continue;
+            entries.clear();
+            entries.reserve(endRow - firstRow);
+            for (IndexType row = firstRow; row < endRow; ++row)
+            {
+                DataStoreIndex::Key key;
+                const DataStore::DataStoreRecord::ColumnSlot* slot = (records_[row] == nullptr) ? nullptr : records_[row]->getSlot(static_cast<DataStoreSchema::ColumnId>(id));
+                if (slot != nullptr && slotKey(*slot, key))entries.push_back(std::make_pair(key, row));
+            }
+            indexById_[id]->InsertBatch(entries);
+        }
+    }
+
+    //Checks the rows of a column batch, parsing rows a lazy load has not reached yet
+    bool checkBatchRows(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, size_t valueCount)
+    {
+        if (mappedFile_ != nullptr || rows.size() != valueCount || id >= schema_->GetNumberColumns())return(false);
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            if (rows[i] >= records_.size() || (records_[rows[i]] == nullptr && !this->materializeRecord(rows[i])))return(false);
+        }
+        return(true);
+    }
+
+    //Column batch for one row: the old value leaves the index and the new key waits for the batch insert
+    void queueIndexUpdate(DataStoreIndex* index, IndexType row, DataStoreSchema::ColumnId id, const DataStoreIndex::Key& newKey, std::vector<std::pair<DataStoreIndex::Key, DataStoreIndex::RowId>>& entries)
+    {
+        DataStoreIndex::Key oldKey;
+        const DataStore::DataStoreRecord::ColumnSlot* slot = records_[row]->getSlot(id);
+        if (slot != nullptr && slotKey(*slot, oldKey))index->Remove(oldKey, row);
+        entries.push_back(std::make_pair(newKey, row));
+    }
+
+    //Typed column batches; the log is synced and the index updated once for the batch.
+    //A log failure stops the batch, the rows before it keep their new values
+    bool addScalarColumns(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, DataStoreValueType kind, const std::vector<boost::uint64_t>& bits)
+    {
+        if (!this->checkBatchRows(rows, id, bits.size()))return(false);
+        if (log_ != nullptr && !this->defineLogColumn(id))return(false);
+        size_t width = DataStoreValueWidth(kind);
+        DataStoreIndex* index = this->findIndex(id);
+        std::vector<std::pair<DataStoreIndex::Key, DataStoreIndex::RowId>> entries;
+        if (index != nullptr)entries.reserve(rows.size());
+        bool rt = true;
+        if (log_ != nullptr)log_->BeginBatch();
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            if (log_ != nullptr)
+            {
+                unsigned char encoded[8];
+                DataStoreBinaryFormat::EncodeFixed(bits[i], width, encoded);
+                if (!log_->SetColumn(rows[i], id, kind, encoded, width))
+                {
+                    rt = false;
+                    break;
+                }
+            }
+            if (columnStore_ != nullptr)columnStore_->SetValue(rows[i], id, kind, bits[i]);
+            if (index != nullptr)this->queueIndexUpdate(index, rows[i], id, DataStoreIndex::Key(kind, bits[i]), entries);
+            records_[rows[i]]->prepareSlot(id, kind).scalarData_ = bits[i];
+        }
+        if (log_ != nullptr && !log_->EndBatch())rt = false;
+        if (index != nullptr)index->InsertBatch(entries);
+        return(rt);
+    }
+
+    void dropIndexes()
+    {
+        indexById_.clear();
+        for (std::map<DataStr, DataStoreIndex*>::iterator iIter = indexes_.begin(); iIter != indexes_.end(); ++iIter)
+        {
+            delete iIter->second;
+        }
+        indexes_.clear();
+    }
+
+    const DataStoreIndex* namedIndex(const DataStr& column) const
+    {
+        std::map<DataStr, DataStoreIndex*>::const_iterator iFind = indexes_.find(column);
+        return((iFind == indexes_.end()) ? nullptr : iFind->second);
+    }
+
+    bool logColumn(IndexType row, DataStoreSchema::ColumnId id, DataStoreValueType kind, const void* data, size_t size)
+    {
+        if (log_ == nullptr || replaying_)return(true);
+        if (!defineLogColumn(id))return(false);
+        return(log_->SetColumn(row, id, kind, data, size));
+    }
+
+    //One entry carries the whole record so a torn write never replays half of it
+    bool logRecord(DataStore::DataStoreRecord* record)
+    {
+        if (log_ == nullptr)return(true);
+        for (size_t c = 0; c < record->data_->propertyColumns_.size(); ++c)
+        {
+            if (!defineLogColumn(record->data_->propertyColumns_[c]))return(false);
+        }
+        for (size_t c = 0; c < record->data_->objectColumns_.size(); ++c)
+        {
+            if (!defineLogColumn(record->data_->objectColumns_[c]))return(false);
+        }
+        for (size_t c = 0; c < record->data_->typedColumns_.size(); ++c)
+        {
+            if (!defineLogColumn(record->data_->typedColumns_[c]))return(false);
+        }
+        log_->BeginRecord(records_.size(), record->id_, static_cast<boost::uint32_t>(record->data_->propertyColumns_.size() + record->data_->objectColumns_.size() + record->data_->typedColumns_.size()));
+        for (size_t c = 0; c < record->data_->propertyColumns_.size(); ++c)
+        {
+            DataStoreSchema::ColumnId id = record->data_->propertyColumns_[c];
+            std::string utf8Val = rct::UTF8String(record->data_->slots_[id].GetString()).nstr();
+            log_->AddValue(id, DATASTORE_VALUE_STRING, utf8Val.data(), utf8Val.size());
+        }
+        for (size_t c = 0; c < record->data_->objectColumns_.size(); ++c)
+        {
+            DataStoreSchema::ColumnId id = record->data_->objectColumns_[c];
+            const DataStore::DataStoreRecord::SlotBytes& obj = record->data_->slots_[id].objectData_;
+            log_->AddValue(id, DATASTORE_VALUE_BYTES, obj.empty() ? nullptr : &obj[0], obj.size());
+        }
+        for (size_t c = 0; c < record->data_->typedColumns_.size(); ++c)
+        {
+            const DataStore::DataStoreRecord::ColumnSlot& slot = record->data_->slots_[record->data_->typedColumns_[c]];
+            unsigned char encoded[8];
+            size_t width = DataStoreValueWidth(slot.kind_);
+            DataStoreBinaryFormat::EncodeFixed(slot.scalarData_, width, encoded);
+            log_->AddValue(record->data_->typedColumns_[c], slot.kind_, encoded, width);
+        }
+        return(log_->EndRecord());
+    }
+
+    bool applyLogValue(DataStore::DataStoreRecord* record, const std::vector<DataStoreSchema::ColumnId>& translation, DataStoreBinaryFormat::BinaryReader& entry)
+    {
+        boost::uint32_t logColumn = 0;
+        DataStoreValueType kind = DATASTORE_VALUE_NONE;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        if (!DataStoreLog::ReadValue(entry, logColumn, kind, data, size))return(false);
+        if (logColumn >= translation.size() || translation[logColumn] == DataStoreSchema::InvalidColumn)return(false);
+        return(record->AddEncodedColumn(translation[logColumn], kind, data, size));
+    }
+
+    //Log column ids are mapped onto the store schema as their definitions are replayed
+    bool applyLogEntry(const unsigned char* payload, size_t size, std::vector<DataStoreSchema::ColumnId>& translation)
+    {
+        DataStoreBinaryFormat::BinaryReader entry(payload, size);
+        const unsigned char* entryType = nullptr;
+        if (!entry.ReadBytes(1, entryType))return(false);
+        if (*entryType == DataStoreLog::LOG_DEFINE_COLUMN)
+        {
+            boost::uint32_t logColumn = 0;
+            std::string name;
+            if (!entry.ReadUInt32(logColumn) || !entry.ReadString(name) || name.empty())return(false);
+            if (logColumn >= translation.size())translation.resize(logColumn + 1, static_cast<DataStoreSchema::ColumnId>(DataStoreSchema::InvalidColumn));
+            translation[logColumn] = schema_->Intern(rct::UTF8String(name).str());
+            return(true);
+        }
+        boost::uint64_t row = 0;
+        if (!entry.ReadUInt64(row))return(false);
+        if (*entryType == DataStoreLog::LOG_SET_COLUMN)
+        {
+            DataStore::DataStoreRecord* record = nullptr;
+            if (!this->GetRecord(static_cast<IndexType>(row), &record))return(false);
+            return(this->applyLogValue(record, translation, entry));
+        }
+        if (*entryType != DataStoreLog::LOG_ADD_RECORD)return(false);
+        boost::uint64_t id = 0;
+        boost::uint32_t valueCount = 0;
+        //Rows are dense, so a record entry must land exactly at the end of the table
+        if (!entry.ReadUInt64(id) || !entry.ReadUInt32(valueCount) || row != records_.size())return(false);
+        DataStore::DataStoreRecord* dStoreRec = this->createRecord(static_cast<IndexType>(id), schema_, arena_);
+        for (boost::uint32_t i = 0; i < valueCount; ++i)
+        {
+            if (!this->applyLogValue(dStoreRec, translation, entry))
+            {
+                this->destroyRecord(dStoreRec);
+                return(false);
+            }
+        }
+        if (!this->AddRecord(dStoreRec))
+        {
+            this->destroyRecord(dStoreRec);
+            return(false);
+        }
+        return(true);
+    }
+
+    //Replays the log on top of the loaded snapshot and keeps appending to it
+    bool OpenLog()
+    {
+        std::vector<unsigned char> logData;
+        boost::uint32_t logGeneration = 0;
+        if (DataStoreBinaryFormat::ReadFileBytes(logFileName_, logData))
+        {
+            DataStoreLog::Reader reader(&logData[0], logData.size());
+            if (reader.ReadHeader(logGeneration) && logGeneration >= generation_)
+            {
+                //A log for a newer snapshot than the one loaded must not be replayed or discarded
+                if (logGeneration != generation_)return(false);
+                const unsigned char* payload = nullptr;
+                size_t size = 0;
+                std::vector<DataStoreSchema::ColumnId> translation;
+                bool failure = false;
+                replaying_ = true;
+                while (!failure && reader.Next(payload, size))
+                {
+                    failure = !this->applyLogEntry(payload, size, translation);
+                }
+                replaying_ = false;
+                if (failure)return(false);
+                return(log_->Resume(logFileName_, logData, reader.GetPosition(), syncLog_));
+            }
+        }
+        //No log yet, or one left behind by a compaction that already reached the snapshot
+        return(log_->Create(logFileName_, generation_, syncLog_));
+    }
+private:
+    //Not copyable - owns the mapped file
+    DataStore(const DataStore& rhs);
+    void operator=(const DataStore& rhs);
+public:
+    DataStore(const DataStr& name) : 
+        rct::Object<>(name), 
+        schema_(boost::make_shared<DataStoreSchema>()),
+        nextRowIdx_(0),
+        mappedFile_(nullptr),
+        lazyFile_(nullptr),
+        lazyPending_(0),
+        log_(nullptr),
+        columnStore_(nullptr),
+        generation_(0),
+        syncLog_(false),
+        replaying_(false),
+        ioThreads_(0),
+        compression_(DataStoreCompression::CODEC_NONE),
+        lazyLoad_(false)
+    {
+    }
+
+    ~DataStore()
+    {
+        CloseMapped();
+        DetachLog();
+        ResetRecords();
+        DisableColumnStore();
+        dropIndexes();
+    }
+
+    //Creates a record that already shares the store's column dictionary.  The record lives in the
+    //store's arena: do not delete it, it is released when the store is cleared, reloaded or destroyed
+    DataStore::DataStoreRecord* CreateRecord(IndexType id)
+    {
+        return(this->createRecord(id, schema_, arena_));
+    }
+
+    bool AddDataRecord(DataStore::DataStoreRecord* record)
+    {
+        if (mappedFile_ != nullptr || record == nullptr || record->owner_ != nullptr)return(false);
+        //Records from another store's arena would not outlive that store
+        if (record->arena_ != nullptr && record->arena_ != &arena_)return(false);
+        //Log first, so a record is never in the store without being in the log
+        record->bindSchema(schema_);
+        if (!this->logRecord(record))return(false);
+        return(this->AddRecord(record));
+    }
+
+    //Creates count records with ids firstId, firstId + 1, ... in one arena block and appends them to
+    //records; same rules as CreateRecord
+    void CreateRecords(IndexType firstId, IndexType count, std::vector<DataStore::DataStoreRecord*>& records)
+    {
+        if (count == 0)return;
+        unsigned char* mem = static_cast<unsigned char*>(arena_.Allocate(count * sizeof(DataStore::DataStoreRecord), alignof(DataStore::DataStoreRecord)));
+        records.reserve(records.size() + count);
+        for (IndexType i = 0; i < count; ++i)
+        {
+            records.push_back(new (mem + i * sizeof(DataStore::DataStoreRecord)) DataStore::DataStoreRecord(firstId + i, schema_, &arena_));
+        }
+    }
+
+    //Adds records in one pass: the record table grows once, the log is synced once and every index
+    //takes the batch in one go.  Nothing is added if any record could not be added on its own.  If
+    //the log fails part way, the records logged before the failure stay added and false is returned
+    bool AddDataRecords(const std::vector<DataStore::DataStoreRecord*>& records)
+    {
+        if (mappedFile_ != nullptr)return(false);
+        //Claiming every record first also catches a record listed twice
+        size_t claimed = 0;
+        for (; claimed < records.size(); ++claimed)
+        {
+            DataStore::DataStoreRecord* record = records[claimed];
+            if (record == nullptr || record->owner_ != nullptr || (record->arena_ != nullptr && record->arena_ != &arena_))break;
+            record->owner_ = this;
+        }
+        if (claimed < records.size())
+        {
+            for (size_t i = 0; i < claimed; ++i)records[i]->owner_ = nullptr;
+            return(false);
+        }
+        IndexType firstRow = records_.size();
+        records_.reserve(firstRow + records.size());
+        bool rt = true;
+        if (log_ != nullptr)log_->BeginBatch();
+        size_t added = 0;
+        for (; added < records.size(); ++added)
+        {
+            DataStore::DataStoreRecord* record = records[added];
+            record->bindSchema(schema_);
+            //The log entry carries the row the record is about to get
+            if (!this->logRecord(record))
+            {
+                rt = false;
+                break;
+            }
+            record->row_ = records_.size();
+            records_.push_back(record);
+        }
+        if (log_ != nullptr && !log_->EndBatch())rt = false;
+        for (size_t i = added; i < records.size(); ++i)records[i]->owner_ = nullptr;
+        nextRowIdx_ += added;
+        for (IndexType row = firstRow; columnStore_ != nullptr && row < records_.size(); ++row)
+        {
+            this->addColumnStoreRow(records_[row]);
+        }
+        this->indexRows(firstRow, records_.size());
+        return(rt);
+    }
+
+    //Sets one column on many rows, values[i] on rows[i], with the log synced and the column's index
+    //updated once for the batch.  Fails without changes if a row or the column id is out of range;
+    //a log failure part way keeps the values set before it
+    bool AddColumns(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, const std::vector<DataStr>& values)
+    {
+        if (!this->checkBatchRows(rows, id, values.size()))return(false);
+        if (log_ != nullptr && !this->defineLogColumn(id))return(false);
+        DataStoreIndex* index = this->findIndex(id);
+        std::vector<std::pair<DataStoreIndex::Key, DataStoreIndex::RowId>> entries;
+        if (index != nullptr)entries.reserve(rows.size());
+        bool rt = true;
+        if (log_ != nullptr)log_->BeginBatch();
+        std::string utf8Val;
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            if (log_ != nullptr)
+            {
+                utf8Val = rct::UTF8String(values[i]).nstr();
+                if (!log_->SetColumn(rows[i], id, DATASTORE_VALUE_STRING, utf8Val.data(), utf8Val.size()))
+                {
+                    rt = false;
+                    break;
+                }
+            }
+            if (columnStore_ != nullptr)columnStore_->ClearValue(rows[i], id);
+            if (index != nullptr)this->queueIndexUpdate(index, rows[i], id, DataStoreIndex::Key(values[i]), entries);
+            records_[rows[i]]->prepareSlot(id, DATASTORE_VALUE_STRING).stringData_.assign(values[i].data(), values[i].size());
+        }
+        if (log_ != nullptr && !log_->EndBatch())rt = false;
+        if (index != nullptr)index->InsertBatch(entries);
+        return(rt);
+    }
+
+    bool AddInt64Columns(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, const std::vector<boost::int64_t>& values)
+    {
+        std::vector<boost::uint64_t> bits(values.begin(), values.end());
+        return(this->addScalarColumns(rows, id, DATASTORE_VALUE_INT64, bits));
+    }
+
+    bool AddDoubleColumns(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, const std::vector<double>& values)
+    {
+        std::vector<boost::uint64_t> bits(values.size());
+        for (size_t i = 0; i < values.size(); ++i)bits[i] = DataStoreBinaryFormat::DoubleToBits(values[i]);
+        return(this->addScalarColumns(rows, id, DATASTORE_VALUE_DOUBLE, bits));
+    }
+
+    bool AddBoolColumns(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, const std::vector<bool>& values)
+    {
+        std::vector<boost::uint64_t> bits(values.begin(), values.end());
+        return(this->addScalarColumns(rows, id, DATASTORE_VALUE_BOOL, bits));
+    }
+
+    //Milliseconds since the Unix epoch
+    bool AddTimestampColumns(const std::vector<IndexType>& rows, DataStoreSchema::ColumnId id, const std::vector<boost::int64_t>& values)
+    {
+        std::vector<boost::uint64_t> bits(values.begin(), values.end());
+        return(this->addScalarColumns(rows, id, DATASTORE_VALUE_TIMESTAMP, bits));
+    }
+
+    //Resolve a column name once, then use the id for direct slot access on records
+    bool GetColumnId(const DataStr& name, DataStoreSchema::ColumnId& id) const
+    {
+        return(schema_->Find(name, id));
+    }
+
+    const DataStore::DataStoreRecord::SchemaPtr& GetSchema() const
+    {
+        return(schema_);
+    }
+
+    bool GetDataRecord(IndexType id, DataStore::DataStoreRecord** record)
+    {
+        return(this->GetRecord(id, record));
+    }
+
+    bool GetDataRecord(const DataStr& name, DataStore::DataStoreRecord** record)
+    {
+        return(this->GetRecord(name, record));
+    }
+
+    //Read only lookup for stores opened with LoadMapped - no record is materialized
+    bool GetDataRecord(IndexType id, DataStoreMappedFile::MappedRecord& record) const
+    {
+        if (mappedFile_ == nullptr)return(false);
+        return(mappedFile_->GetRecord(id, record));
+    }
+
+    bool Save(const rct::UTF8String& fileName, StorageFormat format = DATASTORE_FORMAT_BINARY)
+    {
+        if (mappedFile_ != nullptr)
+        {
+            if (format == DATASTORE_FORMAT_TEXT)return(false);
+            return(this->WriteMappedToFile(fileName));
+        }
+        //Also releases a lazily loaded file, which may be the one being overwritten
+        if (!this->materializeAll())return(false);
+        if (format == DATASTORE_FORMAT_TEXT)
+        {
+            return(this->WriteToFile(fileName));
+        }
+        return(this->WriteToBinaryFile(fileName));
+    }
+
+    //Point in time view for Save and long scans while records keep changing.  Costs a pointer copy
+    //per record; a record changed afterwards copies its column data once.  Must be called on the
+    //thread that changes the store, the snapshot can then be used anywhere.  False for mapped stores
+    bool GetSnapshot(Snapshot& snapshot)
+    {
+        if (mappedFile_ != nullptr || !this->materializeAll())return(false);
+        if (!snapshotArena_)snapshotArena_ = boost::make_shared<DataStoreArena>();
+        boost::shared_ptr<Snapshot::Rows> rows = boost::make_shared<Snapshot::Rows>();
+        rows->arena_ = snapshotArena_;
+        //Interning changes the dictionary, so the snapshot reads a copy of it
+        rows->schema_ = DataStore::DataStoreRecord::copySchema(schema_);
+        rows->ids_.reserve(records_.size());
+        rows->data_.reserve(records_.size());
+        for (size_t i = 0; i < records_.size(); ++i)
+        {
+            rows->ids_.push_back(records_[i]->id_);
+            rows->data_.push_back(records_[i]->data_);
+        }
+        rows->ioThreads_ = ioThreads_;
+        rows->compression_ = compression_;
+        snapshot = Snapshot(rows);
+        return(true);
+    }
+
+    //Auto detects the binary format by its magic, anything else is read as legacy text; an attached log is replayed on top
+    bool Load(const rct::UTF8String& fileName, StorageFormat format = DATASTORE_FORMAT_AUTO)
+    {
+        CloseMapped();
+        if (format == DATASTORE_FORMAT_AUTO)
+        {
+            format = DataStoreBinaryFormat::IsBinaryFile(fileName.nstr()) ? DATASTORE_FORMAT_BINARY : DATASTORE_FORMAT_TEXT;
+        }
+        if (log_ != nullptr)log_->Close();
+        bool rt = false;
+        if (lazyLoad_)rt = this->ReadLazy(fileName, format == DATASTORE_FORMAT_BINARY);
+        else rt = (format == DATASTORE_FORMAT_BINARY) ? this->ReadFromBinaryFile(fileName) : this->ReadFromFile(fileName);
+        if (rt && log_ != nullptr)rt = this->OpenLog();
+        if (rt)rt = this->rebuildIndexes();
+        return(rt);
+    }
+
+    //Logs every later AddDataRecord and column change; entries already in the log for the current snapshot are replayed first
+    bool AttachLog(const rct::UTF8String& logFileName, bool syncEachEntry = false)
+    {
+        if (mappedFile_ != nullptr)return(false);
+        DetachLog();
+        log_ = new DataStoreLog();
+        logFileName_ = logFileName.nstr();
+        syncLog_ = syncEachEntry;
+        if (!this->OpenLog())
+        {
+            DetachLog();
+            return(false);
+        }
+        return(true);
+    }
+
+    void DetachLog()
+    {
+        if (log_ != nullptr)
+        {
+            delete log_;
+            log_ = nullptr;
+        }
+        logFileName_.clear();
+    }
+
+    //Forces logged entries to disk when the log was not attached with syncEachEntry
+    bool SyncLog()
+    {
+        return(log_ != nullptr && log_->Sync());
+    }
+
+    //Folds the log into a new binary snapshot and starts an empty log on top of it
+    bool Compact(const rct::UTF8String& snapshotFileName)
+    {
+        if (mappedFile_ != nullptr || !this->materializeAll())return(false);
+        std::string snapshotName = snapshotFileName.nstr();
+        std::string tempName = snapshotName + ".tmp";
+        //The old snapshot and log stay valid until the new snapshot has replaced the old one
+        ++generation_;
+        if (!this->WriteToBinaryFile(rct::UTF8String(tempName)) || !DataStoreLog::SwapInFile(tempName, snapshotName))
+        {
+            --generation_;
+            std::remove(tempName.c_str());
+            return(false);
+        }
+        //The new snapshot is on disk, so a crash from here on leaves an older generation log, which Load discards
+        if (log_ == nullptr)return(true);
+        return(log_->Create(logFileName_, generation_, syncLog_));
+    }
+
+    //Maps a binary snapshot read only; records are served through GetDataRecord(id, MappedRecord&)
+    bool LoadMapped(const rct::UTF8String& fileName, bool verifyBlocks = false)
+    {
+        CloseMapped();
+        //Nothing to log or scan for a read only store
+        DetachLog();
+        DisableColumnStore();
+        dropIndexes();
+        this->ResetRecords();
+        mappedFile_ = new DataStoreMappedFile();
+        if (!mappedFile_->Open(fileName, verifyBlocks))
+        {
+            CloseMapped();
+            return(false);
+        }
+        return(true);
+    }
+
+    //Keeps a column major copy of the typed columns for scans and aggregates, see DataStoreColumnStore
+    bool EnableColumnStore()
+    {
+        if (mappedFile_ != nullptr)return(false);
+        if (columnStore_ != nullptr)return(true);
+        if (!this->materializeAll())return(false);
+        columnStore_ = new DataStoreColumnStore();
+        for (size_t i = 0; i < records_.size(); ++i)
+        {
+            this->addColumnStoreRow(records_[i]);
+        }
+        return(true);
+    }
+
+    void DisableColumnStore()
+    {
+        if (columnStore_ != nullptr)
+        {
+            delete columnStore_;
+            columnStore_ = nullptr;
+        }
+    }
+
+    //Null unless EnableColumnStore was called; rows are the store's row ids
+    const DataStoreColumnStore* GetColumnStore() const
+    {
+        return(columnStore_);
+    }
+
+    //Indexes the named column - a hash index answers FindRecords, an ordered one also FindRecordRange.
+    //Indexes are kept up to date by AddDataRecord and column changes and rebuilt by Load
+    bool CreateIndex(const DataStr& column, DataStoreIndex::IndexKind kind)
+    {
+        if (mappedFile_ != nullptr || indexes_.find(column) != indexes_.end())return(false);
+        indexes_[column] = new DataStoreIndex(kind);
+        return(this->rebuildIndexes());
+    }
+
+    bool DropIndex(const DataStr& column)
+    {
+        std::map<DataStr, DataStoreIndex*>::iterator iFind = indexes_.find(column);
+        if (iFind == indexes_.end())return(false);
+        delete iFind->second;
+        indexes_.erase(iFind);
+        this->rebuildIndexes();
+        return(true);
+    }
+
+    bool HasIndex(const DataStr& column) const
+    {
+        return(indexes_.find(column) != indexes_.end());
+    }
+
+    //Appends the row ids whose column equals the key; false if the column has no index
+    bool FindRecords(const DataStr& column, const DataStoreIndex::Key& key, std::vector<IndexType>& rows) const
+    {
+        const DataStoreIndex* index = this->namedIndex(column);
+        if (index == nullptr)return(false);
+        index->Find(key, rows);
+        return(true);
+    }
+
+    //Appends the row ids with low <= column <= high in value order; needs an ordered index
+    bool FindRecordRange(const DataStr& column, const DataStoreIndex::Key& low, const DataStoreIndex::Key& high, std::vector<IndexType>& rows) const
+    {
+        const DataStoreIndex* index = this->namedIndex(column);
+        if (index == nullptr || index->GetKind() != DataStoreIndex::INDEX_ORDERED)return(false);
+        index->FindRange(low, high, rows);
+        return(true);
+    }
+
+    //Threads used by Load and Save on large stores; zero uses every hardware thread, one disables parallelism
+    void SetThreadCount(unsigned int threadCount)
+    {
+        ioThreads_ = threadCount;
+    }
+
+    //Codec for the blocks of binary files written by Save and Compact; Load reads any codec
+    void SetCompression(DataStoreCompression::Codec codec)
+    {
+        compression_ = codec;
+    }
+
+    DataStoreCompression::Codec GetCompression() const
+    {
+        return(compression_);
+    }
+
+    //With lazy load on, Load only finds where each record is in the file and a record is parsed the
+    //first time GetDataRecord asks for it.  Save, Compact, GetRecords, indexes and the column store
+    //need every record and parse the rest first.  Parsing changes the store, so even lookups on a
+    //store that IsLazyPending must not run concurrently.  The setting only applies to the next Load
+    void SetLazyLoad(bool lazy)
+    {
+        lazyLoad_ = lazy;
+    }
+
+    bool IsLazyLoad() const
+    {
+        return(lazyLoad_);
+    }
+
+    //True while a lazily loaded file still has rows that were not parsed, whatever IsLazyLoad says now
+    bool IsLazyPending() const
+    {
+        return(lazyFile_ != nullptr);
+    }
+
+    //Memory held by the record arena, a measure of the store's footprint
+    size_t GetArenaBytesReserved() const
+    {
+        return(arena_.GetBytesReserved());
+    }
+
+    bool IsReadOnly() const
+    {
+        return(mappedFile_ != nullptr);
+    }
+
+    //Null unless the store was opened with LoadMapped
+    const DataStoreMappedFile* GetMappedFile() const
+    {
+        return(mappedFile_);
+    }
+
+    IndexType GetNumberRecords() const
+    {
+        if (mappedFile_ != nullptr)return(static_cast<IndexType>(mappedFile_->GetNumberRecords()));
+        return(nextRowIdx_);
+    }
+
+    //Id of the record in a row without parsing it, so rows a lazy load has not parsed stay that way
+    bool GetRecordId(IndexType row, IndexType& id) const
+    {
+        if (mappedFile_ != nullptr)
+        {
+            if (row >= mappedFile_->GetNumberRecords())return(false);
+            id = static_cast<IndexType>(mappedFile_->GetRecordId(row));
+            return(true);
+        }
+        if (row >= records_.size())return(false);
+        if (records_[row] != nullptr)
+        {
+            id = records_[row]->GetId();
+            return(true);
+        }
+        boost::uint64_t fileId = 0;
+        if (lazyFile_ == nullptr || !lazyFile_->GetRecordId(row, fileId))return(false);
+        id = static_cast<IndexType>(fileId);
+        return(true);
+    }
+
+    std::vector<DataStr> GetRecordIds() const
+    {
+        std::vector<DataStr> rt;
+        rt.reserve(records_.size());
+        for (IndexType i = 0; i < records_.size(); ++i)
+        {
+            rt.push_back(DataStore::DataStoreRecord::recordName(i));
+        }
+        return(rt);
+    }
+
+private:
+    DataStore::DataStoreRecord::SchemaPtr schema_;
+    std::vector<DataStore::DataStoreRecord*> records_;
+    IndexType nextRowIdx_;
+    DataStoreMappedFile* mappedFile_;
+    //Source of the rows a lazy load has not parsed yet, and how many of them are left
+    DataStoreLazyFile* lazyFile_;
+    IndexType lazyPending_;
+    //Schema id of each binary column, by column position in the lazily loaded file
+    std::vector<DataStoreSchema::ColumnId> lazyColumnIds_;
+    DataStoreLog* log_;
+    std::string logFileName_;
+    DataStoreColumnStore* columnStore_;
+    //Secondary indexes by column name, and the same indexes by column id of the current schema
+    std::map<DataStr, DataStoreIndex*> indexes_;
+    std::vector<DataStoreIndex*> indexById_;
+    //Owns records the store creates and their column payloads
+    DataStoreArena arena_;
+    //Held by snapshots of the current records; takes over the arena's memory if they outlive them
+    boost::shared_ptr<DataStoreArena> snapshotArena_;
+    //Snapshot generation the store was loaded from or last compacted to
+    boost::uint32_t generation_;
+    bool syncLog_;
+    bool replaying_;
+    unsigned int ioThreads_;
+    DataStoreCompression::Codec compression_;
+    bool lazyLoad_;
+};
+
+} //namespace rct
+
 #endif //DATA_STORE_H_
\ No newline at end of file
@@ -0,0 +1,183 @@
+#ifndef DATA_STORE_ARENA_H_
+#define DATA_STORE_ARENA_H_
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#include <boost/cstdint.hpp>
+
+namespace rct {
+
+//!  Data Store Arena
+/*!
+ * Slab allocator for records and column payloads.  Allocation bumps a
+ * pointer through the current slab; nothing is freed individually, the
+ * whole arena is released at once when the store is cleared or reloaded.
+ * Slabs start small and double up to MaxSlabSize so small stores stay
+ * small.  Destructors are not run - the owner destroys the objects it
+ * placed here before calling Release.  Not thread safe; concurrent
+ * producers fill their own arena and hand it to the owner with Adopt.
+ * Buffers outgrown by later updates stay in the arena until the release.
+ */
+class DataStoreArena
+{
+public:
+    static const size_t FirstSlabSize = 16 * 1024;
+    static const size_t MaxSlabSize = 1024 * 1024;
+private:
+    std::vector<unsigned char*> slabs_;
+    //Arenas filled elsewhere whose memory is released with this one
+    std::vector<DataStoreArena*> children_;
+    unsigned char* current_;
+    size_t remaining_;
+    size_t nextSlabSize_;
+    size_t bytesReserved_;
+private:
+    DataStoreArena(const DataStoreArena& rhs);
+    void operator=(const DataStoreArena& rhs);
+
+    unsigned char* newSlab(size_t size)
+    {
+        unsigned char* slab = static_cast<unsigned char*>(::operator new(size));
+        slabs_.push_back(slab);
+        bytesReserved_ += size;
+        return(slab);
+    }
+
+    static size_t padding(const unsigned char* pos, size_t alignment)
+    {
+        return((alignment - reinterpret_cast<boost::uintptr_t>(pos) % alignment) % alignment);
+    }
+public:
+    DataStoreArena() : current_(nullptr), remaining_(0), nextSlabSize_(FirstSlabSize), bytesReserved_(0) {}
+
+    ~DataStoreArena()
+    {
+        Release();
+    }
+
+    //Alignment must be a power of two no larger than the default new alignment
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        if (size == 0)size = 1;
+        size_t pad = (current_ == nullptr) ? 0 : padding(current_, alignment);
+        if (current_ == nullptr || pad + size > remaining_)
+        {
+            //Large payloads get a slab of their own instead of wasting the rest of the current one
+            if (size > nextSlabSize_ / 4)return(newSlab(size));
+            current_ = newSlab(nextSlabSize_);
+            remaining_ = nextSlabSize_;
+            nextSlabSize_ = std::min(nextSlabSize_ * 2, static_cast<size_t>(MaxSlabSize));
+            pad = 0;
+        }
+        unsigned char* rt = current_ + pad;
+        current_ += pad + size;
+        remaining_ -= pad + size;
+        return(rt);
+    }
+
+    //Takes ownership of an arena filled on another thread; it stays usable until Release
+    void Adopt(DataStoreArena* child)
+    {
+        if (child != nullptr)children_.push_back(child);
+    }
+
+    //Takes over the memory of another arena, which is left empty and usable; the memory stays
+    //where it is and is released with this arena
+    void Absorb(DataStoreArena& other)
+    {
+        slabs_.insert(slabs_.end(), other.slabs_.begin(), other.slabs_.end());
+        children_.insert(children_.end(), other.children_.begin(), other.children_.end());
+        bytesReserved_ += other.bytesReserved_;
+        other.slabs_.clear();
+        other.children_.clear();
+        other.current_ = nullptr;
+        other.remaining_ = 0;
+        other.nextSlabSize_ = FirstSlabSize;
+        other.bytesReserved_ = 0;
+    }
+
+    //Frees every slab at once; objects placed in the arena must already be destroyed
+    void Release()
+    {
+        for (size_t i = 0; i < slabs_.size(); ++i)
+        {
+            ::operator delete(slabs_[i]);
+        }
+        for (size_t i = 0; i < children_.size(); ++i)
+        {
+            delete children_[i];
+        }
+        slabs_.clear();
+        children_.clear();
+        current_ = nullptr;
+        remaining_ = 0;
+        nextSlabSize_ = FirstSlabSize;
+        bytesReserved_ = 0;
+    }
+
+    //Bytes held in slabs, adopted arenas included
+    size_t GetBytesReserved() const
+    {
+        size_t rt = bytesReserved_;
+        for (size_t i = 0; i < children_.size(); ++i)
+        {
+            rt += children_[i]->GetBytesReserved();
+        }
+        return(rt);
+    }
+};
+
+//!  Data Store Arena Allocator
+/*!
+ * Standard allocator over a DataStoreArena so containers inside records
+ * draw from the store's arena.  Deallocation is a no-op, the memory goes
+ * back with the arena.  Without an arena it falls back to the heap, which
+ * keeps records created outside of a store self contained.
+ */
+template <typename T>
+class DataStoreArenaAllocator
+{
+public:
+    typedef T value_type;
+    //Moved or swapped containers take their arena along; copies keep their own
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+public:
+    DataStoreArena* arena_;
+public:
+    DataStoreArenaAllocator() : arena_(nullptr) {}
+    explicit DataStoreArenaAllocator(DataStoreArena* arena) : arena_(arena) {}
+    template <typename U>
+    DataStoreArenaAllocator(const DataStoreArenaAllocator<U>& rhs) : arena_(rhs.arena_) {}
+
+    T* allocate(size_t count)
+    {
+        if (arena_ == nullptr)return(static_cast<T*>(::operator new(count * sizeof(T))));
+        return(static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T))));
+    }
+
+    void deallocate(T* ptr, size_t count)
+    {
+        if (arena_ == nullptr)::operator delete(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const DataStoreArenaAllocator<U>& rhs) const
+    {
+        return(arena_ == rhs.arena_);
+    }
+
+    template <typename U>
+    bool operator!=(const DataStoreArenaAllocator<U>& rhs) const
+    {
+        return(arena_ != rhs.arena_);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_ARENA_H_
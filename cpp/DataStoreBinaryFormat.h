@@ -0,0 +1,732 @@
+#ifndef DATA_STORE_BINARY_FORMAT_H_
+#define DATA_STORE_BINARY_FORMAT_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <boost/cstdint.hpp>
+#include <boost/crc.hpp>
+#include "DataStoreSchema.h"
+#include "DataStoreCompression.h"
+
+namespace rct {
+
+//!  Data Store Binary Format
+/*!
+ * Byte level building blocks for the versioned binary data store file.
+ * All integers are little endian and every block starts on an 8 byte
+ * boundary so the file can be consumed in place (see DataStore::Load).
+ *
+ * Layout (version 3):
+ *   File header      - 32 bytes (magic, version, flags, record/column/block
+ *                      counts, log generation), ends with a CRC of the preceding 28 bytes
+ *   Column names     - columnCount x [uint32 length, UTF-8 bytes], uint32 CRC, padded to 8
+ *   Blocks           - blockCount x [block header (48 bytes), payload padded to 8]
+ *   Block index      - with FLAG_BLOCK_INDEX: blockCount x uint64 file offset of
+ *                      each block header, uint32 CRC of the offsets, uint32 zero
+ *
+ * Version 3 adds the codec and uncompressed size to the block header (32
+ * bytes in version 2).  A compressed payload is stored as the codec wrote
+ * it and its CRC covers the stored bytes; the layouts below describe the
+ * payload after decompression.  Blocks that do not shrink are stored raw.
+ *
+ * The first block holds the record ids, every following block holds one
+ * column of one value type for all records.  Property and object blocks:
+ *   presence bitmap  - ceil(rowCount / 64) uint64 words
+ *   offsets          - (rowCount + 1) offsets of offsetWidth (4 or 8) bytes
+ *   values           - UTF-8 property strings or raw object bytes, back to back
+ * Typed blocks (version 2) keep the bitmap and replace offsets and values
+ * with rowCount values of offsetWidth bytes (8, or 1 for bool); absent
+ * rows hold zero.
+ */
+namespace DataStoreBinaryFormat
+{
+    static const unsigned char Magic[4] = { 'R', 'D', 'S', 'B' };
+    static const boost::uint16_t Version = 3;
+    static const size_t FileHeaderSize = 32;
+    static const size_t BlockHeaderSize = 48;
+    static const size_t Alignment = 8;
+    //Neither codec expands data by more than this; larger sizes in a header mean it is damaged
+    static const size_t MaxCompressionRatio = 1032;
+
+    typedef enum FileFlags
+    {
+        FLAG_BLOCK_INDEX = 1
+    };
+
+    typedef enum BlockType
+    {
+        BLOCK_RECORD_IDS = 1,
+        BLOCK_PROPERTY_COLUMN = 2,
+        BLOCK_OBJECT_COLUMN = 3,
+        BLOCK_INT64_COLUMN = 4,
+        BLOCK_DOUBLE_COLUMN = 5,
+        BLOCK_BOOL_COLUMN = 6,
+        BLOCK_TIMESTAMP_COLUMN = 7
+    };
+
+    struct FileHeader
+    {
+        boost::uint16_t version_;
+        boost::uint16_t flags_;
+        boost::uint64_t recordCount_;
+        boost::uint32_t columnCount_;
+        boost::uint32_t blockCount_;
+        //Bumped by every log compaction, see DataStoreLog.h
+        boost::uint32_t generation_;
+    };
+
+    struct BlockHeader
+    {
+        boost::uint32_t blockType_;
+        boost::uint32_t columnIdx_;
+        boost::uint64_t rowCount_;
+        boost::uint64_t payloadSize_;
+        boost::uint32_t payloadCrc_;
+        boost::uint32_t offsetWidth_;
+        //Version 3 - payloadSize_ is the stored size, rawSize_ the size after decompression
+        boost::uint32_t codec_;
+        boost::uint64_t rawSize_;
+    };
+
+    //! Block found in a file buffer or mapping; the payload points into that memory
+    struct BlockRef
+    {
+        BlockHeader header_;
+        const unsigned char* payload_;
+        BlockRef() : payload_(nullptr) {}
+    };
+
+    inline size_t AlignSize(size_t size)
+    {
+        return((size + Alignment - 1) & ~(Alignment - 1));
+    }
+
+    inline boost::uint32_t ComputeCRC(const unsigned char* data, size_t size)
+    {
+        boost::crc_32_type crc;
+        crc.process_bytes(data, size);
+        return(crc.checksum());
+    }
+
+    inline bool HasMagic(const unsigned char* data, size_t size)
+    {
+        return(size >= sizeof(Magic) && std::memcmp(data, Magic, sizeof(Magic)) == 0);
+    }
+
+    inline BlockType BlockTypeFor(DataStoreValueType type)
+    {
+        switch (type)
+        {
+        case DATASTORE_VALUE_BYTES:     return(BLOCK_OBJECT_COLUMN);
+        case DATASTORE_VALUE_INT64:     return(BLOCK_INT64_COLUMN);
+        case DATASTORE_VALUE_DOUBLE:    return(BLOCK_DOUBLE_COLUMN);
+        case DATASTORE_VALUE_BOOL:      return(BLOCK_BOOL_COLUMN);
+        case DATASTORE_VALUE_TIMESTAMP: return(BLOCK_TIMESTAMP_COLUMN);
+        default:                        return(BLOCK_PROPERTY_COLUMN);
+        }
+    }
+
+    //DATASTORE_VALUE_NONE for the record id block and unknown block types
+    inline DataStoreValueType ValueTypeFor(boost::uint32_t blockType)
+    {
+        switch (blockType)
+        {
+        case BLOCK_PROPERTY_COLUMN:  return(DATASTORE_VALUE_STRING);
+        case BLOCK_OBJECT_COLUMN:    return(DATASTORE_VALUE_BYTES);
+        case BLOCK_INT64_COLUMN:     return(DATASTORE_VALUE_INT64);
+        case BLOCK_DOUBLE_COLUMN:    return(DATASTORE_VALUE_DOUBLE);
+        case BLOCK_BOOL_COLUMN:      return(DATASTORE_VALUE_BOOL);
+        case BLOCK_TIMESTAMP_COLUMN: return(DATASTORE_VALUE_TIMESTAMP);
+        default:                     return(DATASTORE_VALUE_NONE);
+        }
+    }
+
+    //Fixed width values are the low width bytes of a uint64, little endian
+    inline void EncodeFixed(boost::uint64_t val, size_t width, unsigned char* out)
+    {
+        for (size_t i = 0; i < width; ++i)out[i] = static_cast<unsigned char>(val >> (i * 8));
+    }
+
+    inline boost::uint64_t DecodeFixed(const unsigned char* data, size_t width)
+    {
+        boost::uint64_t val = 0;
+        for (size_t i = 0; i < width; ++i)val |= static_cast<boost::uint64_t>(data[i]) << (i * 8);
+        return(val);
+    }
+
+    //Doubles travel as their IEEE 754 bit pattern
+    inline boost::uint64_t DoubleToBits(double val)
+    {
+        boost::uint64_t bits = 0;
+        std::memcpy(&bits, &val, sizeof(bits));
+        return(bits);
+    }
+
+    inline double BitsToDouble(boost::uint64_t bits)
+    {
+        double val = 0;
+        std::memcpy(&val, &bits, sizeof(val));
+        return(val);
+    }
+
+    //!  Binary Writer
+    /*!
+     * Appends little endian primitives to a growable byte buffer.
+     */
+    class BinaryWriter
+    {
+    private:
+        std::vector<unsigned char> buffer_;
+    public:
+        BinaryWriter() {}
+
+        void WriteUInt8(boost::uint8_t val)
+        {
+            buffer_.push_back(val);
+        }
+
+        void WriteUInt16(boost::uint16_t val)
+        {
+            for (unsigned int i = 0; i < 2; ++i)buffer_.push_back(static_cast<unsigned char>(val >> (i * 8)));
+        }
+
+        void WriteUInt32(boost::uint32_t val)
+        {
+            for (unsigned int i = 0; i < 4; ++i)buffer_.push_back(static_cast<unsigned char>(val >> (i * 8)));
+        }
+
+        void WriteUInt64(boost::uint64_t val)
+        {
+            for (unsigned int i = 0; i < 8; ++i)buffer_.push_back(static_cast<unsigned char>(val >> (i * 8)));
+        }
+
+        void WriteBytes(const void* data, size_t size)
+        {
+            if (size == 0)return;
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            buffer_.insert(buffer_.end(), bytes, bytes + size);
+        }
+
+        //Writes a uint32 length followed by the raw bytes
+        void WriteString(const std::string& val)
+        {
+            WriteUInt32(static_cast<boost::uint32_t>(val.size()));
+            WriteBytes(val.data(), val.size());
+        }
+
+        void Align()
+        {
+            buffer_.resize(AlignSize(buffer_.size()), 0);
+        }
+
+        void Reserve(size_t size)
+        {
+            buffer_.reserve(size);
+        }
+
+        void Clear()
+        {
+            buffer_.clear();
+        }
+
+        size_t GetSize() const
+        {
+            return(buffer_.size());
+        }
+
+        const unsigned char* GetData() const
+        {
+            return(buffer_.empty() ? nullptr : &buffer_[0]);
+        }
+
+        std::vector<unsigned char>& GetBuffer()
+        {
+            return(buffer_);
+        }
+    };
+
+    //!  Binary Reader
+    /*!
+     * Bounds checked cursor over a byte range it does not own.  Every read
+     * returns false instead of running past the end of the range.
+     */
+    class BinaryReader
+    {
+    private:
+        const unsigned char* data_;
+        size_t size_;
+        size_t pos_;
+    public:
+        BinaryReader(const unsigned char* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+        bool ReadUInt16(boost::uint16_t& val)
+        {
+            if (size_ - pos_ < 2)return(false);
+            val = 0;
+            for (unsigned int i = 0; i < 2; ++i)val |= static_cast<boost::uint16_t>(data_[pos_ + i]) << (i * 8);
+            pos_ += 2;
+            return(true);
+        }
+
+        bool ReadUInt32(boost::uint32_t& val)
+        {
+            if (size_ - pos_ < 4)return(false);
+            val = 0;
+            for (unsigned int i = 0; i < 4; ++i)val |= static_cast<boost::uint32_t>(data_[pos_ + i]) << (i * 8);
+            pos_ += 4;
+            return(true);
+        }
+
+        bool ReadUInt64(boost::uint64_t& val)
+        {
+            if (size_ - pos_ < 8)return(false);
+            val = 0;
+            for (unsigned int i = 0; i < 8; ++i)val |= static_cast<boost::uint64_t>(data_[pos_ + i]) << (i * 8);
+            pos_ += 8;
+            return(true);
+        }
+
+        //Returns a pointer into the underlying range - no copy is made
+        bool ReadBytes(size_t size, const unsigned char*& bytes)
+        {
+            if (size_ - pos_ < size)return(false);
+            bytes = data_ + pos_;
+            pos_ += size;
+            return(true);
+        }
+
+        bool ReadString(std::string& val)
+        {
+            boost::uint32_t len = 0;
+            const unsigned char* bytes = nullptr;
+            if (!ReadUInt32(len) || !ReadBytes(len, bytes))return(false);
+            val.assign(reinterpret_cast<const char*>(bytes), len);
+            return(true);
+        }
+
+        bool Align()
+        {
+            size_t aligned = AlignSize(pos_);
+            if (aligned > size_)return(false);
+            pos_ = aligned;
+            return(true);
+        }
+
+        size_t GetPosition() const
+        {
+            return(pos_);
+        }
+
+        const unsigned char* GetCurrent() const
+        {
+            return(data_ + pos_);
+        }
+
+        size_t GetRemaining() const
+        {
+            return(size_ - pos_);
+        }
+    };
+
+    inline void WriteFileHeader(BinaryWriter& writer, const FileHeader& header)
+    {
+        size_t start = writer.GetSize();
+        writer.WriteBytes(Magic, sizeof(Magic));
+        writer.WriteUInt16(header.version_);
+        writer.WriteUInt16(header.flags_);
+        writer.WriteUInt64(header.recordCount_);
+        writer.WriteUInt32(header.columnCount_);
+        writer.WriteUInt32(header.blockCount_);
+        writer.WriteUInt32(header.generation_);
+        writer.WriteUInt32(ComputeCRC(writer.GetData() + start, FileHeaderSize - 4));
+    }
+
+    inline bool ReadFileHeader(BinaryReader& reader, FileHeader& header)
+    {
+        const unsigned char* start = reader.GetCurrent();
+        const unsigned char* magic = nullptr;
+        boost::uint32_t crc = 0;
+        if (!reader.ReadBytes(sizeof(Magic), magic) || !HasMagic(magic, sizeof(Magic)))return(false);
+        if (!reader.ReadUInt16(header.version_) || !reader.ReadUInt16(header.flags_))return(false);
+        if (!reader.ReadUInt64(header.recordCount_))return(false);
+        if (!reader.ReadUInt32(header.columnCount_) || !reader.ReadUInt32(header.blockCount_))return(false);
+        if (!reader.ReadUInt32(header.generation_) || !reader.ReadUInt32(crc))return(false);
+        //Reject files written by a newer version or damaged in the header
+        if (header.version_ > Version)return(false);
+        return(crc == ComputeCRC(start, FileHeaderSize - 4));
+    }
+
+    inline void WriteBlockHeader(BinaryWriter& writer, const BlockHeader& header)
+    {
+        writer.WriteUInt32(header.blockType_);
+        writer.WriteUInt32(header.columnIdx_);
+        writer.WriteUInt64(header.rowCount_);
+        writer.WriteUInt64(header.payloadSize_);
+        writer.WriteUInt32(header.payloadCrc_);
+        writer.WriteUInt32(header.offsetWidth_);
+        writer.WriteUInt32(header.codec_);
+        writer.WriteUInt32(0);
+        writer.WriteUInt64(header.rawSize_);
+    }
+
+    //Version 2 headers have no codec fields and describe raw payloads
+    inline bool ReadBlockHeader(BinaryReader& reader, BlockHeader& header, boost::uint16_t version)
+    {
+        if (!reader.ReadUInt32(header.blockType_) ||
+            !reader.ReadUInt32(header.columnIdx_) ||
+            !reader.ReadUInt64(header.rowCount_) ||
+            !reader.ReadUInt64(header.payloadSize_) ||
+            !reader.ReadUInt32(header.payloadCrc_) ||
+            !reader.ReadUInt32(header.offsetWidth_))
+        {
+            return(false);
+        }
+        header.codec_ = DataStoreCompression::CODEC_NONE;
+        header.rawSize_ = header.payloadSize_;
+        if (version < 3)return(true);
+        boost::uint32_t reserved = 0;
+        return(reader.ReadUInt32(header.codec_) && reader.ReadUInt32(reserved) && reader.ReadUInt64(header.rawSize_));
+    }
+
+    //Fills in the size, CRC and codec fields of the header and appends the block.  The payload is
+    //compressed with the codec unless that does not make it smaller
+    inline void WriteBlock(BinaryWriter& writer, BlockHeader& header, const unsigned char* payload, size_t size, DataStoreCompression::Codec codec)
+    {
+        std::vector<unsigned char> packed;
+        header.codec_ = DataStoreCompression::CODEC_NONE;
+        header.rawSize_ = size;
+        if (codec != DataStoreCompression::CODEC_NONE && size > 0 &&
+            DataStoreCompression::Compress(codec, payload, size, packed) && !packed.empty() && packed.size() < size)
+        {
+            header.codec_ = codec;
+            payload = &packed[0];
+            size = packed.size();
+        }
+        header.payloadSize_ = size;
+        header.payloadCrc_ = ComputeCRC(payload, size);
+        WriteBlockHeader(writer, header);
+        writer.WriteBytes(payload, size);
+        writer.Align();
+    }
+
+    //Trailer listing where each block header starts, written after the last block
+    inline void WriteBlockIndex(BinaryWriter& writer, const std::vector<boost::uint64_t>& offsets)
+    {
+        size_t start = writer.GetSize();
+        for (size_t i = 0; i < offsets.size(); ++i)writer.WriteUInt64(offsets[i]);
+        writer.WriteUInt32(ComputeCRC(writer.GetData() + start, writer.GetSize() - start));
+        writer.WriteUInt32(0);
+    }
+
+    inline bool readBlock(const unsigned char* data, size_t size, boost::uint16_t version, BlockRef& block)
+    {
+        BinaryReader reader(data, size);
+        return(ReadBlockHeader(reader, block.header_, version) && reader.ReadBytes(static_cast<size_t>(block.header_.payloadSize_), block.payload_));
+    }
+
+    //Finds every block of a file held in memory; data[blocksStart] is the first block header.
+    //Files with a block index are located from it, older files by walking the block headers
+    inline bool LocateBlocks(const unsigned char* data, size_t size, size_t blocksStart, const FileHeader& header, std::vector<BlockRef>& blocks)
+    {
+        blocks.assign(header.blockCount_, BlockRef());
+        if ((header.flags_ & FLAG_BLOCK_INDEX) == 0)
+        {
+            BinaryReader reader(data + blocksStart, size - blocksStart);
+            for (size_t b = 0; b < blocks.size(); ++b)
+            {
+                if (!ReadBlockHeader(reader, blocks[b].header_, header.version_) ||
+                    !reader.ReadBytes(static_cast<size_t>(blocks[b].header_.payloadSize_), blocks[b].payload_) ||
+                    !reader.Align())
+                {
+                    return(false);
+                }
+            }
+            return(true);
+        }
+        boost::uint64_t indexSize = static_cast<boost::uint64_t>(header.blockCount_) * 8 + 8;
+        if (blocksStart > size || size - blocksStart < indexSize)return(false);
+        size_t blocksEnd = size - static_cast<size_t>(indexSize);
+        const unsigned char* index = data + blocksEnd;
+        if (DecodeFixed(index + header.blockCount_ * 8, 4) != ComputeCRC(index, header.blockCount_ * 8))return(false);
+        for (size_t b = 0; b < blocks.size(); ++b)
+        {
+            boost::uint64_t offset = DecodeFixed(index + b * 8, 8);
+            if (offset < blocksStart || offset >= blocksEnd || offset % Alignment != 0)return(false);
+            if (!readBlock(data + offset, blocksEnd - static_cast<size_t>(offset), header.version_, blocks[b]))return(false);
+        }
+        return(true);
+    }
+
+    //Verifies the stored bytes if asked, then decompresses them into buffer and points the block at
+    //the result.  The header then describes the raw payload, so the block views work unchanged
+    inline bool InflateBlock(BlockRef& block, std::vector<unsigned char>& buffer, bool verify)
+    {
+        BlockHeader& header = block.header_;
+        size_t size = static_cast<size_t>(header.payloadSize_);
+        if (verify && header.payloadCrc_ != ComputeCRC(block.payload_, size))return(false);
+        if (header.codec_ == DataStoreCompression::CODEC_NONE)return(header.rawSize_ == header.payloadSize_);
+        if (header.rawSize_ == 0 || header.rawSize_ / MaxCompressionRatio > header.payloadSize_)return(false);
+        if (!DataStoreCompression::Decompress(static_cast<DataStoreCompression::Codec>(header.codec_), block.payload_, size, buffer, static_cast<size_t>(header.rawSize_)))
+        {
+            return(false);
+        }
+        block.payload_ = &buffer[0];
+        header.payloadSize_ = header.rawSize_;
+        header.codec_ = DataStoreCompression::CODEC_NONE;
+        return(true);
+    }
+
+    //!  Column Block Builder
+    /*!
+     * Accumulates one column for rows 0..n-1 in order and emits the
+     * presence bitmap / offsets / values payload described above.
+     */
+    class ColumnBlockBuilder
+    {
+    private:
+        std::vector<boost::uint64_t> presence_;
+        std::vector<boost::uint64_t> offsets_;
+        std::vector<unsigned char> values_;
+    public:
+        explicit ColumnBlockBuilder(size_t rowCount)
+        {
+            presence_.resize((rowCount + 63) / 64, 0);
+            offsets_.reserve(rowCount + 1);
+            offsets_.push_back(0);
+        }
+
+        void AddValue(const void* data, size_t size)
+        {
+            size_t row = offsets_.size() - 1;
+            presence_[row >> 6] |= (static_cast<boost::uint64_t>(1) << (row & 63));
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            if (size > 0)values_.insert(values_.end(), bytes, bytes + size);
+            offsets_.push_back(values_.size());
+        }
+
+        void AddNull()
+        {
+            offsets_.push_back(values_.size());
+        }
+
+        void Write(BinaryWriter& writer, BlockType blockType, boost::uint32_t columnIdx, DataStoreCompression::Codec codec = DataStoreCompression::CODEC_NONE)
+        {
+            size_t rowCount = offsets_.size() - 1;
+            boost::uint32_t offsetWidth = (values_.size() > 0xFFFFFFFFul) ? 8 : 4;
+            BinaryWriter payload;
+            payload.Reserve(presence_.size() * 8 + offsets_.size() * offsetWidth + values_.size());
+            for (size_t i = 0; i < presence_.size(); ++i)payload.WriteUInt64(presence_[i]);
+            for (size_t i = 0; i < offsets_.size(); ++i)
+            {
+                if (offsetWidth == 4)payload.WriteUInt32(static_cast<boost::uint32_t>(offsets_[i]));
+                else payload.WriteUInt64(offsets_[i]);
+            }
+            payload.WriteBytes(values_.empty() ? nullptr : &values_[0], values_.size());
+
+            BlockHeader header;
+            header.blockType_ = blockType;
+            header.columnIdx_ = columnIdx;
+            header.rowCount_ = rowCount;
+            header.offsetWidth_ = offsetWidth;
+            WriteBlock(writer, header, payload.GetData(), payload.GetSize(), codec);
+        }
+    };
+
+    //!  Column Block View
+    /*!
+     * Random access over a column payload that lives elsewhere (a load
+     * buffer or a mapped file).  Values are returned as pointers into that
+     * memory; nothing is copied.
+     */
+    class ColumnBlockView
+    {
+    private:
+        const unsigned char* presence_;
+        const unsigned char* offsets_;
+        const unsigned char* values_;
+        boost::uint64_t rowCount_;
+        boost::uint64_t valuesSize_;
+        boost::uint32_t offsetWidth_;
+    private:
+        boost::uint64_t offsetAt(boost::uint64_t row) const
+        {
+            const unsigned char* p = offsets_ + row * offsetWidth_;
+            boost::uint64_t val = 0;
+            for (unsigned int i = 0; i < offsetWidth_; ++i)val |= static_cast<boost::uint64_t>(p[i]) << (i * 8);
+            return(val);
+        }
+    public:
+        ColumnBlockView() : presence_(nullptr), offsets_(nullptr), values_(nullptr), rowCount_(0), valuesSize_(0), offsetWidth_(0) {}
+
+        bool Init(const BlockHeader& header, const unsigned char* payload)
+        {
+            if (header.offsetWidth_ != 4 && header.offsetWidth_ != 8)return(false);
+            //rowCount_ + 1 offsets must fit the payload; checked by division so a forged count cannot wrap the sizes
+            if (header.rowCount_ >= header.payloadSize_ / header.offsetWidth_)return(false);
+            boost::uint64_t presenceSize = ((header.rowCount_ + 63) / 64) * 8;
+            boost::uint64_t offsetsSize = (header.rowCount_ + 1) * header.offsetWidth_;
+            if (presenceSize > header.payloadSize_ - offsetsSize)return(false);
+            presence_ = payload;
+            offsets_ = payload + presenceSize;
+            values_ = offsets_ + offsetsSize;
+            rowCount_ = header.rowCount_;
+            valuesSize_ = header.payloadSize_ - presenceSize - offsetsSize;
+            offsetWidth_ = header.offsetWidth_;
+            //The last offset must land exactly at the end of the values
+            return(offsetAt(rowCount_) == valuesSize_);
+        }
+
+        boost::uint64_t GetRowCount() const
+        {
+            return(rowCount_);
+        }
+
+        bool IsPresent(boost::uint64_t row) const
+        {
+            if (row >= rowCount_)return(false);
+            return((presence_[row >> 3] & (1 << (row & 7))) != 0);
+        }
+
+        bool GetValue(boost::uint64_t row, const unsigned char*& data, size_t& size) const
+        {
+            if (!IsPresent(row))return(false);
+            boost::uint64_t start = offsetAt(row);
+            boost::uint64_t end = offsetAt(row + 1);
+            if (start > end || end > valuesSize_)return(false);
+            data = values_ + start;
+            size = static_cast<size_t>(end - start);
+            return(true);
+        }
+    };
+
+    //!  Fixed Column Block Builder
+    /*!
+     * Typed counterpart of ColumnBlockBuilder: values are a fixed number of
+     * bytes, so the block needs no offsets and a row is found by position.
+     */
+    class FixedColumnBlockBuilder
+    {
+    private:
+        std::vector<boost::uint64_t> presence_;
+        BinaryWriter values_;
+        size_t width_;
+        size_t row_;
+    public:
+        FixedColumnBlockBuilder(size_t rowCount, size_t width) :
+            width_(width),
+            row_(0)
+        {
+            presence_.resize((rowCount + 63) / 64, 0);
+            values_.Reserve(rowCount * width);
+        }
+
+        void AddValue(boost::uint64_t val)
+        {
+            presence_[row_ >> 6] |= (static_cast<boost::uint64_t>(1) << (row_ & 63));
+            std::vector<unsigned char>& buffer = values_.GetBuffer();
+            buffer.resize(buffer.size() + width_);
+            EncodeFixed(val, width_, &buffer[buffer.size() - width_]);
+            ++row_;
+        }
+
+        void AddNull()
+        {
+            std::vector<unsigned char>& buffer = values_.GetBuffer();
+            buffer.resize(buffer.size() + width_, 0);
+            ++row_;
+        }
+
+        void Write(BinaryWriter& writer, BlockType blockType, boost::uint32_t columnIdx, DataStoreCompression::Codec codec = DataStoreCompression::CODEC_NONE)
+        {
+            BinaryWriter payload;
+            payload.Reserve(presence_.size() * 8 + values_.GetSize());
+            for (size_t i = 0; i < presence_.size(); ++i)payload.WriteUInt64(presence_[i]);
+            payload.WriteBytes(values_.GetData(), values_.GetSize());
+
+            BlockHeader header;
+            header.blockType_ = blockType;
+            header.columnIdx_ = columnIdx;
+            header.rowCount_ = row_;
+            header.offsetWidth_ = static_cast<boost::uint32_t>(width_);
+            WriteBlock(writer, header, payload.GetData(), payload.GetSize(), codec);
+        }
+    };
+
+    //!  Fixed Column Block View
+    /*!
+     * Random access over a typed column payload; values point into the
+     * payload memory like ColumnBlockView.
+     */
+    class FixedColumnBlockView
+    {
+    private:
+        const unsigned char* presence_;
+        const unsigned char* values_;
+        boost::uint64_t rowCount_;
+        boost::uint32_t width_;
+    public:
+        FixedColumnBlockView() : presence_(nullptr), values_(nullptr), rowCount_(0), width_(0) {}
+
+        bool Init(const BlockHeader& header, const unsigned char* payload)
+        {
+            if (header.offsetWidth_ != 1 && header.offsetWidth_ != 8)return(false);
+            if (header.rowCount_ > header.payloadSize_ / header.offsetWidth_)return(false);
+            boost::uint64_t presenceSize = ((header.rowCount_ + 63) / 64) * 8;
+            if (presenceSize != header.payloadSize_ - header.rowCount_ * header.offsetWidth_)return(false);
+            presence_ = payload;
+            values_ = payload + presenceSize;
+            rowCount_ = header.rowCount_;
+            width_ = header.offsetWidth_;
+            return(true);
+        }
+
+        boost::uint64_t GetRowCount() const
+        {
+            return(rowCount_);
+        }
+
+        bool IsPresent(boost::uint64_t row) const
+        {
+            if (row >= rowCount_)return(false);
+            return((presence_[row >> 3] & (1 << (row & 7))) != 0);
+        }
+
+        bool GetValue(boost::uint64_t row, const unsigned char*& data, size_t& size) const
+        {
+            if (!IsPresent(row))return(false);
+            data = values_ + row * width_;
+            size = width_;
+            return(true);
+        }
+    };
+
+    //Reads an entire file into memory with a single allocation
+    inline bool ReadFileBytes(const std::string& fileName, std::vector<unsigned char>& data)
+    {
+        std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+        if (!input.is_open())return(false);
+        input.seekg(0, std::ios::end);
+        std::streamoff size = input.tellg();
+        if (size <= 0)return(false);
+        input.seekg(0, std::ios::beg);
+        data.resize(static_cast<size_t>(size));
+        input.read(reinterpret_cast<char*>(&data[0]), size);
+        return(input.gcount() == size);
+    }
+
+    //Sniffs the magic so callers can tell binary files from legacy text files
+    inline bool IsBinaryFile(const std::string& fileName)
+    {
+        std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+        if (!input.is_open())return(false);
+        unsigned char magic[sizeof(Magic)];
+        input.read(reinterpret_cast<char*>(magic), sizeof(magic));
+        return(input.gcount() == static_cast<std::streamsize>(sizeof(magic)) && HasMagic(magic, sizeof(magic)));
+    }
+}
+
+} //namespace rct
+
+#endif //DATA_STORE_BINARY_FORMAT_H_
@@ -0,0 +1,313 @@
+#ifndef DATA_STORE_COLUMN_STORE_H_
+#define DATA_STORE_COLUMN_STORE_H_
+
+#include "DataStoreSchema.h"
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace rct {
+
+//!  Data Store Column Store
+/*!
+ * Column major copy of the typed columns of a data store.  Every (column,
+ * value type) pair is one contiguous array indexed by row id plus a
+ * validity bitmap.  Rows without a value hold zero, so sums are plain
+ * loops over the array; min, max and range filters walk the bitmap a
+ * 64 row word at a time and run branch free over full words.  Int64, bool
+ * and timestamp values share the int64 layout, doubles have their own.
+ */
+class DataStoreColumnStore
+{
+public:
+    typedef DataStoreSchema::ColumnId ColumnId;
+    typedef boost::function<bool (double)> Predicate;
+private:
+    //Int64, double, bool, timestamp - in DataStoreValueType order
+    static const size_t TypedKinds = 4;
+    static const size_t WordRows = 64;
+
+    struct ColumnArray
+    {
+        //Sized to whole bitmap words so full words can be scanned without bounds checks
+        std::vector<boost::int64_t> ints_;
+        std::vector<double> doubles_;
+        std::vector<boost::uint64_t> valid_;
+        size_t count_;
+        ColumnArray() : count_(0) {}
+    };
+private:
+    std::vector<ColumnArray> arrays_;
+private:
+    DataStoreColumnStore(const DataStoreColumnStore& rhs);
+    void operator=(const DataStoreColumnStore& rhs);
+
+    static bool isTyped(DataStoreValueType type)
+    {
+        return(type >= DATASTORE_VALUE_INT64 && type <= DATASTORE_VALUE_TIMESTAMP);
+    }
+
+    static unsigned int lowestBit(boost::uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long idx = 0;
+        _BitScanForward64(&idx, bits);
+        return(static_cast<unsigned int>(idx));
+#else
+        return(static_cast<unsigned int>(__builtin_ctzll(bits)));
+#endif
+    }
+
+    const ColumnArray* findArray(ColumnId id, DataStoreValueType type) const
+    {
+        if (!isTyped(type))return(nullptr);
+        size_t idx = static_cast<size_t>(id) * TypedKinds + (type - DATASTORE_VALUE_INT64);
+        if (idx >= arrays_.size() || arrays_[idx].count_ == 0)return(nullptr);
+        return(&arrays_[idx]);
+    }
+
+    ColumnArray& prepareArray(ColumnId id, DataStoreValueType type, size_t row)
+    {
+        size_t idx = static_cast<size_t>(id) * TypedKinds + (type - DATASTORE_VALUE_INT64);
+        if (idx >= arrays_.size())arrays_.resize((static_cast<size_t>(id) + 1) * TypedKinds);
+        ColumnArray& column = arrays_[idx];
+        size_t words = row / WordRows + 1;
+        if (words > column.valid_.size())
+        {
+            //Grow geometrically so appending rows stays amortized constant time
+            words = std::max(words, column.valid_.size() * 2);
+            column.valid_.resize(words, 0);
+            if (type == DATASTORE_VALUE_DOUBLE)column.doubles_.resize(words * WordRows, 0);
+            else column.ints_.resize(words * WordRows, 0);
+        }
+        return(column);
+    }
+
+    static void clearRow(ColumnArray& column, size_t row)
+    {
+        if (row / WordRows >= column.valid_.size())return;
+        boost::uint64_t mask = static_cast<boost::uint64_t>(1) << (row % WordRows);
+        if ((column.valid_[row / WordRows] & mask) == 0)return;
+        column.valid_[row / WordRows] &= ~mask;
+        if (!column.doubles_.empty())column.doubles_[row] = 0;
+        else column.ints_[row] = 0;
+        --column.count_;
+    }
+
+    //Four running sums keep the additions independent so the loop vectorizes without reassociation flags
+    template <typename ValueT>
+    static ValueT sumValues(const std::vector<ValueT>& values)
+    {
+        ValueT partial[4] = { 0, 0, 0, 0 };
+        const ValueT* v = values.empty() ? nullptr : &values[0];
+        size_t count = values.size();
+        for (size_t i = 0; i + 4 <= count; i += 4)
+        {
+            partial[0] += v[i];
+            partial[1] += v[i + 1];
+            partial[2] += v[i + 2];
+            partial[3] += v[i + 3];
+        }
+        for (size_t i = count & ~static_cast<size_t>(3); i < count; ++i)partial[0] += v[i];
+        return((partial[0] + partial[1]) + (partial[2] + partial[3]));
+    }
+
+    template <typename ValueT, typename CompareT>
+    static bool extremeValue(const std::vector<ValueT>& values, const std::vector<boost::uint64_t>& valid, ValueT& result)
+    {
+        CompareT better;
+        bool found = false;
+        ValueT best = 0;
+        for (size_t w = 0; w < valid.size(); ++w)
+        {
+            boost::uint64_t bits = valid[w];
+            if (bits == 0)continue;
+            const ValueT* v = &values[w * WordRows];
+            if (bits == ~static_cast<boost::uint64_t>(0))
+            {
+                ValueT wordBest = v[0];
+                for (size_t i = 1; i < WordRows; ++i)wordBest = better(v[i], wordBest) ? v[i] : wordBest;
+                if (!found || better(wordBest, best))best = wordBest;
+                found = true;
+                continue;
+            }
+            for (; bits != 0; bits &= bits - 1)
+            {
+                ValueT val = v[lowestBit(bits)];
+                if (!found || better(val, best))best = val;
+                found = true;
+            }
+        }
+        if (found)result = best;
+        return(found);
+    }
+
+    template <typename ValueT>
+    static size_t filterRange(const std::vector<ValueT>& values, const std::vector<boost::uint64_t>& valid, ValueT low, ValueT high, std::vector<size_t>& rows)
+    {
+        size_t matches = 0;
+        for (size_t w = 0; w < valid.size(); ++w)
+        {
+            if (valid[w] == 0)continue;
+            const ValueT* v = &values[w * WordRows];
+            boost::uint64_t hits = 0;
+            for (size_t i = 0; i < WordRows; ++i)
+            {
+                hits |= static_cast<boost::uint64_t>((v[i] >= low) & (v[i] <= high)) << i;
+            }
+            for (hits &= valid[w]; hits != 0; hits &= hits - 1)
+            {
+                rows.push_back(w * WordRows + lowestBit(hits));
+                ++matches;
+            }
+        }
+        return(matches);
+    }
+public:
+    DataStoreColumnStore() {}
+
+    void Clear()
+    {
+        arrays_.clear();
+    }
+
+    //Stores a typed value for the row; any other type the column held for the row is dropped
+    void SetValue(size_t row, ColumnId id, DataStoreValueType type, boost::uint64_t bits)
+    {
+        ClearValue(row, id);
+        if (!isTyped(type))return;
+        ColumnArray& column = prepareArray(id, type, row);
+        column.valid_[row / WordRows] |= static_cast<boost::uint64_t>(1) << (row % WordRows);
+        if (type == DATASTORE_VALUE_DOUBLE)
+        {
+            double val = 0;
+            std::memcpy(&val, &bits, sizeof(val));
+            column.doubles_[row] = val;
+        }
+        else
+        {
+            column.ints_[row] = static_cast<boost::int64_t>(bits);
+        }
+        ++column.count_;
+    }
+
+    void ClearValue(size_t row, ColumnId id)
+    {
+        size_t first = static_cast<size_t>(id) * TypedKinds;
+        for (size_t i = first; i < first + TypedKinds && i < arrays_.size(); ++i)
+        {
+            clearRow(arrays_[i], row);
+        }
+    }
+
+    bool HasColumn(ColumnId id, DataStoreValueType type) const
+    {
+        return(findArray(id, type) != nullptr);
+    }
+
+    //Rows holding a value of the type
+    size_t Count(ColumnId id, DataStoreValueType type) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        return((column == nullptr) ? 0 : column->count_);
+    }
+
+    //Exact sum of an int64, bool or timestamp column
+    bool Sum(ColumnId id, DataStoreValueType type, boost::int64_t& total) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr || type == DATASTORE_VALUE_DOUBLE)return(false);
+        total = sumValues(column->ints_);
+        return(true);
+    }
+
+    bool Sum(ColumnId id, DataStoreValueType type, double& total) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr)return(false);
+        if (type == DATASTORE_VALUE_DOUBLE)total = sumValues(column->doubles_);
+        else total = static_cast<double>(sumValues(column->ints_));
+        return(true);
+    }
+
+    bool Min(ColumnId id, DataStoreValueType type, boost::int64_t& result) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr || type == DATASTORE_VALUE_DOUBLE)return(false);
+        return(extremeValue<boost::int64_t, std::less<boost::int64_t>>(column->ints_, column->valid_, result));
+    }
+
+    bool Min(ColumnId id, DataStoreValueType type, double& result) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr)return(false);
+        if (type == DATASTORE_VALUE_DOUBLE)return(extremeValue<double, std::less<double>>(column->doubles_, column->valid_, result));
+        boost::int64_t intResult = 0;
+        if (!extremeValue<boost::int64_t, std::less<boost::int64_t>>(column->ints_, column->valid_, intResult))return(false);
+        result = static_cast<double>(intResult);
+        return(true);
+    }
+
+    bool Max(ColumnId id, DataStoreValueType type, boost::int64_t& result) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr || type == DATASTORE_VALUE_DOUBLE)return(false);
+        return(extremeValue<boost::int64_t, std::greater<boost::int64_t>>(column->ints_, column->valid_, result));
+    }
+
+    bool Max(ColumnId id, DataStoreValueType type, double& result) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr)return(false);
+        if (type == DATASTORE_VALUE_DOUBLE)return(extremeValue<double, std::greater<double>>(column->doubles_, column->valid_, result));
+        boost::int64_t intResult = 0;
+        if (!extremeValue<boost::int64_t, std::greater<boost::int64_t>>(column->ints_, column->valid_, intResult))return(false);
+        result = static_cast<double>(intResult);
+        return(true);
+    }
+
+    //Appends the rows whose value lies in [low, high] to rows, in row order; returns the number appended
+    size_t FilterInt64(ColumnId id, DataStoreValueType type, boost::int64_t low, boost::int64_t high, std::vector<size_t>& rows) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr || type == DATASTORE_VALUE_DOUBLE)return(0);
+        return(filterRange(column->ints_, column->valid_, low, high, rows));
+    }
+
+    size_t FilterDouble(ColumnId id, double low, double high, std::vector<size_t>& rows) const
+    {
+        const ColumnArray* column = findArray(id, DATASTORE_VALUE_DOUBLE);
+        if (column == nullptr)return(0);
+        return(filterRange(column->doubles_, column->valid_, low, high, rows));
+    }
+
+    //Arbitrary predicates cost a call per row - prefer the range filters where they fit
+    size_t Filter(ColumnId id, DataStoreValueType type, const Predicate& predicate, std::vector<size_t>& rows) const
+    {
+        const ColumnArray* column = findArray(id, type);
+        if (column == nullptr || predicate.empty())return(0);
+        size_t matches = 0;
+        for (size_t w = 0; w < column->valid_.size(); ++w)
+        {
+            for (boost::uint64_t bits = column->valid_[w]; bits != 0; bits &= bits - 1)
+            {
+                size_t row = w * WordRows + lowestBit(bits);
+                double val = (type == DATASTORE_VALUE_DOUBLE) ? column->doubles_[row] : static_cast<double>(column->ints_[row]);
+                if (!predicate(val))continue;
+                rows.push_back(row);
+                ++matches;
+            }
+        }
+        return(matches);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_COLUMN_STORE_H_
@@ -0,0 +1,190 @@
+#ifndef DATA_STORE_COMPRESSION_H_
+#define DATA_STORE_COMPRESSION_H_
+
+#include <vector>
+#include <cstring>
+#include <boost/cstdint.hpp>
+#include <zdeflate.h>
+#include <zinflate.h>
+
+namespace rct {
+
+//!  Data Store Compression
+/*!
+ * Block codecs for the binary data store file.  CODEC_FAST writes the LZ4
+ * block format (greedy matching, 64 KiB window): it costs little on save
+ * and decodes at memory speed.  CODEC_DEFLATE is raw deflate through
+ * Crypto++ for a better ratio at a higher save cost.  Codec ids are
+ * persisted in block headers and must not be renumbered.
+ */
+namespace DataStoreCompression
+{
+    typedef enum Codec
+    {
+        CODEC_NONE = 0,
+        CODEC_FAST = 1,
+        CODEC_DEFLATE = 2
+    };
+
+    static const size_t FastMinMatch = 4;
+    //LZ4 end of block rules: the last 5 bytes are literals and no match starts in the last 12
+    static const size_t FastLastLiterals = 5;
+    static const size_t FastMatchLimit = 12;
+    static const size_t FastMaxOffset = 65535;
+    static const unsigned int FastHashBits = 16;
+
+    inline boost::uint32_t readUInt32(const unsigned char* p)
+    {
+        boost::uint32_t val = 0;
+        std::memcpy(&val, p, sizeof(val));
+        return(val);
+    }
+
+    inline void writeLength(std::vector<unsigned char>& out, size_t length)
+    {
+        for (; length >= 255; length -= 255)out.push_back(255);
+        out.push_back(static_cast<unsigned char>(length));
+    }
+
+    //One sequence: token, literal length, literals, then the match unless this is the last sequence
+    inline void writeSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = (offset == 0) ? 0 : matchLength - FastMinMatch;
+        out.push_back(static_cast<unsigned char>(((literalCount < 15) ? literalCount : 15) << 4 | ((matchCode < 15) ? matchCode : 15)));
+        if (literalCount >= 15)writeLength(out, literalCount - 15);
+        out.insert(out.end(), literals, literals + literalCount);
+        if (offset == 0)return;
+        out.push_back(static_cast<unsigned char>(offset));
+        out.push_back(static_cast<unsigned char>(offset >> 8));
+        if (matchCode >= 15)writeLength(out, matchCode - 15);
+    }
+
+    inline void CompressFast(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+    {
+        out.clear();
+        out.reserve(size + size / 255 + 16);
+        size_t anchor = 0;
+        if (size > FastMatchLimit)
+        {
+            std::vector<boost::uint32_t> table(static_cast<size_t>(1) << FastHashBits, 0);
+            size_t matchEnd = size - FastLastLiterals;
+            size_t searchEnd = size - FastMatchLimit;
+            size_t pos = 0;
+            while (pos < searchEnd)
+            {
+                boost::uint32_t sequence = readUInt32(data + pos);
+                boost::uint32_t hash = (sequence * 2654435761u) >> (32 - FastHashBits);
+                size_t candidate = table[hash];
+                table[hash] = static_cast<boost::uint32_t>(pos);
+                if (candidate >= pos || pos - candidate > FastMaxOffset || readUInt32(data + candidate) != sequence)
+                {
+                    //Step faster through data that keeps missing, as LZ4 does
+                    pos += 1 + ((pos - anchor) >> 6);
+                    continue;
+                }
+                size_t length = FastMinMatch;
+                while (pos + length < matchEnd && data[candidate + length] == data[pos + length])++length;
+                writeSequence(out, data + anchor, pos - anchor, pos - candidate, length);
+                pos += length;
+                anchor = pos;
+            }
+        }
+        writeSequence(out, data + anchor, size - anchor, 0, 0);
+    }
+
+    inline bool readLength(const unsigned char* data, size_t size, size_t& pos, size_t& length)
+    {
+        unsigned char byte = 255;
+        while (byte == 255)
+        {
+            if (pos >= size)return(false);
+            byte = data[pos++];
+            length += byte;
+        }
+        return(true);
+    }
+
+    //Every read and write is bounds checked; damaged input fails instead of overrunning
+    inline bool DecompressFast(const unsigned char* data, size_t size, unsigned char* out, size_t rawSize)
+    {
+        size_t in = 0;
+        size_t produced = 0;
+        while (in < size)
+        {
+            unsigned char token = data[in++];
+            size_t literalCount = token >> 4;
+            if (literalCount == 15 && !readLength(data, size, in, literalCount))return(false);
+            if (literalCount > size - in || literalCount > rawSize - produced)return(false);
+            if (literalCount > 0)std::memcpy(out + produced, data + in, literalCount);
+            in += literalCount;
+            produced += literalCount;
+            if (in == size)break;
+
+            if (size - in < 2)return(false);
+            size_t offset = data[in] | (static_cast<size_t>(data[in + 1]) << 8);
+            in += 2;
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(data, size, in, matchLength))return(false);
+            matchLength += FastMinMatch;
+            if (offset == 0 || offset > produced || matchLength > rawSize - produced)return(false);
+            unsigned char* dest = out + produced;
+            const unsigned char* match = dest - offset;
+            //Overlapping matches repeat the last offset bytes, so they are copied forwards byte by byte
+            if (offset >= matchLength)std::memcpy(dest, match, matchLength);
+            else for (size_t i = 0; i < matchLength; ++i)dest[i] = match[i];
+            produced += matchLength;
+        }
+        return(produced == rawSize);
+    }
+
+    //False for an unknown codec; callers keep the raw bytes when the result is not smaller
+    inline bool Compress(Codec codec, const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+    {
+        if (codec == CODEC_FAST)
+        {
+            CompressFast(data, size, out);
+            return(true);
+        }
+        if (codec != CODEC_DEFLATE)return(false);
+        try
+        {
+            CryptoPP::Deflator deflator(nullptr, CryptoPP::Deflator::DEFAULT_DEFLATE_LEVEL);
+            deflator.Put(data, size);
+            deflator.MessageEnd();
+            out.resize(static_cast<size_t>(deflator.MaxRetrievable()));
+            if (!out.empty())deflator.Get(&out[0], out.size());
+        }
+        catch(CryptoPP::Exception& cEx)
+        {
+            return(false);
+        }
+        return(true);
+    }
+
+    inline bool Decompress(Codec codec, const unsigned char* data, size_t size, std::vector<unsigned char>& out, size_t rawSize)
+    {
+        out.resize(rawSize);
+        if (codec == CODEC_FAST)
+        {
+            return(DecompressFast(data, size, out.empty() ? nullptr : &out[0], rawSize));
+        }
+        if (codec != CODEC_DEFLATE)return(false);
+        try
+        {
+            CryptoPP::Inflator inflator;
+            inflator.Put(data, size);
+            inflator.MessageEnd();
+            if (inflator.MaxRetrievable() != rawSize)return(false);
+            if (rawSize > 0)inflator.Get(&out[0], rawSize);
+        }
+        catch(CryptoPP::Exception& cEx)
+        {
+            return(false);
+        }
+        return(true);
+    }
+}
+
+} //namespace rct
+
+#endif //DATA_STORE_COMPRESSION_H_
@@ -0,0 +1,164 @@
+#ifndef DATA_STORE_HEX_H_
+#define DATA_STORE_HEX_H_
+
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DATA_STORE_HEX_SSE2
+#endif
+
+namespace rct {
+
+//!  Data Store Hex
+/*!
+ * Hex codec for object columns in the text format.  Encoding writes two
+ * upper case digits per byte, as the CryptoPP encoder did, so files are
+ * unchanged; decoding accepts either case.  Both work on caller supplied
+ * buffers of any character type.  With SSE2 they handle 16 bytes per step
+ * and finish the tail with the scalar loop.
+ */
+namespace DataStoreHex
+{
+    static const char Digits[] = "0123456789ABCDEF";
+
+    //Digit value, or -1 for anything that is not a hex digit
+    template <typename CharT>
+    inline int DigitValue(CharT c)
+    {
+        if (c >= '0' && c <= '9')return(static_cast<int>(c - '0'));
+        if (c >= 'A' && c <= 'F')return(static_cast<int>(c - 'A' + 10));
+        if (c >= 'a' && c <= 'f')return(static_cast<int>(c - 'a' + 10));
+        return(-1);
+    }
+
+#ifdef DATA_STORE_HEX_SSE2
+    //32 digits for 16 bytes, high nibble first, as bytes
+    inline void encodeBlock(const unsigned char* data, __m128i& low, __m128i& high)
+    {
+        const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+        const __m128i nine = _mm_set1_epi8(9);
+        const __m128i zero = _mm_set1_epi8('0');
+        const __m128i letterGap = _mm_set1_epi8('A' - '0' - 10);
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+        __m128i lo = _mm_and_si128(bytes, nibbleMask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letterGap));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letterGap));
+        low = _mm_unpacklo_epi8(hi, lo);
+        high = _mm_unpackhi_epi8(hi, lo);
+    }
+
+    //Stores 16 ASCII bytes widened to the output character type
+    template <typename CharT>
+    inline void storeChars(const __m128i& chars, CharT* out)
+    {
+        if (sizeof(CharT) == 1)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+            return;
+        }
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo16 = _mm_unpacklo_epi8(chars, zero);
+        __m128i hi16 = _mm_unpackhi_epi8(chars, zero);
+        if (sizeof(CharT) == 2)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), lo16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), hi16);
+            return;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(lo16, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(lo16, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(hi16, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(hi16, zero));
+    }
+
+    //Loads 16 characters narrowed to bytes; characters above 0xFF become 0xFF, which is not a digit
+    template <typename CharT>
+    inline __m128i loadChars(const CharT* hex)
+    {
+        if (sizeof(CharT) == 1)return(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)));
+        if (sizeof(CharT) == 2)
+        {
+            return(_mm_packus_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 8))));
+        }
+        __m128i lo16 = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 4)));
+        __m128i hi16 = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 8)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 12)));
+        return(_mm_packus_epi16(lo16, hi16));
+    }
+
+    //Digit values of 16 characters; returns false if any of them is not a hex digit
+    inline bool digitValues(const __m128i& chars, __m128i& values)
+    {
+        const __m128i minusOne = _mm_set1_epi8(-1);
+        __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        //Signed compares: characters outside the ranges wrap below zero or land above the limit
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, minusOne), _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+        __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(letter, minusOne), _mm_cmplt_epi8(letter, _mm_set1_epi8(6)));
+        if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF)return(false);
+        values = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+        return(true);
+    }
+
+    //Joins digit pairs of 16 values into 8 bytes, in the low half of each 16 bit lane
+    inline __m128i joinDigits(const __m128i& values)
+    {
+        __m128i hi = _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4);
+        return(_mm_or_si128(hi, _mm_srli_epi16(values, 8)));
+    }
+#endif
+
+    //Writes 2 * size characters to out
+    template <typename CharT>
+    inline void Encode(const unsigned char* data, size_t size, CharT* out)
+    {
+        size_t i = 0;
+#ifdef DATA_STORE_HEX_SSE2
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i low;
+            __m128i high;
+            encodeBlock(data + i, low, high);
+            storeChars(low, out + i * 2);
+            storeChars(high, out + i * 2 + 16);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            out[i * 2] = static_cast<CharT>(Digits[data[i] >> 4]);
+            out[i * 2 + 1] = static_cast<CharT>(Digits[data[i] & 0x0F]);
+        }
+    }
+
+    //Reads 2 * size characters into size bytes; false if any character is not a hex digit
+    template <typename CharT>
+    inline bool Decode(const CharT* hex, size_t size, unsigned char* out)
+    {
+        size_t i = 0;
+#ifdef DATA_STORE_HEX_SSE2
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i lowValues;
+            __m128i highValues;
+            if (!digitValues(loadChars(hex + i * 2), lowValues) || !digitValues(loadChars(hex + i * 2 + 16), highValues))return(false);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(joinDigits(lowValues), joinDigits(highValues)));
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            int hi = DigitValue(hex[i * 2]);
+            int lo = DigitValue(hex[i * 2 + 1]);
+            if (hi < 0 || lo < 0)return(false);
+            out[i] = static_cast<unsigned char>((hi << 4) | lo);
+        }
+        return(true);
+    }
+}
+
+} //namespace rct
+
+#endif //DATA_STORE_HEX_H_
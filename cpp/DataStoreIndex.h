@@ -0,0 +1,219 @@
+#ifndef DATA_STORE_INDEX_H_
+#define DATA_STORE_INDEX_H_
+
+#include "DataStoreSchema.h"
+#include <set>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+
+namespace rct {
+
+//!  Data Store Index
+/*!
+ * Secondary index over the values of one data store column, mapping a
+ * value to the row ids holding it.  A hash index answers equality lookups;
+ * an ordered index also answers inclusive range lookups.  Keys are
+ * strings or typed values and only compare equal to keys of the same
+ * type; ordered indexes sort by type first, then by value.  Object
+ * columns are not indexed.  A hash index keeps the rows of a key in a
+ * vector and the slot of every row in it, so a row leaves its key in
+ * constant time however many rows share the key; the rows of a key come
+ * back in no particular order.
+ */
+class DataStoreIndex
+{
+public:
+    //Same as DataStore::IndexType
+    typedef unsigned long RowId;
+
+    typedef enum IndexKind
+    {
+        INDEX_HASH,
+        INDEX_ORDERED
+    };
+
+    //! Indexed value - a string or the bit pattern of a typed value
+    class Key
+    {
+    private:
+        DataStoreValueType type_;
+        boost::uint64_t bits_;
+        std::wstring text_;
+    public:
+        Key() : type_(DATASTORE_VALUE_NONE), bits_(0) {}
+        explicit Key(const std::wstring& text) : type_(DATASTORE_VALUE_STRING), bits_(0), text_(text) {}
+        Key(DataStoreValueType type, boost::uint64_t bits) : type_(type), bits_(bits) {}
+
+        static Key Int64(boost::int64_t val) { return(Key(DATASTORE_VALUE_INT64, static_cast<boost::uint64_t>(val))); }
+        static Key Bool(bool val) { return(Key(DATASTORE_VALUE_BOOL, val ? 1 : 0)); }
+        static Key Timestamp(boost::int64_t val) { return(Key(DATASTORE_VALUE_TIMESTAMP, static_cast<boost::uint64_t>(val))); }
+        static Key Double(double val)
+        {
+            boost::uint64_t bits = 0;
+            std::memcpy(&bits, &val, sizeof(bits));
+            return(Key(DATASTORE_VALUE_DOUBLE, bits));
+        }
+
+        DataStoreValueType GetType() const { return(type_); }
+        boost::uint64_t GetBits() const { return(bits_); }
+        const std::wstring& GetText() const { return(text_); }
+
+        bool operator==(const Key& rhs) const
+        {
+            return(type_ == rhs.type_ && bits_ == rhs.bits_ && text_ == rhs.text_);
+        }
+
+        bool operator<(const Key& rhs) const
+        {
+            if (type_ != rhs.type_)return(type_ < rhs.type_);
+            switch (type_)
+            {
+            case DATASTORE_VALUE_STRING:
+                return(text_ < rhs.text_);
+            case DATASTORE_VALUE_INT64:
+            case DATASTORE_VALUE_TIMESTAMP:
+                return(static_cast<boost::int64_t>(bits_) < static_cast<boost::int64_t>(rhs.bits_));
+            case DATASTORE_VALUE_DOUBLE:
+            {
+                double lhsVal = 0;
+                double rhsVal = 0;
+                std::memcpy(&lhsVal, &bits_, sizeof(lhsVal));
+                std::memcpy(&rhsVal, &rhs.bits_, sizeof(rhsVal));
+                //NaNs sort after every number so the order stays strict
+                bool lhsNan = (lhsVal != lhsVal);
+                bool rhsNan = (rhsVal != rhsVal);
+                if (lhsNan || rhsNan)return(lhsNan ? (rhsNan && bits_ < rhs.bits_) : true);
+                return(lhsVal < rhsVal);
+            }
+            default:
+                return(bits_ < rhs.bits_);
+            }
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            size_t seed = static_cast<size_t>(key.GetType());
+            if (key.GetType() == DATASTORE_VALUE_STRING)boost::hash_combine(seed, key.GetText());
+            else boost::hash_combine(seed, key.GetBits());
+            return(seed);
+        }
+    };
+private:
+    typedef std::unordered_map<Key, std::vector<RowId>, KeyHash> HashMap;
+    //A row holds one value of the column, so it is in one key's rows
+    typedef std::unordered_map<RowId, size_t> SlotMap;
+    typedef std::set<std::pair<Key, RowId>> OrderedSet;
+private:
+    IndexKind kind_;
+    HashMap hashed_;
+    SlotMap slots_;
+    OrderedSet ordered_;
+private:
+    DataStoreIndex(const DataStoreIndex& rhs);
+    void operator=(const DataStoreIndex& rhs);
+
+    void insertHashed(const Key& key, RowId row)
+    {
+        std::vector<RowId>& rows = hashed_[key];
+        slots_[row] = rows.size();
+        rows.push_back(row);
+    }
+public:
+    explicit DataStoreIndex(IndexKind kind) : kind_(kind) {}
+
+    IndexKind GetKind() const
+    {
+        return(kind_);
+    }
+
+    void Clear()
+    {
+        hashed_.clear();
+        slots_.clear();
+        ordered_.clear();
+    }
+
+    void Insert(const Key& key, RowId row)
+    {
+        if (kind_ == INDEX_HASH)insertHashed(key, row);
+        else ordered_.insert(std::make_pair(key, row));
+    }
+
+    //Inserts many entries at once, consuming them.  Ordered indexes sort them first and insert each
+    //next to the one before, which costs constant time per entry when the batch lands after the existing keys
+    void InsertBatch(std::vector<std::pair<Key, RowId>>& entries)
+    {
+        if (kind_ == INDEX_HASH)
+        {
+            slots_.reserve(slots_.size() + entries.size());
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                insertHashed(entries[i].first, entries[i].second);
+            }
+            return;
+        }
+        if (!std::is_sorted(entries.begin(), entries.end()))std::sort(entries.begin(), entries.end());
+        OrderedSet::iterator hint = ordered_.end();
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            hint = ordered_.insert(hint, std::move(entries[i]));
+            ++hint;
+        }
+    }
+
+    void Remove(const Key& key, RowId row)
+    {
+        if (kind_ == INDEX_ORDERED)
+        {
+            ordered_.erase(std::make_pair(key, row));
+            return;
+        }
+        HashMap::iterator hFind = hashed_.find(key);
+        SlotMap::iterator sFind = slots_.find(row);
+        if (hFind == hashed_.end() || sFind == slots_.end())return;
+        std::vector<RowId>& rows = hFind->second;
+        size_t slot = sFind->second;
+        if (slot >= rows.size() || rows[slot] != row)return;
+        //The last row of the key moves into the freed slot
+        rows[slot] = rows.back();
+        slots_[rows[slot]] = slot;
+        rows.pop_back();
+        slots_.erase(sFind);
+        if (rows.empty())hashed_.erase(hFind);
+    }
+
+    //Appends the rows holding the key; returns the number appended
+    size_t Find(const Key& key, std::vector<RowId>& rows) const
+    {
+        if (kind_ == INDEX_ORDERED)return(FindRange(key, key, rows));
+        HashMap::const_iterator hFind = hashed_.find(key);
+        if (hFind == hashed_.end())return(0);
+        rows.insert(rows.end(), hFind->second.begin(), hFind->second.end());
+        return(hFind->second.size());
+    }
+
+    //Rows with low <= key <= high in key order; ordered indexes only
+    size_t FindRange(const Key& low, const Key& high, std::vector<RowId>& rows) const
+    {
+        if (kind_ != INDEX_ORDERED)return(0);
+        size_t matches = 0;
+        OrderedSet::const_iterator oIter = ordered_.lower_bound(std::make_pair(low, static_cast<RowId>(0)));
+        for (; oIter != ordered_.end() && !(high < oIter->first); ++oIter)
+        {
+            rows.push_back(oIter->second);
+            ++matches;
+        }
+        return(matches);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_INDEX_H_
@@ -0,0 +1,174 @@
+#ifndef DATA_STORE_LAZY_FILE_H_
+#define DATA_STORE_LAZY_FILE_H_
+
+#include "UTF8String.h"
+#include "DataStoreMappedFile.h"
+#include <string>
+#include <vector>
+#include <cstring>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace rct {
+
+//!  Data Store Lazy File
+/*!
+ * Record source behind DataStore's lazy load mode.  Opening only finds
+ * where each record lives; the store parses a record the first time it is
+ * asked for.  Binary files are opened as a DataStoreMappedFile, so a
+ * record is a row across the column blocks.  Text files are mapped and
+ * scanned once for record header lines, the only lines that start with a
+ * digit, and a record is the UTF-8 text up to the next one.
+ */
+class DataStoreLazyFile
+{
+private:
+    DataStoreLazyFile(const DataStoreLazyFile& rhs);
+    void operator=(const DataStoreLazyFile& rhs);
+private:
+    DataStoreMappedFile binaryFile_;
+    boost::interprocess::file_mapping mapping_;
+    boost::interprocess::mapped_region region_;
+    //Start of every text record; the last one runs to the next record or the end of the file
+    std::vector<size_t> offsets_;
+    size_t textEnd_;
+    bool binary_;
+    bool open_;
+private:
+    bool indexText(unsigned long recordCount)
+    {
+        if (recordCount == 0)return(true);
+        const char* data = static_cast<const char*>(region_.get_address());
+        size_t size = region_.get_size();
+        const char* lineEnd = static_cast<const char*>(std::memchr(data, '\n', size));
+        if (lineEnd == nullptr)return(false);
+        size_t pos = (lineEnd - data) + 1;
+        while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n'))++pos;
+        if (pos >= size)return(false);
+        offsets_.reserve(recordCount);
+        offsets_.push_back(pos);
+        textEnd_ = size;
+        while (offsets_.size() <= recordCount)
+        {
+            lineEnd = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+            if (lineEnd == nullptr)break;
+            pos = (lineEnd - data) + 1;
+            if (pos < size && data[pos] >= '0' && data[pos] <= '9')offsets_.push_back(pos);
+        }
+        //Text after the last counted record is ignored, as by a full load
+        if (offsets_.size() > recordCount)
+        {
+            textEnd_ = offsets_.back();
+            offsets_.pop_back();
+        }
+        return(offsets_.size() == recordCount);
+    }
+
+    bool openText(const rct::UTF8String& fileName)
+    {
+        try
+        {
+            boost::interprocess::file_mapping mapping(fileName.nstr().c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+            mapping_.swap(mapping);
+            region_.swap(region);
+        }
+        catch(boost::interprocess::interprocess_exception& ipEx)
+        {
+            return(false);
+        }
+        //Record count on the first line
+        const char* data = static_cast<const char*>(region_.get_address());
+        size_t size = region_.get_size();
+        unsigned long recordCount = 0;
+        size_t i = 0;
+        for (; i < size && data[i] >= '0' && data[i] <= '9'; ++i)
+        {
+            recordCount = recordCount * 10 + (data[i] - '0');
+        }
+        if (i == 0)return(false);
+        return(indexText(recordCount));
+    }
+public:
+    DataStoreLazyFile() : textEnd_(0), binary_(false), open_(false) {}
+
+    bool Open(const rct::UTF8String& fileName, bool binary)
+    {
+        Close();
+        binary_ = binary;
+        open_ = binary ? binaryFile_.Open(fileName, true) : openText(fileName);
+        if (!open_)Close();
+        return(open_);
+    }
+
+    void Close()
+    {
+        boost::interprocess::mapped_region emptyRegion;
+        boost::interprocess::file_mapping emptyMapping;
+        region_.swap(emptyRegion);
+        mapping_.swap(emptyMapping);
+        binaryFile_.Close();
+        offsets_.clear();
+        textEnd_ = 0;
+        binary_ = false;
+        open_ = false;
+    }
+
+    bool IsOpen() const
+    {
+        return(open_);
+    }
+
+    bool IsBinary() const
+    {
+        return(binary_);
+    }
+
+    boost::uint64_t GetNumberRecords() const
+    {
+        return(binary_ ? binaryFile_.GetNumberRecords() : offsets_.size());
+    }
+
+    //Column blocks of a binary file; rows are record positions
+    const DataStoreMappedFile& GetBinaryFile() const
+    {
+        return(binaryFile_);
+    }
+
+    //Decodes the text of one record of a text file, ready for DataStoreRecord::InputFromStream
+    bool GetRecordText(boost::uint64_t row, std::wstring& text) const
+    {
+        if (binary_ || row >= offsets_.size())return(false);
+        const char* data = static_cast<const char*>(region_.get_address());
+        size_t start = offsets_[static_cast<size_t>(row)];
+        size_t end = (row + 1 < offsets_.size()) ? offsets_[static_cast<size_t>(row) + 1] : textEnd_;
+        text = rct::UTF8String(std::string(data + start, end - start)).str();
+        return(true);
+    }
+
+    //Id of one record without decoding the rest of it; a text record starts with its id
+    bool GetRecordId(boost::uint64_t row, boost::uint64_t& id) const
+    {
+        if (binary_)
+        {
+            if (row >= binaryFile_.GetNumberRecords())return(false);
+            id = binaryFile_.GetRecordId(row);
+            return(true);
+        }
+        if (row >= offsets_.size())return(false);
+        const char* data = static_cast<const char*>(region_.get_address());
+        size_t start = offsets_[static_cast<size_t>(row)];
+        size_t end = (row + 1 < offsets_.size()) ? offsets_[static_cast<size_t>(row) + 1] : textEnd_;
+        size_t i = start;
+        id = 0;
+        for (; i < end && data[i] >= '0' && data[i] <= '9'; ++i)
+        {
+            id = id * 10 + (data[i] - '0');
+        }
+        return(i > start);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_LAZY_FILE_H_
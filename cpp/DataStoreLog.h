@@ -0,0 +1,382 @@
+#ifndef DATA_STORE_LOG_H_
+#define DATA_STORE_LOG_H_
+
+#include "DataStoreBinaryFormat.h"
+#include "DataStoreSchema.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <fcntl.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace rct {
+
+static const unsigned char DataStoreLogMagic[4] = { 'R', 'D', 'S', 'L' };
+
+//!  Data Store Log
+/*!
+ * Append only write ahead log of data store mutations.  A log belongs to
+ * the snapshot generation stored in its header; DataStore replays it on
+ * top of that snapshot and compaction starts a fresh log for the next one.
+ *
+ * Layout:
+ *   Header   - magic "RDSL", uint16 version, uint16 reserved, uint32 generation, uint32 CRC
+ *   Entries  - [uint32 payload size, uint32 payload CRC, payload] back to back
+ *
+ * Every payload starts with a uint8 entry type.  Column ids are the
+ * writer's schema ids and are bound to a name by a LOG_DEFINE_COLUMN entry
+ * before their first use, so replay needs no other dictionary.  A torn or
+ * damaged entry ends the log; everything before it is still replayed.
+ */
+class DataStoreLog
+{
+public:
+    static const boost::uint16_t Version = 2;
+    static const size_t HeaderSize = 16;
+    static const size_t EntryHeaderSize = 8;
+
+    typedef enum EntryType
+    {
+        LOG_DEFINE_COLUMN = 1,  //uint32 column id, string name
+        LOG_ADD_RECORD    = 2,  //uint64 row, uint64 record id, uint32 count, count x value
+        LOG_SET_COLUMN    = 3   //uint64 row, value
+    };
+
+    //Values are [uint32 column id, uint8 DataStoreValueType, uint32 size, bytes] with the
+    //bytes encoded as in the binary format: UTF-8, raw object bytes or a fixed width value
+
+    //! Sequential reader over a log image held in memory
+    class Reader
+    {
+    private:
+        const unsigned char* data_;
+        size_t size_;
+        size_t pos_;
+    public:
+        Reader(const unsigned char* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+        bool ReadHeader(boost::uint32_t& generation)
+        {
+            DataStoreBinaryFormat::BinaryReader reader(data_, size_);
+            const unsigned char* magic = nullptr;
+            boost::uint16_t version = 0;
+            boost::uint16_t reserved = 0;
+            boost::uint32_t crc = 0;
+            if (!reader.ReadBytes(sizeof(DataStoreLogMagic), magic) || std::memcmp(magic, DataStoreLogMagic, sizeof(DataStoreLogMagic)) != 0)return(false);
+            if (!reader.ReadUInt16(version) || !reader.ReadUInt16(reserved) || !reader.ReadUInt32(generation))return(false);
+            if (!reader.ReadUInt32(crc) || crc != DataStoreBinaryFormat::ComputeCRC(data_, HeaderSize - 4))return(false);
+            if (version > Version)return(false);
+            pos_ = HeaderSize;
+            return(true);
+        }
+
+        //False at the end of the log or at the first torn or damaged entry
+        bool Next(const unsigned char*& payload, size_t& size)
+        {
+            DataStoreBinaryFormat::BinaryReader reader(data_ + pos_, size_ - pos_);
+            boost::uint32_t payloadSize = 0;
+            boost::uint32_t crc = 0;
+            if (!reader.ReadUInt32(payloadSize) || !reader.ReadUInt32(crc))return(false);
+            if (payloadSize == 0 || !reader.ReadBytes(payloadSize, payload))return(false);
+            if (crc != DataStoreBinaryFormat::ComputeCRC(payload, payloadSize))return(false);
+            size = payloadSize;
+            pos_ += EntryHeaderSize + payloadSize;
+            return(true);
+        }
+
+        //End of the last good entry - anything past it is discarded when the log is resumed
+        size_t GetPosition() const
+        {
+            return(pos_);
+        }
+    };
+private:
+    FILE* file_;
+    std::vector<bool> definedColumns_;
+    DataStoreBinaryFormat::BinaryWriter entry_;
+    boost::uint32_t generation_;
+    bool syncEachEntry_;
+    //Between BeginBatch and EndBatch entries are buffered and synced together
+    bool batching_;
+    //End of the last entry written, and where the current batch started; a failed write cuts the file back
+    size_t size_;
+    size_t batchStart_;
+private:
+    DataStoreLog(const DataStoreLog& rhs);
+    void operator=(const DataStoreLog& rhs);
+
+    bool writeBytes(const unsigned char* data, size_t size)
+    {
+        if (size == 0)return(true);
+        return(std::fwrite(data, 1, size, file_) == size);
+    }
+
+    //Frames the pending entry and hands it to the OS
+    bool appendEntry()
+    {
+        if (file_ == nullptr)
+        {
+            entry_.Clear();
+            return(false);
+        }
+        DataStoreBinaryFormat::BinaryWriter frame;
+        frame.WriteUInt32(static_cast<boost::uint32_t>(entry_.GetSize()));
+        frame.WriteUInt32(DataStoreBinaryFormat::ComputeCRC(entry_.GetData(), entry_.GetSize()));
+        bool rt = writeBytes(frame.GetData(), frame.GetSize()) && writeBytes(entry_.GetData(), entry_.GetSize());
+        size_t entrySize = frame.GetSize() + entry_.GetSize();
+        entry_.Clear();
+        if (!batching_)
+        {
+            rt = rt && std::fflush(file_) == 0;
+            if (rt && syncEachEntry_)rt = Sync();
+        }
+        if (!rt)return(cutBack(size_));
+        size_ += entrySize;
+        return(true);
+    }
+
+    //Drops whatever was written past size so the next entry follows a whole one; replay stops at the
+    //first damaged entry and would lose every entry after it.  Closes the log if the cut fails, so
+    //later appends fail instead of landing behind the damage.  Always false, for the failed append
+    bool cutBack(size_t size)
+    {
+        std::clearerr(file_);
+        if (std::fseek(file_, static_cast<long>(size), SEEK_SET) != 0 || !truncateFile(size))
+        {
+            Close();
+            return(false);
+        }
+        size_ = size;
+        return(false);
+    }
+
+    bool truncateFile(size_t size)
+    {
+#ifdef WIN32
+        return(_chsize_s(_fileno(file_), static_cast<__int64>(size)) == 0);
+#else
+        return(ftruncate(fileno(file_), static_cast<off_t>(size)) == 0);
+#endif
+    }
+
+    void writeValue(boost::uint32_t columnId, DataStoreValueType kind, const void* data, size_t size)
+    {
+        entry_.WriteUInt32(columnId);
+        entry_.WriteUInt8(static_cast<boost::uint8_t>(kind));
+        entry_.WriteUInt32(static_cast<boost::uint32_t>(size));
+        entry_.WriteBytes(data, size);
+    }
+public:
+    DataStoreLog() : file_(nullptr), generation_(0), syncEachEntry_(false), batching_(false), size_(0), batchStart_(0) {}
+
+    ~DataStoreLog()
+    {
+        Close();
+    }
+
+    //Starts an empty log for the given snapshot generation, replacing any existing file
+    bool Create(const std::string& fileName, boost::uint32_t generation, bool syncEachEntry)
+    {
+        Close();
+        file_ = std::fopen(fileName.c_str(), "wb");
+        if (file_ == nullptr)return(false);
+        generation_ = generation;
+        syncEachEntry_ = syncEachEntry;
+        DataStoreBinaryFormat::BinaryWriter header;
+        header.WriteBytes(DataStoreLogMagic, sizeof(DataStoreLogMagic));
+        header.WriteUInt16(Version);
+        header.WriteUInt16(0);
+        header.WriteUInt32(generation);
+        header.WriteUInt32(DataStoreBinaryFormat::ComputeCRC(header.GetData(), header.GetSize()));
+        if (!writeBytes(header.GetData(), header.GetSize()) || std::fflush(file_) != 0 || !Sync())
+        {
+            Close();
+            return(false);
+        }
+        size_ = header.GetSize();
+        return(true);
+    }
+
+    //Keeps appending to a log that was replayed; a torn tail past validSize is cut off first
+    bool Resume(const std::string& fileName, const std::vector<unsigned char>& data, size_t validSize, bool syncEachEntry)
+    {
+        Close();
+        Reader reader(data.empty() ? nullptr : &data[0], data.size());
+        boost::uint32_t generation = 0;
+        if (validSize < HeaderSize || validSize > data.size() || !reader.ReadHeader(generation))return(false);
+        //Cut in place so the committed entries are never rewritten; appends go to the new end
+        file_ = std::fopen(fileName.c_str(), "ab");
+        if (file_ == nullptr)return(false);
+        if (validSize < data.size() && (!truncateFile(validSize) || !Sync()))
+        {
+            Close();
+            return(false);
+        }
+        generation_ = generation;
+        syncEachEntry_ = syncEachEntry;
+        size_ = validSize;
+        return(true);
+    }
+
+    void Close()
+    {
+        if (file_ != nullptr)
+        {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+        definedColumns_.clear();
+        entry_.Clear();
+    }
+
+    bool IsOpen() const
+    {
+        return(file_ != nullptr);
+    }
+
+    boost::uint32_t GetGeneration() const
+    {
+        return(generation_);
+    }
+
+    //Forces appended entries to stable storage
+    bool Sync()
+    {
+        if (file_ == nullptr)return(false);
+        if (std::fflush(file_) != 0)return(false);
+#ifdef WIN32
+        return(_commit(_fileno(file_)) == 0);
+#else
+        return(fsync(fileno(file_)) == 0);
+#endif
+    }
+
+    bool IsColumnDefined(boost::uint32_t columnId) const
+    {
+        return(columnId < definedColumns_.size() && definedColumns_[columnId]);
+    }
+
+    bool DefineColumn(boost::uint32_t columnId, const std::string& utf8Name)
+    {
+        entry_.WriteUInt8(LOG_DEFINE_COLUMN);
+        entry_.WriteUInt32(columnId);
+        entry_.WriteString(utf8Name);
+        if (!appendEntry())return(false);
+        if (columnId >= definedColumns_.size())definedColumns_.resize(columnId + 1, false);
+        definedColumns_[columnId] = true;
+        return(true);
+    }
+
+    //A record entry is built with BeginRecord, one AddValue per column and EndRecord, and written as one entry
+    void BeginRecord(boost::uint64_t row, boost::uint64_t id, boost::uint32_t valueCount)
+    {
+        entry_.Clear();
+        entry_.WriteUInt8(LOG_ADD_RECORD);
+        entry_.WriteUInt64(row);
+        entry_.WriteUInt64(id);
+        entry_.WriteUInt32(valueCount);
+    }
+
+    void AddValue(boost::uint32_t columnId, DataStoreValueType kind, const void* data, size_t size)
+    {
+        writeValue(columnId, kind, data, size);
+    }
+
+    bool EndRecord()
+    {
+        return(appendEntry());
+    }
+
+    bool SetColumn(boost::uint64_t row, boost::uint32_t columnId, DataStoreValueType kind, const void* data, size_t size)
+    {
+        entry_.Clear();
+        entry_.WriteUInt8(LOG_SET_COLUMN);
+        entry_.WriteUInt64(row);
+        writeValue(columnId, kind, data, size);
+        return(appendEntry());
+    }
+
+    //Entries appended until EndBatch reach the OS, and the disk when syncing each entry, together
+    void BeginBatch()
+    {
+        batching_ = true;
+        batchStart_ = size_;
+    }
+
+    bool EndBatch()
+    {
+        batching_ = false;
+        if (file_ == nullptr)return(false);
+        //The whole batch is unacknowledged until here, so a failed flush drops all of it
+        if (std::fflush(file_) != 0 || (syncEachEntry_ && !Sync()))return(cutBack(batchStart_));
+        return(true);
+    }
+
+    //Forces a file written through another handle to stable storage
+    static bool SyncFile(const std::string& fileName)
+    {
+#ifdef WIN32
+        int fd = _open(fileName.c_str(), _O_RDWR | _O_BINARY);
+        if (fd < 0)return(false);
+        bool rt = (_commit(fd) == 0);
+        _close(fd);
+#else
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)return(false);
+        bool rt = (fsync(fd) == 0);
+        close(fd);
+#endif
+        return(rt);
+    }
+
+    //Makes a rename or a newly created file in the file's directory durable; MoveFileEx
+    //with MOVEFILE_WRITE_THROUGH already does this on Windows
+    static bool SyncDirectory(const std::string& fileName)
+    {
+#ifdef WIN32
+        return(true);
+#else
+        std::string::size_type slash = fileName.find_last_of('/');
+        std::string dirName = (slash == std::string::npos) ? std::string(".") : (slash == 0 ? std::string("/") : fileName.substr(0, slash));
+        int fd = open(dirName.c_str(), O_RDONLY);
+        if (fd < 0)return(false);
+        bool rt = (fsync(fd) == 0);
+        close(fd);
+        return(rt);
+#endif
+    }
+
+    //Moves a finished snapshot over the previous one in a single step.  The new file's data reaches
+    //the disk before the rename and the rename before this returns, so after a crash the name holds
+    //either the old or the whole new file
+    static bool SwapInFile(const std::string& fromName, const std::string& toName)
+    {
+        if (!SyncFile(fromName))return(false);
+#ifdef WIN32
+        return(MoveFileExA(fromName.c_str(), toName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0);
+#else
+        return(std::rename(fromName.c_str(), toName.c_str()) == 0 && SyncDirectory(toName));
+#endif
+    }
+
+    //Decodes one [column id, kind, size, bytes] value from an entry payload
+    static bool ReadValue(DataStoreBinaryFormat::BinaryReader& reader, boost::uint32_t& columnId, DataStoreValueType& kind, const unsigned char*& data, size_t& size)
+    {
+        const unsigned char* kindByte = nullptr;
+        boost::uint32_t valueSize = 0;
+        if (!reader.ReadUInt32(columnId) || !reader.ReadBytes(1, kindByte) || !reader.ReadUInt32(valueSize))return(false);
+        if (*kindByte < DATASTORE_VALUE_STRING || *kindByte > DATASTORE_VALUE_TIMESTAMP)return(false);
+        kind = static_cast<DataStoreValueType>(*kindByte);
+        size = valueSize;
+        return(reader.ReadBytes(size, data));
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_LOG_H_
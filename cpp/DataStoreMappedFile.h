@@ -0,0 +1,328 @@
+#ifndef DATA_STORE_MAPPED_FILE_H_
+#define DATA_STORE_MAPPED_FILE_H_
+
+#include "UTF8String.h"
+#include "DataStoreBinaryFormat.h"
+#include <map>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace rct {
+
+//!  Data Store Mapped File
+/*!
+ * Read only view of a binary data store file (see DataStoreBinaryFormat.h)
+ * mapped into the address space.  Opening only walks the header, the column
+ * dictionary and the block headers; values are served as pointers into the
+ * mapped pages, so processes mapping the same file share one page cache copy.
+ * Compressed blocks are the exception: they are decompressed into memory
+ * owned by this instance when the file is opened.
+ */
+class DataStoreMappedFile
+{
+public:
+    typedef std::wstring DataStr;
+
+    //! Value returned by a lookup - points into the mapping, valid while the file is open
+    class MappedValue
+    {
+    private:
+        const unsigned char* data_;
+        size_t size_;
+        DataStoreValueType type_;
+    private:
+        boost::uint64_t fixedValue() const
+        {
+            if (DataStoreValueWidth(type_) == 0 || size_ != DataStoreValueWidth(type_))return(0);
+            return(DataStoreBinaryFormat::DecodeFixed(data_, size_));
+        }
+    public:
+        MappedValue() : data_(nullptr), size_(0), type_(DATASTORE_VALUE_NONE) {}
+        MappedValue(const unsigned char* data, size_t size, DataStoreValueType type) : data_(data), size_(size), type_(type) {}
+
+        DataStoreValueType GetType() const { return(type_); }
+        bool IsObject() const { return(type_ == DATASTORE_VALUE_BYTES); }
+        //Raw encoding: UTF-8, object bytes or a little endian fixed width value
+        const unsigned char* GetData() const { return(data_); }
+        size_t GetSize() const { return(size_); }
+
+        //Property values are stored as UTF-8; this is the only call that copies
+        DataStr ToString() const
+        {
+            if (type_ != DATASTORE_VALUE_STRING || data_ == nullptr)return(DataStr());
+            return(rct::UTF8String(std::string(reinterpret_cast<const char*>(data_), size_)).str());
+        }
+
+        boost::int64_t GetInt64() const { return(static_cast<boost::int64_t>(fixedValue())); }
+        double GetDouble() const { return(DataStoreBinaryFormat::BitsToDouble(fixedValue())); }
+        bool GetBool() const { return(fixedValue() != 0); }
+        boost::int64_t GetTimestamp() const { return(static_cast<boost::int64_t>(fixedValue())); }
+    };
+
+    //! Lightweight handle to one row of the mapped file
+    class MappedRecord
+    {
+    private:
+        const DataStoreMappedFile* file_;
+        boost::uint64_t row_;
+    public:
+        MappedRecord() : file_(nullptr), row_(0) {}
+        MappedRecord(const DataStoreMappedFile* file, boost::uint64_t row) : file_(file), row_(row) {}
+
+        bool IsValid() const
+        {
+            return(file_ != nullptr && row_ < file_->GetNumberRecords());
+        }
+
+        boost::uint64_t GetId() const
+        {
+            return(IsValid() ? file_->GetRecordId(row_) : 0);
+        }
+
+        bool GetColumn(const DataStr& name, MappedValue& value) const
+        {
+            if (!IsValid())return(false);
+            return(file_->GetColumn(row_, name, value));
+        }
+    };
+private:
+    struct ColumnBlocks
+    {
+        DataStr name_;
+        DataStoreBinaryFormat::ColumnBlockView properties_;
+        DataStoreBinaryFormat::ColumnBlockView objects_;
+        //One view per value type the column holds in some row
+        std::vector<std::pair<DataStoreValueType, DataStoreBinaryFormat::FixedColumnBlockView>> typed_;
+        bool hasProperties_;
+        bool hasObjects_;
+        ColumnBlocks() : hasProperties_(false), hasObjects_(false) {}
+    };
+private:
+    //Not copyable - the views point into the mapping owned by this instance
+    DataStoreMappedFile(const DataStoreMappedFile& rhs);
+    void operator=(const DataStoreMappedFile& rhs);
+private:
+    boost::interprocess::file_mapping mapping_;
+    boost::interprocess::mapped_region region_;
+    std::vector<ColumnBlocks> columns_;
+    std::map<DataStr, size_t> columnIdx_;
+    //Decompressed payloads of compressed blocks, by block position; sized once so views stay valid
+    std::vector<std::vector<unsigned char>> inflated_;
+    const unsigned char* recordIds_;
+    boost::uint64_t recordCount_;
+    boost::uint32_t generation_;
+    bool open_;
+private:
+    bool parse(bool verifyBlocks)
+    {
+        const unsigned char* base = static_cast<const unsigned char*>(region_.get_address());
+        DataStoreBinaryFormat::BinaryReader reader(base, region_.get_size());
+        DataStoreBinaryFormat::FileHeader header;
+        if (!DataStoreBinaryFormat::ReadFileHeader(reader, header))return(false);
+
+        columns_.resize(header.columnCount_);
+        const unsigned char* dictStart = reader.GetCurrent();
+        for (boost::uint32_t i = 0; i < header.columnCount_; ++i)
+        {
+            std::string name;
+            if (!reader.ReadString(name))return(false);
+            columns_[i].name_ = rct::UTF8String(name).str();
+            columnIdx_[columns_[i].name_] = i;
+        }
+        size_t dictSize = reader.GetCurrent() - dictStart;
+        boost::uint32_t dictCrc = 0;
+        if (!reader.ReadUInt32(dictCrc) || dictCrc != DataStoreBinaryFormat::ComputeCRC(dictStart, dictSize))return(false);
+        if (!reader.Align())return(false);
+
+        std::vector<DataStoreBinaryFormat::BlockRef> blockRefs;
+        if (!DataStoreBinaryFormat::LocateBlocks(base, region_.get_size(), reader.GetPosition(), header, blockRefs))return(false);
+        inflated_.resize(blockRefs.size());
+        for (size_t b = 0; b < blockRefs.size(); ++b)
+        {
+            //Checking every payload touches every page, so it is opt in
+            if (blockRefs[b].header_.rowCount_ != header.recordCount_ || !DataStoreBinaryFormat::InflateBlock(blockRefs[b], inflated_[b], verifyBlocks))
+            {
+                return(false);
+            }
+            const DataStoreBinaryFormat::BlockHeader& blockHeader = blockRefs[b].header_;
+            const unsigned char* payload = blockRefs[b].payload_;
+            if (blockHeader.blockType_ == DataStoreBinaryFormat::BLOCK_RECORD_IDS)
+            {
+                if (blockHeader.payloadSize_ % 8 != 0 || blockHeader.rowCount_ != blockHeader.payloadSize_ / 8)return(false);
+                recordIds_ = payload;
+                continue;
+            }
+            if (blockHeader.columnIdx_ >= columns_.size())return(false);
+            ColumnBlocks& blocks = columns_[blockHeader.columnIdx_];
+            DataStoreValueType valueType = DataStoreBinaryFormat::ValueTypeFor(blockHeader.blockType_);
+            if (valueType == DATASTORE_VALUE_BYTES)
+            {
+                if (!blocks.objects_.Init(blockHeader, payload))return(false);
+                blocks.hasObjects_ = true;
+            }
+            else if (valueType == DATASTORE_VALUE_STRING)
+            {
+                if (!blocks.properties_.Init(blockHeader, payload))return(false);
+                blocks.hasProperties_ = true;
+            }
+            else
+            {
+                DataStoreBinaryFormat::FixedColumnBlockView view;
+                if (valueType == DATASTORE_VALUE_NONE || !view.Init(blockHeader, payload) || blockHeader.offsetWidth_ != DataStoreValueWidth(valueType))return(false);
+                blocks.typed_.push_back(std::make_pair(valueType, view));
+            }
+        }
+        recordCount_ = header.recordCount_;
+        generation_ = header.generation_;
+        return(recordIds_ != nullptr);
+    }
+public:
+    DataStoreMappedFile() : recordIds_(nullptr), recordCount_(0), generation_(0), open_(false) {}
+
+    bool Open(const rct::UTF8String& fileName, bool verifyBlocks = false)
+    {
+        Close();
+        try
+        {
+            boost::interprocess::file_mapping mapping(fileName.nstr().c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+            mapping_.swap(mapping);
+            region_.swap(region);
+        }
+        catch(boost::interprocess::interprocess_exception& ipEx)
+        {
+            return(false);
+        }
+        open_ = parse(verifyBlocks);
+        if (!open_)Close();
+        return(open_);
+    }
+
+    void Close()
+    {
+        boost::interprocess::mapped_region emptyRegion;
+        boost::interprocess::file_mapping emptyMapping;
+        region_.swap(emptyRegion);
+        mapping_.swap(emptyMapping);
+        columns_.clear();
+        columnIdx_.clear();
+        inflated_.clear();
+        recordIds_ = nullptr;
+        recordCount_ = 0;
+        generation_ = 0;
+        open_ = false;
+    }
+
+    bool IsOpen() const
+    {
+        return(open_);
+    }
+
+    boost::uint64_t GetNumberRecords() const
+    {
+        return(recordCount_);
+    }
+
+    //Snapshot generation written by DataStore::Compact, see DataStoreLog.h
+    boost::uint32_t GetGeneration() const
+    {
+        return(generation_);
+    }
+
+    boost::uint64_t GetRecordId(boost::uint64_t row) const
+    {
+        if (row >= recordCount_)return(0);
+        const unsigned char* p = recordIds_ + row * 8;
+        boost::uint64_t val = 0;
+        for (unsigned int i = 0; i < 8; ++i)val |= static_cast<boost::uint64_t>(p[i]) << (i * 8);
+        return(val);
+    }
+
+    bool GetRecord(boost::uint64_t row, MappedRecord& record) const
+    {
+        if (!open_ || row >= recordCount_)return(false);
+        record = MappedRecord(this, row);
+        return(true);
+    }
+
+    //A record holds one value per column, so at most one block of the column has the row
+    bool GetColumn(boost::uint64_t row, const DataStr& name, MappedValue& value) const
+    {
+        auto cFind = columnIdx_.find(name);
+        if (cFind == columnIdx_.end())return(false);
+        return(GetColumn(row, cFind->second, value));
+    }
+
+    //Position of a named column, for the positional GetColumn
+    bool GetColumnIndex(const DataStr& name, size_t& columnIdx) const
+    {
+        auto cFind = columnIdx_.find(name);
+        if (cFind == columnIdx_.end())return(false);
+        columnIdx = cFind->second;
+        return(true);
+    }
+
+    //Positional access for callers walking every column - see GetNumberColumns/GetColumnName
+    bool GetColumn(boost::uint64_t row, size_t columnIdx, MappedValue& value) const
+    {
+        if (columnIdx >= columns_.size())return(false);
+        const ColumnBlocks& blocks = columns_[columnIdx];
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        if (blocks.hasProperties_ && blocks.properties_.GetValue(row, data, size))
+        {
+            value = MappedValue(data, size, DATASTORE_VALUE_STRING);
+            return(true);
+        }
+        if (blocks.hasObjects_ && blocks.objects_.GetValue(row, data, size))
+        {
+            value = MappedValue(data, size, DATASTORE_VALUE_BYTES);
+            return(true);
+        }
+        for (size_t i = 0; i < blocks.typed_.size(); ++i)
+        {
+            if (blocks.typed_[i].second.GetValue(row, data, size))
+            {
+                value = MappedValue(data, size, blocks.typed_[i].first);
+                return(true);
+            }
+        }
+        return(false);
+    }
+
+    std::vector<DataStr> GetColumnNames() const
+    {
+        std::vector<DataStr> rt;
+        rt.reserve(columns_.size());
+        for (size_t i = 0; i < columns_.size(); ++i)
+        {
+            rt.push_back(columns_[i].name_);
+        }
+        return(rt);
+    }
+
+    size_t GetNumberColumns() const
+    {
+        return(columns_.size());
+    }
+
+    const DataStr& GetColumnName(size_t columnIdx) const
+    {
+        return(columns_[columnIdx].name_);
+    }
+
+    const unsigned char* GetData() const
+    {
+        return(static_cast<const unsigned char*>(region_.get_address()));
+    }
+
+    size_t GetSize() const
+    {
+        return(region_.get_size());
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_MAPPED_FILE_H_
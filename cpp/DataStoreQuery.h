@@ -0,0 +1,630 @@
+#ifndef DATA_STORE_QUERY_H_
+#define DATA_STORE_QUERY_H_
+
+#include "DataStore.h"
+#include "DataStoreIndex.h"
+#include "DataStoreColumnStore.h"
+#include "WorkerPool.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+
+namespace rct {
+
+//!  Data Store Query
+/*!
+ * Filter, projection and group-by aggregation over a DataStore.  Execute
+ * plans where candidate rows come from: an equality filter on an indexed
+ * column, a range filter on an ordered index, a range filter on a typed
+ * column of the column store, or else every row.  Candidates then run in
+ * batches of BatchRows through each filter in turn, narrowing a selection
+ * of rows column by column, and the rows left are projected or
+ * aggregated.  Large queries run their batches as morsels on a
+ * WorkerPool, each worker aggregating into a partial of its own that is
+ * merged at the end.  Each batch fetches its own records, so a query holds
+ * one batch per worker besides the candidate rows an index or the column
+ * store planned.  Values are DataStoreIndex keys and follow the index
+ * rules: a filter only matches values of its own type, and a row without
+ * the column matches no filter, not even QUERY_NOT_EQUAL.  Object columns
+ * read as null.  Stores opened with LoadMapped are read straight from the
+ * mapping.  Lazily loaded rows are parsed as their batch reaches them,
+ * which changes the store, so while the store IsLazyPending queries run
+ * on the calling thread.
+ */
+class DataStoreQuery
+{
+public:
+    typedef DataStore::IndexType IndexType;
+    typedef DataStore::DataStr DataStr;
+    typedef DataStoreIndex::Key Value;
+
+    typedef enum CompareOp
+    {
+        QUERY_EQUAL,
+        QUERY_NOT_EQUAL,
+        QUERY_LESS,
+        QUERY_LESS_EQUAL,
+        QUERY_GREATER,
+        QUERY_GREATER_EQUAL,
+        //Inclusive range, see AddRangeFilter
+        QUERY_BETWEEN
+    };
+
+    typedef enum AggregateKind
+    {
+        AGGREGATE_COUNT,
+        AGGREGATE_SUM,
+        AGGREGATE_MIN,
+        AGGREGATE_MAX,
+        AGGREGATE_AVG
+    };
+
+    //Rows handed through the plan at a time
+    static const size_t BatchRows = 1024;
+    //Queries over fewer candidate rows run on the calling thread
+    static const size_t ParallelRows = 4 * BatchRows;
+
+    //! Rows produced by Execute; values are row major and null values have type DATASTORE_VALUE_NONE
+    class ResultSet
+    {
+        friend class DataStoreQuery;
+    private:
+        std::vector<DataStr> columns_;
+        std::vector<Value> values_;
+        //Store rows behind each result row of a projection; empty for aggregates
+        std::vector<IndexType> rowIds_;
+        size_t rowCount_;
+    public:
+        ResultSet() : rowCount_(0) {}
+
+        void Clear()
+        {
+            columns_.clear();
+            values_.clear();
+            rowIds_.clear();
+            rowCount_ = 0;
+        }
+
+        size_t GetNumberRows() const
+        {
+            return(rowCount_);
+        }
+
+        size_t GetNumberColumns() const
+        {
+            return(columns_.size());
+        }
+
+        const DataStr& GetColumnName(size_t col) const
+        {
+            return(columns_[col]);
+        }
+
+        const Value& GetValue(size_t row, size_t col) const
+        {
+            return(values_[row * columns_.size() + col]);
+        }
+
+        bool GetRowId(size_t row, IndexType& id) const
+        {
+            if (row >= rowIds_.size())return(false);
+            id = rowIds_[row];
+            return(true);
+        }
+    };
+private:
+    //Column ids are schema ids, or column positions in the file for mapped stores
+    struct Filter
+    {
+        DataStr column_;
+        CompareOp op_;
+        Value value_;
+        //Upper bound of QUERY_BETWEEN
+        Value high_;
+        DataStoreSchema::ColumnId id_;
+        bool known_;
+    };
+
+    struct Aggregate
+    {
+        AggregateKind kind_;
+        //Empty for count(*)
+        DataStr column_;
+        DataStoreSchema::ColumnId id_;
+        bool known_;
+    };
+
+    //Running state of one aggregate within one group
+    struct Accumulator
+    {
+        boost::uint64_t count_;
+        boost::int64_t intSum_;
+        double doubleSum_;
+        //Sums stay exact integers until a double comes along
+        bool sawDouble_;
+        Value min_;
+        Value max_;
+        Accumulator() : count_(0), intSum_(0), doubleSum_(0), sawDouble_(false) {}
+    };
+
+    typedef std::map<std::vector<Value>, std::vector<Accumulator>> GroupMap;
+
+    //Output of the batches run so far
+    struct Partial
+    {
+        std::vector<Value> values_;
+        std::vector<IndexType> rowIds_;
+        GroupMap groups_;
+    };
+
+    //Rows the batches run over: the planned candidates in row order, or every row of the store
+    struct Candidates
+    {
+        std::vector<IndexType> rows_;
+        size_t count_;
+        bool allRows_;
+    };
+private:
+    DataStore& store_;
+    std::vector<Filter> filters_;
+    std::vector<DataStr> columns_;
+    std::vector<DataStoreSchema::ColumnId> columnIds_;
+    std::vector<bool> columnKnown_;
+    std::vector<DataStr> groupColumns_;
+    std::vector<DataStoreSchema::ColumnId> groupIds_;
+    std::vector<bool> groupKnown_;
+    std::vector<Aggregate> aggregates_;
+    unsigned int threads_;
+    //Set by Execute for stores opened with LoadMapped
+    const DataStoreMappedFile* mapped_;
+private:
+    DataStoreQuery(const DataStoreQuery& rhs);
+    void operator=(const DataStoreQuery& rhs);
+
+    static bool isNumeric(DataStoreValueType type)
+    {
+        return(type == DATASTORE_VALUE_INT64 || type == DATASTORE_VALUE_DOUBLE || type == DATASTORE_VALUE_BOOL || type == DATASTORE_VALUE_TIMESTAMP);
+    }
+
+    //Null for missing and object columns; mapped stores have no record and read the row from the file
+    bool columnValue(const DataStore::DataStoreRecord* record, IndexType row, DataStoreSchema::ColumnId id, Value& value) const
+    {
+        if (mapped_ != nullptr)
+        {
+            DataStoreMappedFile::MappedValue mappedValue;
+            if (!mapped_->GetColumn(row, id, mappedValue))return(false);
+            DataStoreValueType mappedType = mappedValue.GetType();
+            if (mappedType == DATASTORE_VALUE_NONE || mappedType == DATASTORE_VALUE_BYTES)return(false);
+            if (mappedType == DATASTORE_VALUE_STRING)value = Value(mappedValue.ToString());
+            else value = Value(mappedType, static_cast<boost::uint64_t>(mappedValue.GetInt64()));
+            return(true);
+        }
+        DataStoreValueType type = record->GetColumnType(id);
+        if (type == DATASTORE_VALUE_NONE || type == DATASTORE_VALUE_BYTES)return(false);
+        DataStore::DataStoreRecord::RecordResult result(rct::EMPTY_STRING);
+        if (!record->GetColumn(id, std::move(result)))return(false);
+        if (type == DATASTORE_VALUE_STRING)value = Value(result.GetString());
+        else value = Value(type, static_cast<boost::uint64_t>(result.GetInt64()));
+        return(true);
+    }
+
+    static bool compare(const Value& lhs, const Filter& filter)
+    {
+        if (lhs.GetType() != filter.value_.GetType())return(filter.op_ == QUERY_NOT_EQUAL);
+        switch (filter.op_)
+        {
+        case QUERY_EQUAL:           return(lhs == filter.value_);
+        case QUERY_NOT_EQUAL:       return(!(lhs == filter.value_));
+        case QUERY_LESS:            return(lhs < filter.value_);
+        case QUERY_LESS_EQUAL:      return(!(filter.value_ < lhs));
+        case QUERY_GREATER:         return(filter.value_ < lhs);
+        case QUERY_GREATER_EQUAL:   return(!(lhs < filter.value_));
+        case QUERY_BETWEEN:         return(!(lhs < filter.value_) && !(filter.high_ < lhs));
+        default:                    return(false);
+        }
+    }
+
+    static double numericValue(const Value& value)
+    {
+        if (value.GetType() == DATASTORE_VALUE_DOUBLE)return(DataStoreBinaryFormat::BitsToDouble(value.GetBits()));
+        return(static_cast<double>(static_cast<boost::int64_t>(value.GetBits())));
+    }
+
+    static void accumulate(const Aggregate& aggregate, const Value& value, bool hasValue, Accumulator& acc)
+    {
+        if (aggregate.column_.empty())
+        {
+            //count(*) counts rows, nulls included
+            ++acc.count_;
+            return;
+        }
+        if (!hasValue)return;
+        if (aggregate.kind_ == AGGREGATE_SUM || aggregate.kind_ == AGGREGATE_AVG)
+        {
+            if (!isNumeric(value.GetType()))return;
+            if (value.GetType() == DATASTORE_VALUE_DOUBLE)acc.sawDouble_ = true;
+            else acc.intSum_ += static_cast<boost::int64_t>(value.GetBits());
+            acc.doubleSum_ += numericValue(value);
+        }
+        if (acc.count_ == 0 || value < acc.min_)acc.min_ = value;
+        if (acc.count_ == 0 || acc.max_ < value)acc.max_ = value;
+        ++acc.count_;
+    }
+
+    static Value finish(const Aggregate& aggregate, const Accumulator& acc)
+    {
+        switch (aggregate.kind_)
+        {
+        case AGGREGATE_COUNT:
+            return(Value::Int64(static_cast<boost::int64_t>(acc.count_)));
+        case AGGREGATE_SUM:
+            if (acc.count_ == 0)return(Value());
+            return(acc.sawDouble_ ? Value::Double(acc.doubleSum_) : Value::Int64(acc.intSum_));
+        case AGGREGATE_AVG:
+            if (acc.count_ == 0)return(Value());
+            return(Value::Double(acc.doubleSum_ / static_cast<double>(acc.count_)));
+        case AGGREGATE_MIN:
+            return(acc.min_);
+        case AGGREGATE_MAX:
+            return(acc.max_);
+        default:
+            return(Value());
+        }
+    }
+
+    //Sums and averages count only numeric values; min, max and count take any value
+    static void mergeAccumulator(const Accumulator& from, Accumulator& into)
+    {
+        if (from.count_ == 0)return;
+        if (into.count_ == 0 || from.min_ < into.min_)into.min_ = from.min_;
+        if (into.count_ == 0 || into.max_ < from.max_)into.max_ = from.max_;
+        into.count_ += from.count_;
+        into.intSum_ += from.intSum_;
+        into.doubleSum_ += from.doubleSum_;
+        into.sawDouble_ = into.sawDouble_ || from.sawDouble_;
+    }
+
+    bool isAggregate() const
+    {
+        return(!aggregates_.empty() || !groupColumns_.empty());
+    }
+
+    bool resolveColumn(const DataStr& name, DataStoreSchema::ColumnId& id) const
+    {
+        if (mapped_ == nullptr)return(store_.GetColumnId(name, id));
+        size_t columnIdx = 0;
+        if (!mapped_->GetColumnIndex(name, columnIdx))return(false);
+        id = static_cast<DataStoreSchema::ColumnId>(columnIdx);
+        return(true);
+    }
+
+    //Resolves column names once per Execute; unknown names read as null
+    void resolveColumns()
+    {
+        for (size_t f = 0; f < filters_.size(); ++f)
+        {
+            filters_[f].known_ = this->resolveColumn(filters_[f].column_, filters_[f].id_);
+        }
+        columnIds_.assign(columns_.size(), 0);
+        columnKnown_.assign(columns_.size(), false);
+        for (size_t c = 0; c < columns_.size(); ++c)
+        {
+            columnKnown_[c] = this->resolveColumn(columns_[c], columnIds_[c]);
+        }
+        groupIds_.assign(groupColumns_.size(), 0);
+        groupKnown_.assign(groupColumns_.size(), false);
+        for (size_t g = 0; g < groupColumns_.size(); ++g)
+        {
+            groupKnown_[g] = this->resolveColumn(groupColumns_[g], groupIds_[g]);
+        }
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            aggregates_[a].known_ = !aggregates_[a].column_.empty() && this->resolveColumn(aggregates_[a].column_, aggregates_[a].id_);
+        }
+    }
+
+    //Column store filter for a typed range; false if the column store cannot answer it
+    bool columnStoreRows(const Filter& filter, std::vector<IndexType>& rows) const
+    {
+        const DataStoreColumnStore* columnStore = store_.GetColumnStore();
+        DataStoreValueType type = filter.value_.GetType();
+        if (columnStore == nullptr || !isNumeric(type) || filter.high_.GetType() != type)return(false);
+        std::vector<size_t> matches;
+        if (type == DATASTORE_VALUE_DOUBLE)
+        {
+            columnStore->FilterDouble(filter.id_, numericValue(filter.value_), numericValue(filter.high_), matches);
+        }
+        else
+        {
+            columnStore->FilterInt64(filter.id_, type, static_cast<boost::int64_t>(filter.value_.GetBits()), static_cast<boost::int64_t>(filter.high_.GetBits()), matches);
+        }
+        rows.assign(matches.begin(), matches.end());
+        return(true);
+    }
+
+    //Candidate rows for the filters in row order; false when every row is a candidate
+    bool planCandidates(std::vector<IndexType>& rows) const
+    {
+        //Equality on an indexed column first, it is the most selective
+        for (size_t f = 0; f < filters_.size(); ++f)
+        {
+            const Filter& filter = filters_[f];
+            if (filter.op_ != QUERY_EQUAL)continue;
+            if (!filter.known_ || store_.FindRecords(filter.column_, filter.value_, rows))
+            {
+                std::sort(rows.begin(), rows.end());
+                return(true);
+            }
+        }
+        for (size_t f = 0; f < filters_.size(); ++f)
+        {
+            const Filter& filter = filters_[f];
+            if (filter.op_ != QUERY_BETWEEN)continue;
+            if (!filter.known_)return(true);
+            if (store_.FindRecordRange(filter.column_, filter.value_, filter.high_, rows))
+            {
+                std::sort(rows.begin(), rows.end());
+                return(true);
+            }
+            if (columnStoreRows(filter, rows))return(true);
+        }
+        return(false);
+    }
+
+    //Store rows of the batch of candidates starting at first, with their records unless the store is mapped
+    bool fetchBatch(const Candidates& candidates, size_t first, std::vector<IndexType>& rows, std::vector<DataStore::DataStoreRecord*>& records) const
+    {
+        size_t count = std::min(static_cast<size_t>(BatchRows), candidates.count_ - first);
+        rows.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            rows[i] = candidates.allRows_ ? static_cast<IndexType>(first + i) : candidates.rows_[first + i];
+        }
+        if (mapped_ != nullptr)return(true);
+        records.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!store_.GetDataRecord(rows[i], &records[i]))return(false);
+        }
+        return(true);
+    }
+
+    //Runs the batch of candidates starting at first through the filters, then projects or aggregates
+    //what is left.  Loaded records are only read, so batches can run on several threads at once
+    bool runBatch(const Candidates& candidates, size_t first, Partial& partial) const
+    {
+        std::vector<IndexType> rows;
+        std::vector<DataStore::DataStoreRecord*> records;
+        if (!this->fetchBatch(candidates, first, rows, records))return(false);
+        std::vector<size_t> selection(rows.size());
+        for (size_t i = 0; i < selection.size(); ++i)selection[i] = i;
+        Value value;
+        for (size_t f = 0; f < filters_.size() && !selection.empty(); ++f)
+        {
+            const Filter& filter = filters_[f];
+            size_t kept = 0;
+            for (size_t s = 0; s < selection.size(); ++s)
+            {
+                size_t i = selection[s];
+                if (filter.known_ && columnValue(records.empty() ? nullptr : records[i], rows[i], filter.id_, value) && compare(value, filter))
+                {
+                    selection[kept++] = i;
+                }
+            }
+            selection.resize(kept);
+        }
+        if (!isAggregate())
+        {
+            for (size_t s = 0; s < selection.size(); ++s)
+            {
+                size_t i = selection[s];
+                const DataStore::DataStoreRecord* record = records.empty() ? nullptr : records[i];
+                partial.rowIds_.push_back(rows[i]);
+                for (size_t c = 0; c < columnIds_.size(); ++c)
+                {
+                    if (!columnKnown_[c] || !columnValue(record, rows[i], columnIds_[c], value))value = Value();
+                    partial.values_.push_back(value);
+                }
+            }
+            return(true);
+        }
+        std::vector<Value> groupKey(groupIds_.size());
+        for (size_t s = 0; s < selection.size(); ++s)
+        {
+            size_t i = selection[s];
+            const DataStore::DataStoreRecord* record = records.empty() ? nullptr : records[i];
+            for (size_t g = 0; g < groupIds_.size(); ++g)
+            {
+                if (!groupKnown_[g] || !columnValue(record, rows[i], groupIds_[g], groupKey[g]))groupKey[g] = Value();
+            }
+            GroupMap::iterator gIter = partial.groups_.find(groupKey);
+            if (gIter == partial.groups_.end())gIter = partial.groups_.insert(std::make_pair(groupKey, std::vector<Accumulator>(aggregates_.size()))).first;
+            for (size_t a = 0; a < aggregates_.size(); ++a)
+            {
+                const Aggregate& aggregate = aggregates_[a];
+                bool hasValue = aggregate.known_ && columnValue(record, rows[i], aggregate.id_, value);
+                accumulate(aggregate, value, hasValue, gIter->second[a]);
+            }
+        }
+        return(true);
+    }
+
+    //Folds a partial of later rows into this one
+    static void mergePartial(Partial& from, Partial& into)
+    {
+        into.values_.insert(into.values_.end(), from.values_.begin(), from.values_.end());
+        into.rowIds_.insert(into.rowIds_.end(), from.rowIds_.begin(), from.rowIds_.end());
+        if (into.groups_.empty())
+        {
+            into.groups_.swap(from.groups_);
+            return;
+        }
+        for (GroupMap::const_iterator gIter = from.groups_.begin(); gIter != from.groups_.end(); ++gIter)
+        {
+            GroupMap::iterator iFind = into.groups_.find(gIter->first);
+            if (iFind == into.groups_.end())
+            {
+                into.groups_.insert(*gIter);
+                continue;
+            }
+            for (size_t a = 0; a < gIter->second.size(); ++a)
+            {
+                mergeAccumulator(gIter->second[a], iFind->second[a]);
+            }
+        }
+    }
+
+    //One morsel of runParallel; aggregates go to the worker's partial, projections to the batch's
+    bool runMorsel(const Candidates& candidates, std::vector<Partial>& partials, unsigned int worker, size_t batch) const
+    {
+        return(this->runBatch(candidates, batch * BatchRows, partials[this->isAggregate() ? worker : batch]));
+    }
+
+    //Splits the candidates into batches run as morsels on the worker pool.  Aggregates build one
+    //partial per worker; projections one per batch so the rows come out in order
+    bool runParallel(const Candidates& candidates, Partial& result) const
+    {
+        size_t batchCount = (candidates.count_ + BatchRows - 1) / BatchRows;
+        size_t partialCount = this->isAggregate() ? WorkerPool::GetWorkerCount(batchCount, threads_) : batchCount;
+        std::vector<Partial> partials(partialCount);
+        if (!WorkerPool::ParallelForWorkers(batchCount, threads_,
+            boost::bind(&DataStoreQuery::runMorsel, this, boost::cref(candidates), boost::ref(partials), _1, _2)))
+        {
+            return(false);
+        }
+        for (size_t i = 0; i < partials.size(); ++i)
+        {
+            mergePartial(partials[i], result);
+        }
+        return(true);
+    }
+
+    void finishResult(Partial& partial, ResultSet& result) const
+    {
+        if (!isAggregate())
+        {
+            result.columns_ = columns_;
+            result.values_.swap(partial.values_);
+            result.rowIds_.swap(partial.rowIds_);
+            result.rowCount_ = result.rowIds_.size();
+            return;
+        }
+        result.columns_ = groupColumns_;
+        for (size_t a = 0; a < aggregates_.size(); ++a)
+        {
+            result.columns_.push_back(AggregateName(aggregates_[a].kind_, aggregates_[a].column_));
+        }
+        //Aggregates without groups report one row, even over no rows at all
+        if (groupColumns_.empty() && partial.groups_.empty())
+        {
+            partial.groups_.insert(std::make_pair(std::vector<Value>(), std::vector<Accumulator>(aggregates_.size())));
+        }
+        result.values_.reserve(partial.groups_.size() * result.columns_.size());
+        for (GroupMap::const_iterator gIter = partial.groups_.begin(); gIter != partial.groups_.end(); ++gIter)
+        {
+            result.values_.insert(result.values_.end(), gIter->first.begin(), gIter->first.end());
+            for (size_t a = 0; a < aggregates_.size(); ++a)
+            {
+                result.values_.push_back(finish(aggregates_[a], gIter->second[a]));
+            }
+        }
+        result.rowCount_ = partial.groups_.size();
+    }
+public:
+    explicit DataStoreQuery(DataStore& store) : store_(store), threads_(0), mapped_(nullptr) {}
+
+    //Keeps rows whose column compares to value with op
+    void AddFilter(const DataStr& column, CompareOp op, const Value& value)
+    {
+        Filter filter;
+        filter.column_ = column;
+        filter.op_ = op;
+        filter.value_ = value;
+        filter.high_ = value;
+        filter.id_ = 0;
+        filter.known_ = false;
+        filters_.push_back(filter);
+    }
+
+    //Keeps rows with low <= column <= high; can use an ordered index or the column store
+    void AddRangeFilter(const DataStr& column, const Value& low, const Value& high)
+    {
+        AddFilter(column, QUERY_BETWEEN, low);
+        filters_.back().high_ = high;
+    }
+
+    //Projected columns, in result column order; not combined with grouping or aggregates
+    void AddColumn(const DataStr& column)
+    {
+        columns_.push_back(column);
+    }
+
+    //Group columns come first in the result, followed by the aggregates.  Groups are in key order
+    void AddGroupColumn(const DataStr& column)
+    {
+        groupColumns_.push_back(column);
+    }
+
+    //An empty column with AGGREGATE_COUNT counts rows
+    void AddAggregate(AggregateKind kind, const DataStr& column)
+    {
+        Aggregate aggregate;
+        aggregate.kind_ = kind;
+        aggregate.column_ = column;
+        aggregate.id_ = 0;
+        aggregate.known_ = false;
+        aggregates_.push_back(aggregate);
+    }
+
+    void Clear()
+    {
+        filters_.clear();
+        columns_.clear();
+        groupColumns_.clear();
+        aggregates_.clear();
+    }
+
+    //Result column name of an aggregate, e.g. sum(amount) or count(*)
+    static DataStr AggregateName(AggregateKind kind, const DataStr& column)
+    {
+        static const wchar_t* names[] = { L"count", L"sum", L"min", L"max", L"avg" };
+        return(DataStr(names[kind]) + L'(' + (column.empty() ? DataStr(L"*") : column) + L')');
+    }
+
+    //Zero uses every hardware thread, one runs the query on the calling thread only
+    void SetThreadCount(unsigned int threadCount)
+    {
+        threads_ = threadCount;
+    }
+
+    //False for a projection combined with aggregates, or a row that fails to load
+    bool Execute(ResultSet& result)
+    {
+        result.Clear();
+        if (isAggregate() && !columns_.empty())return(false);
+        mapped_ = store_.GetMappedFile();
+        this->resolveColumns();
+        Candidates candidates;
+        candidates.allRows_ = !this->planCandidates(candidates.rows_);
+        candidates.count_ = candidates.allRows_ ? static_cast<size_t>(store_.GetNumberRecords()) : candidates.rows_.size();
+        Partial partial;
+        if (candidates.count_ >= ParallelRows && threads_ != 1 && !store_.IsLazyPending())
+        {
+            if (!this->runParallel(candidates, partial))return(false);
+        }
+        else
+        {
+            for (size_t first = 0; first < candidates.count_; first += BatchRows)
+            {
+                if (!this->runBatch(candidates, first, partial))return(false);
+            }
+        }
+        this->finishResult(partial, result);
+        return(true);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_QUERY_H_
@@ -0,0 +1,147 @@
+#ifndef DATA_STORE_READER_H_
+#define DATA_STORE_READER_H_
+
+#include "DataStore.h"
+#include "DataStoreTextStream.h"
+#include "DataStoreMappedFile.h"
+#include <boost/function.hpp>
+
+namespace rct {
+
+//!  Data Store Reader
+/*!
+ * Pull based, record at a time reader for data store files that never
+ * holds more than one record plus a bounded read buffer.  Text files are
+ * parsed incrementally; binary files are mapped and each record is built
+ * from the mapped column blocks, so stores larger than RAM can be scanned
+ * or filtered without loading them into a DataStore.
+ */
+class DataStoreReader
+{
+public:
+    typedef DataStore::IndexType IndexType;
+    //! Return false from the callback to stop the scan early
+    typedef boost::function<bool (DataStore::DataStoreRecord&)> RecordCallback;
+private:
+    DataStoreTextStream textStream_;
+    DataStoreMappedFile mappedFile_;
+    DataStore::DataStoreRecord::SchemaPtr schema_;
+    //Schema id of each mapped column, by column position in the file
+    std::vector<DataStoreSchema::ColumnId> mappedColumnIds_;
+    std::wstring recordText_;
+    IndexType recordCount_;
+    IndexType nextRecord_;
+    bool binary_;
+    bool open_;
+private:
+    DataStoreReader(const DataStoreReader& rhs);
+    void operator=(const DataStoreReader& rhs);
+
+    bool nextText(DataStore::DataStoreRecord* record)
+    {
+        if (!textStream_.ReadRecords(recordText_, 1))return(false);
+        std::wistringstream iStr(recordText_);
+        return(record->InputFromStream(iStr));
+    }
+
+    bool nextBinary(DataStore::DataStoreRecord* record)
+    {
+        DataStoreMappedFile::MappedValue value;
+        for (size_t c = 0; c < mappedColumnIds_.size(); ++c)
+        {
+            if (!mappedFile_.GetColumn(nextRecord_, c, value))continue;
+            if (!record->AddEncodedColumn(mappedColumnIds_[c], value.GetType(), value.GetData(), value.GetSize()))return(false);
+        }
+        return(true);
+    }
+public:
+    DataStoreReader() :
+        recordCount_(0),
+        nextRecord_(0),
+        binary_(false),
+        open_(false)
+    {}
+
+    //Detects the binary format by its magic; anything else is read as text
+    bool Open(const rct::UTF8String& fileName)
+    {
+        Close();
+        schema_ = boost::make_shared<DataStoreSchema>();
+        binary_ = DataStoreBinaryFormat::IsBinaryFile(fileName.nstr());
+        if (binary_)
+        {
+            if (!mappedFile_.Open(fileName))return(false);
+            recordCount_ = static_cast<IndexType>(mappedFile_.GetNumberRecords());
+            for (size_t c = 0; c < mappedFile_.GetNumberColumns(); ++c)
+            {
+                mappedColumnIds_.push_back(schema_->Intern(mappedFile_.GetColumnName(c)));
+            }
+        }
+        else
+        {
+            unsigned long recordCount = 0;
+            if (!textStream_.Open(fileName.nstr(), recordCount))return(false);
+            recordCount_ = recordCount;
+        }
+        open_ = true;
+        return(true);
+    }
+
+    void Close()
+    {
+        textStream_.Close();
+        mappedFile_.Close();
+        mappedColumnIds_.clear();
+        recordText_.clear();
+        recordCount_ = 0;
+        nextRecord_ = 0;
+        open_ = false;
+    }
+
+    IndexType GetNumberRecords() const
+    {
+        return(recordCount_);
+    }
+
+    //Every record handed out shares this column dictionary
+    const DataStore::DataStoreRecord::SchemaPtr& GetSchema() const
+    {
+        return(schema_);
+    }
+
+    //Reads the next record into a new record owned by the caller; false at the end or on a parse error
+    bool Next(DataStore::DataStoreRecord** record)
+    {
+        if (record == nullptr || !open_ || nextRecord_ >= recordCount_)return(false);
+        IndexType id = binary_ ? static_cast<IndexType>(mappedFile_.GetRecordId(nextRecord_)) : 0;
+        DataStore::DataStoreRecord* dStoreRec = new DataStore::DataStoreRecord(id, schema_);
+        bool rt = binary_ ? nextBinary(dStoreRec) : nextText(dStoreRec);
+        if (!rt)
+        {
+            delete dStoreRec;
+            open_ = false;
+            return(false);
+        }
+        ++nextRecord_;
+        *record = dStoreRec;
+        return(true);
+    }
+
+    //Hands each remaining record to the callback and frees it afterwards
+    bool ForEachRecord(RecordCallback callback)
+    {
+        if (callback.empty())return(false);
+        DataStore::DataStoreRecord* record = nullptr;
+        while (Next(&record))
+        {
+            bool keepGoing = callback(*record);
+            delete record;
+            if (!keepGoing)return(true);
+        }
+        return(nextRecord_ == recordCount_);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_READER_H_
@@ -0,0 +1,95 @@
+#ifndef DATA_STORE_SCHEMA_H_
+#define DATA_STORE_SCHEMA_H_
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+namespace rct {
+
+//Kind of value held by a record column; the numbers are persisted in logs and files
+typedef enum DataStoreValueType
+{
+    DATASTORE_VALUE_NONE      = 0,
+    DATASTORE_VALUE_STRING    = 1,
+    DATASTORE_VALUE_BYTES     = 2,
+    DATASTORE_VALUE_INT64     = 3,
+    DATASTORE_VALUE_DOUBLE    = 4,
+    DATASTORE_VALUE_BOOL      = 5,
+    DATASTORE_VALUE_TIMESTAMP = 6   //int64 milliseconds since the Unix epoch
+};
+
+//Encoded size of a fixed width value, zero for strings and bytes
+inline size_t DataStoreValueWidth(DataStoreValueType type)
+{
+    switch (type)
+    {
+    case DATASTORE_VALUE_INT64:
+    case DATASTORE_VALUE_DOUBLE:
+    case DATASTORE_VALUE_TIMESTAMP:
+        return(8);
+    case DATASTORE_VALUE_BOOL:
+        return(1);
+    default:
+        return(0);
+    }
+}
+
+//!  Data Store Schema
+/*!
+ * Column name dictionary shared by every record of a data store.  Each
+ * distinct column name is stored once and identified by a small dense
+ * integer, which records use as the index of the column's value slot.
+ * Ids are never reused or reassigned, and names live in a deque so
+ * references returned by GetName stay valid as the dictionary grows.
+ */
+class DataStoreSchema
+{
+public:
+    typedef std::wstring DataStr;
+    typedef unsigned int ColumnId;
+    static const ColumnId InvalidColumn = 0xFFFFFFFF;
+private:
+    std::deque<DataStr> names_;
+    std::unordered_map<DataStr, ColumnId> ids_;
+private:
+    DataStoreSchema(const DataStoreSchema& rhs);
+    void operator=(const DataStoreSchema& rhs);
+public:
+    DataStoreSchema() {}
+
+    //Returns the id of the column, adding it to the dictionary if needed
+    ColumnId Intern(const DataStr& name)
+    {
+        auto idFind = ids_.find(name);
+        if (idFind != ids_.end())return(idFind->second);
+        ColumnId id = static_cast<ColumnId>(names_.size());
+        names_.push_back(name);
+        ids_.insert(std::make_pair(name, id));
+        return(id);
+    }
+
+    bool Find(const DataStr& name, ColumnId& id) const
+    {
+        auto idFind = ids_.find(name);
+        if (idFind == ids_.end())return(false);
+        id = idFind->second;
+        return(true);
+    }
+
+    const DataStr& GetName(ColumnId id) const
+    {
+        static const DataStr emptyName;
+        if (id >= names_.size())return(emptyName);
+        return(names_[id]);
+    }
+
+    size_t GetNumberColumns() const
+    {
+        return(names_.size());
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_SCHEMA_H_
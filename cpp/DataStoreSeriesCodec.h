@@ -0,0 +1,550 @@
+#ifndef DATA_STORE_SERIES_CODEC_H_
+#define DATA_STORE_SERIES_CODEC_H_
+
+#include "DataStoreBinaryFormat.h"
+#include <vector>
+#include <cstring>
+#include <boost/cstdint.hpp>
+
+namespace rct {
+
+//!  Data Store Series Codec
+/*!
+ * Compressed (timestamp, double) series in the style of Facebook's Gorilla:
+ * timestamps are stored as the change of the delta between samples and
+ * values as the XOR with the previous value, so a regular series with
+ * slowly moving values takes a bit or two per timestamp and a few bits per
+ * value.  Samples are cut into blocks of a fixed sample count; every
+ * block starts over with a raw sample and is listed in an index, so a
+ * decoder can seek to a timestamp by decoding one block at most.
+ *
+ * Layout, little endian:
+ *   Header  - magic "RDSS", uint32 sample count, uint32 block count, uint32 zero
+ *   Index   - block count x [int64 first timestamp, uint32 payload offset, uint32 sample count]
+ *   Payload - the blocks' bit streams, each padded to a byte
+ *
+ * Within a block the first sample is 64 bits of timestamp and 64 bits of
+ * value.  Each later timestamp is its delta of delta: '0' for none, then
+ * '10', '110', '1110' with 7, 9 and 12 bit values, or '1111' and 64 bits.
+ * Each later value is '0' when it repeats, '10' and the meaningful bits
+ * when its XOR fits the previous window, or '11', 5 bits of leading
+ * zeros, 6 bits of length (0 for 64) and the meaningful bits.
+ */
+namespace DataStoreSeriesCodec
+{
+    static const unsigned char Magic[4] = { 'R', 'D', 'S', 'S' };
+    static const size_t HeaderSize = 16;
+    static const size_t IndexEntrySize = 16;
+
+    inline unsigned int leadingZeros(boost::uint64_t val)
+    {
+        if (val == 0)return(64);
+        unsigned int rt = 0;
+        for (unsigned int shift = 32; shift > 0; shift /= 2)
+        {
+            if ((val >> (64 - shift)) == 0)
+            {
+                rt += shift;
+                val <<= shift;
+            }
+        }
+        return(rt);
+    }
+
+    inline unsigned int trailingZeros(boost::uint64_t val)
+    {
+        if (val == 0)return(64);
+        unsigned int rt = 0;
+        for (unsigned int shift = 32; shift > 0; shift /= 2)
+        {
+            if ((val & ((boost::uint64_t(1) << shift) - 1)) == 0)
+            {
+                rt += shift;
+                val >>= shift;
+            }
+        }
+        return(rt);
+    }
+
+    //Most significant bit first
+    class BitWriter
+    {
+    private:
+        std::vector<unsigned char> bytes_;
+        boost::uint64_t pending_;
+        unsigned int pendingBits_;
+    public:
+        BitWriter() : pending_(0), pendingBits_(0) {}
+
+        void Write(boost::uint64_t val, unsigned int count)
+        {
+            if (count > 32)
+            {
+                Write(val >> 32, count - 32);
+                count = 32;
+            }
+            pending_ = (pending_ << count) | (val & ((boost::uint64_t(1) << count) - 1));
+            pendingBits_ += count;
+            while (pendingBits_ >= 8)
+            {
+                pendingBits_ -= 8;
+                bytes_.push_back(static_cast<unsigned char>(pending_ >> pendingBits_));
+            }
+        }
+
+        //Pads the last byte with zeros
+        void Flush()
+        {
+            if (pendingBits_ > 0)Write(0, 8 - pendingBits_);
+        }
+
+        std::vector<unsigned char>& GetBytes()
+        {
+            return(bytes_);
+        }
+
+        void Clear()
+        {
+            bytes_.clear();
+            pending_ = 0;
+            pendingBits_ = 0;
+        }
+    };
+
+    class BitReader
+    {
+    private:
+        const unsigned char* data_;
+        size_t size_;
+        size_t pos_;
+        boost::uint64_t pending_;
+        unsigned int pendingBits_;
+        bool overrun_;
+    public:
+        BitReader() : data_(nullptr), size_(0), pos_(0), pending_(0), pendingBits_(0), overrun_(false) {}
+
+        void Reset(const unsigned char* data, size_t size)
+        {
+            data_ = data;
+            size_ = size;
+            pos_ = 0;
+            pending_ = 0;
+            pendingBits_ = 0;
+            overrun_ = false;
+        }
+
+        //Reads past the end return zeros and set the overrun flag
+        boost::uint64_t Read(unsigned int count)
+        {
+            if (count > 32)
+            {
+                boost::uint64_t high = Read(count - 32);
+                return((high << 32) | Read(32));
+            }
+            while (pendingBits_ < count)
+            {
+                unsigned char byte = 0;
+                if (pos_ < size_)byte = data_[pos_++];
+                else overrun_ = true;
+                pending_ = (pending_ << 8) | byte;
+                pendingBits_ += 8;
+            }
+            pendingBits_ -= count;
+            return((pending_ >> pendingBits_) & ((boost::uint64_t(1) << count) - 1));
+        }
+
+        bool ReadBit()
+        {
+            return(Read(1) != 0);
+        }
+
+        bool Overrun() const
+        {
+            return(overrun_);
+        }
+    };
+
+    //Two's complement value of the low bits
+    inline boost::int64_t signExtend(boost::uint64_t val, unsigned int bits)
+    {
+        if (bits < 64 && (val >> (bits - 1)) & 1)val |= ~((boost::uint64_t(1) << bits) - 1);
+        return(static_cast<boost::int64_t>(val));
+    }
+}
+
+//!  Data Store Series Encoder
+/*!
+ * Streams samples into the series format above; Finish writes the series
+ * out and leaves the encoder empty for the next one.
+ */
+class DataStoreSeriesEncoder
+{
+public:
+    static const size_t DefaultBlockSamples = 256;
+private:
+    struct BlockInfo
+    {
+        boost::int64_t firstTimestamp_;
+        size_t offset_;
+        size_t count_;
+    };
+private:
+    size_t blockSamples_;
+    std::vector<BlockInfo> blocks_;
+    DataStoreSeriesCodec::BitWriter writer_;
+    size_t sampleCount_;
+    //State of the current block
+    size_t blockCount_;
+    boost::int64_t lastTimestamp_;
+    boost::int64_t lastDelta_;
+    boost::uint64_t lastBits_;
+    unsigned int lastLeading_;
+    unsigned int lastTrailing_;
+private:
+    DataStoreSeriesEncoder(const DataStoreSeriesEncoder& rhs);
+    void operator=(const DataStoreSeriesEncoder& rhs);
+
+    void writeTimestamp(boost::int64_t timestamp)
+    {
+        //Wrapping arithmetic, so any pair of timestamps round trips
+        boost::int64_t delta = static_cast<boost::int64_t>(static_cast<boost::uint64_t>(timestamp) - static_cast<boost::uint64_t>(lastTimestamp_));
+        boost::int64_t dod = static_cast<boost::int64_t>(static_cast<boost::uint64_t>(delta) - static_cast<boost::uint64_t>(lastDelta_));
+        if (dod == 0)writer_.Write(0, 1);
+        else if (dod >= -64 && dod <= 63)
+        {
+            writer_.Write(2, 2);
+            writer_.Write(static_cast<boost::uint64_t>(dod), 7);
+        }
+        else if (dod >= -256 && dod <= 255)
+        {
+            writer_.Write(6, 3);
+            writer_.Write(static_cast<boost::uint64_t>(dod), 9);
+        }
+        else if (dod >= -2048 && dod <= 2047)
+        {
+            writer_.Write(14, 4);
+            writer_.Write(static_cast<boost::uint64_t>(dod), 12);
+        }
+        else
+        {
+            writer_.Write(15, 4);
+            writer_.Write(static_cast<boost::uint64_t>(dod), 64);
+        }
+        lastDelta_ = delta;
+        lastTimestamp_ = timestamp;
+    }
+
+    void writeValue(boost::uint64_t bits)
+    {
+        boost::uint64_t xored = bits ^ lastBits_;
+        lastBits_ = bits;
+        if (xored == 0)
+        {
+            writer_.Write(0, 1);
+            return;
+        }
+        unsigned int leading = DataStoreSeriesCodec::leadingZeros(xored);
+        unsigned int trailing = DataStoreSeriesCodec::trailingZeros(xored);
+        if (leading > 31)leading = 31;
+        if (lastLeading_ + lastTrailing_ < 64 && leading >= lastLeading_ && trailing >= lastTrailing_)
+        {
+            writer_.Write(2, 2);
+            writer_.Write(xored >> lastTrailing_, 64 - lastLeading_ - lastTrailing_);
+            return;
+        }
+        unsigned int length = 64 - leading - trailing;
+        writer_.Write(3, 2);
+        writer_.Write(leading, 5);
+        writer_.Write(length & 63, 6);
+        writer_.Write(xored >> trailing, length);
+        lastLeading_ = leading;
+        lastTrailing_ = trailing;
+    }
+public:
+    explicit DataStoreSeriesEncoder(size_t blockSamples = DefaultBlockSamples) :
+        blockSamples_((blockSamples == 0) ? DefaultBlockSamples : blockSamples)
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        blocks_.clear();
+        writer_.Clear();
+        sampleCount_ = 0;
+        blockCount_ = 0;
+        lastTimestamp_ = 0;
+        lastDelta_ = 0;
+        lastBits_ = 0;
+        lastLeading_ = 64;
+        lastTrailing_ = 0;
+    }
+
+    //Timestamps must not go backwards
+    bool Append(boost::int64_t timestamp, double value)
+    {
+        if (sampleCount_ > 0 && timestamp < lastTimestamp_)return(false);
+        boost::uint64_t bits = DataStoreBinaryFormat::DoubleToBits(value);
+        if (blockCount_ == 0 || blockCount_ == blockSamples_)
+        {
+            writer_.Flush();
+            BlockInfo block;
+            block.firstTimestamp_ = timestamp;
+            block.offset_ = writer_.GetBytes().size();
+            block.count_ = 0;
+            blocks_.push_back(block);
+            writer_.Write(static_cast<boost::uint64_t>(timestamp), 64);
+            writer_.Write(bits, 64);
+            blockCount_ = 0;
+            lastTimestamp_ = timestamp;
+            lastDelta_ = 0;
+            lastBits_ = bits;
+            lastLeading_ = 64;
+            lastTrailing_ = 0;
+        }
+        else
+        {
+            writeTimestamp(timestamp);
+            writeValue(bits);
+        }
+        ++blockCount_;
+        ++blocks_.back().count_;
+        ++sampleCount_;
+        return(true);
+    }
+
+    size_t GetNumberSamples() const
+    {
+        return(sampleCount_);
+    }
+
+    void Finish(std::vector<unsigned char>& out)
+    {
+        writer_.Flush();
+        const std::vector<unsigned char>& payload = writer_.GetBytes();
+        out.assign(DataStoreSeriesCodec::HeaderSize + blocks_.size() * DataStoreSeriesCodec::IndexEntrySize, 0);
+        std::memcpy(&out[0], DataStoreSeriesCodec::Magic, sizeof(DataStoreSeriesCodec::Magic));
+        DataStoreBinaryFormat::EncodeFixed(sampleCount_, 4, &out[4]);
+        DataStoreBinaryFormat::EncodeFixed(blocks_.size(), 4, &out[8]);
+        for (size_t i = 0; i < blocks_.size(); ++i)
+        {
+            unsigned char* entry = &out[DataStoreSeriesCodec::HeaderSize + i * DataStoreSeriesCodec::IndexEntrySize];
+            DataStoreBinaryFormat::EncodeFixed(static_cast<boost::uint64_t>(blocks_[i].firstTimestamp_), 8, entry);
+            DataStoreBinaryFormat::EncodeFixed(blocks_[i].offset_, 4, entry + 8);
+            DataStoreBinaryFormat::EncodeFixed(blocks_[i].count_, 4, entry + 12);
+        }
+        out.insert(out.end(), payload.begin(), payload.end());
+        Clear();
+    }
+};
+
+//!  Data Store Series Decoder
+/*!
+ * Reads a series written by DataStoreSeriesEncoder in place; the bytes
+ * must outlive the decoder.  Next walks the samples in order and Seek
+ * jumps to a timestamp through the block index.
+ */
+class DataStoreSeriesDecoder
+{
+private:
+    const unsigned char* data_;
+    size_t size_;
+    size_t sampleCount_;
+    size_t blockCount_;
+    const unsigned char* payload_;
+    size_t payloadSize_;
+    DataStoreSeriesCodec::BitReader reader_;
+    //Position within the current block
+    size_t block_;
+    size_t blockLeft_;
+    bool blockStarted_;
+    boost::int64_t lastTimestamp_;
+    boost::int64_t lastDelta_;
+    boost::uint64_t lastBits_;
+    unsigned int lastLeading_;
+    unsigned int lastTrailing_;
+private:
+    DataStoreSeriesDecoder(const DataStoreSeriesDecoder& rhs);
+    void operator=(const DataStoreSeriesDecoder& rhs);
+
+    const unsigned char* indexEntry(size_t block) const
+    {
+        return(data_ + DataStoreSeriesCodec::HeaderSize + block * DataStoreSeriesCodec::IndexEntrySize);
+    }
+
+    boost::int64_t blockTimestamp(size_t block) const
+    {
+        return(static_cast<boost::int64_t>(DataStoreBinaryFormat::DecodeFixed(indexEntry(block), 8)));
+    }
+
+    void startBlock(size_t block)
+    {
+        block_ = block;
+        blockStarted_ = false;
+        blockLeft_ = 0;
+        if (block >= blockCount_)return;
+        size_t offset = static_cast<size_t>(DataStoreBinaryFormat::DecodeFixed(indexEntry(block) + 8, 4));
+        blockLeft_ = static_cast<size_t>(DataStoreBinaryFormat::DecodeFixed(indexEntry(block) + 12, 4));
+        reader_.Reset(payload_ + offset, payloadSize_ - offset);
+    }
+
+    boost::int64_t readDeltaOfDelta()
+    {
+        if (!reader_.ReadBit())return(0);
+        if (!reader_.ReadBit())return(DataStoreSeriesCodec::signExtend(reader_.Read(7), 7));
+        if (!reader_.ReadBit())return(DataStoreSeriesCodec::signExtend(reader_.Read(9), 9));
+        if (!reader_.ReadBit())return(DataStoreSeriesCodec::signExtend(reader_.Read(12), 12));
+        return(static_cast<boost::int64_t>(reader_.Read(64)));
+    }
+
+    boost::uint64_t readValue()
+    {
+        if (!reader_.ReadBit())return(lastBits_);
+        if (reader_.ReadBit())
+        {
+            lastLeading_ = static_cast<unsigned int>(reader_.Read(5));
+            unsigned int length = static_cast<unsigned int>(reader_.Read(6));
+            if (length == 0)length = 64;
+            lastTrailing_ = (lastLeading_ + length > 64) ? 0 : 64 - lastLeading_ - length;
+        }
+        unsigned int length = 64 - lastLeading_ - lastTrailing_;
+        lastBits_ ^= reader_.Read(length) << lastTrailing_;
+        return(lastBits_);
+    }
+public:
+    DataStoreSeriesDecoder() : data_(nullptr), size_(0), sampleCount_(0), blockCount_(0), payload_(nullptr), payloadSize_(0)
+    {
+        startBlock(0);
+    }
+
+    //Checks the header and the index and moves to the first sample
+    bool Open(const unsigned char* data, size_t size)
+    {
+        sampleCount_ = 0;
+        blockCount_ = 0;
+        if (data == nullptr || size < DataStoreSeriesCodec::HeaderSize || std::memcmp(data, DataStoreSeriesCodec::Magic, sizeof(DataStoreSeriesCodec::Magic)) != 0)return(false);
+        size_t sampleCount = static_cast<size_t>(DataStoreBinaryFormat::DecodeFixed(data + 4, 4));
+        size_t blockCount = static_cast<size_t>(DataStoreBinaryFormat::DecodeFixed(data + 8, 4));
+        if (blockCount > (size - DataStoreSeriesCodec::HeaderSize) / DataStoreSeriesCodec::IndexEntrySize)return(false);
+        data_ = data;
+        size_ = size;
+        payload_ = data + DataStoreSeriesCodec::HeaderSize + blockCount * DataStoreSeriesCodec::IndexEntrySize;
+        payloadSize_ = size - (payload_ - data);
+        size_t total = 0;
+        for (size_t i = 0; i < blockCount; ++i)
+        {
+            const unsigned char* entry = data + DataStoreSeriesCodec::HeaderSize + i * DataStoreSeriesCodec::IndexEntrySize;
+            if (DataStoreBinaryFormat::DecodeFixed(entry + 8, 4) >= payloadSize_ || DataStoreBinaryFormat::DecodeFixed(entry + 12, 4) == 0)return(false);
+            total += static_cast<size_t>(DataStoreBinaryFormat::DecodeFixed(entry + 12, 4));
+        }
+        if (total != sampleCount)return(false);
+        sampleCount_ = sampleCount;
+        blockCount_ = blockCount;
+        startBlock(0);
+        return(true);
+    }
+
+    size_t GetNumberSamples() const
+    {
+        return(sampleCount_);
+    }
+
+    size_t GetNumberBlocks() const
+    {
+        return(blockCount_);
+    }
+
+    //False at the end of the series or if the data is damaged
+    bool Next(boost::int64_t& timestamp, double& value)
+    {
+        while (blockLeft_ == 0)
+        {
+            if (block_ >= blockCount_)return(false);
+            startBlock(block_ + 1);
+        }
+        if (!blockStarted_)
+        {
+            lastTimestamp_ = static_cast<boost::int64_t>(reader_.Read(64));
+            lastBits_ = reader_.Read(64);
+            lastDelta_ = 0;
+            lastLeading_ = 64;
+            lastTrailing_ = 0;
+            blockStarted_ = true;
+        }
+        else
+        {
+            lastDelta_ = static_cast<boost::int64_t>(static_cast<boost::uint64_t>(lastDelta_) + static_cast<boost::uint64_t>(readDeltaOfDelta()));
+            lastTimestamp_ = static_cast<boost::int64_t>(static_cast<boost::uint64_t>(lastTimestamp_) + static_cast<boost::uint64_t>(lastDelta_));
+            readValue();
+        }
+        if (reader_.Overrun())
+        {
+            blockLeft_ = 0;
+            block_ = blockCount_;
+            return(false);
+        }
+        --blockLeft_;
+        timestamp = lastTimestamp_;
+        value = DataStoreBinaryFormat::BitsToDouble(lastBits_);
+        return(true);
+    }
+
+    //Positions Next on the first sample at or after the timestamp; false if there is none
+    bool Seek(boost::int64_t timestamp)
+    {
+        if (blockCount_ == 0)return(false);
+        //Last block starting at or before the timestamp
+        size_t low = 0;
+        size_t high = blockCount_;
+        while (high - low > 1)
+        {
+            size_t mid = (low + high) / 2;
+            if (blockTimestamp(mid) <= timestamp)low = mid;
+            else high = mid;
+        }
+        //Blocks can share a first timestamp when it repeats across a boundary
+        while (low > 0 && blockTimestamp(low) == timestamp)--low;
+        for (size_t block = low; block < blockCount_; ++block)
+        {
+            startBlock(block);
+            boost::int64_t ts = 0;
+            double val = 0;
+            //Decode into a copy of the state so the match can be handed out again by Next
+            while (blockLeft_ > 0)
+            {
+                size_t left = blockLeft_;
+                bool started = blockStarted_;
+                DataStoreSeriesCodec::BitReader reader = reader_;
+                boost::int64_t lastTimestamp = lastTimestamp_;
+                boost::int64_t lastDelta = lastDelta_;
+                boost::uint64_t lastBits = lastBits_;
+                unsigned int lastLeading = lastLeading_;
+                unsigned int lastTrailing = lastTrailing_;
+                if (!Next(ts, val))return(false);
+                if (ts >= timestamp)
+                {
+                    blockLeft_ = left;
+                    blockStarted_ = started;
+                    reader_ = reader;
+                    lastTimestamp_ = lastTimestamp;
+                    lastDelta_ = lastDelta;
+                    lastBits_ = lastBits;
+                    lastLeading_ = lastLeading;
+                    lastTrailing_ = lastTrailing;
+                    return(true);
+                }
+            }
+        }
+        return(false);
+    }
+
+    //Back to the first sample
+    void Rewind()
+    {
+        startBlock(0);
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_SERIES_CODEC_H_
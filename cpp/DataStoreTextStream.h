@@ -0,0 +1,170 @@
+#ifndef DATA_STORE_TEXT_STREAM_H_
+#define DATA_STORE_TEXT_STREAM_H_
+
+#include "UTF8String.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+namespace rct {
+
+//!  Data Store Text Stream
+/*!
+ * Incremental reader for the text data store format.  The file is read in
+ * fixed size blocks and decoded from UTF-8 into a sliding buffer, and whole
+ * records are handed out as they become complete, so memory stays bounded
+ * by the block size plus the largest record instead of the file size.
+ */
+class DataStoreTextStream
+{
+public:
+    static const size_t DefaultBlockSize = 1 << 20;
+private:
+    std::ifstream input_;
+    std::vector<char> block_;
+    //Trailing bytes of an incomplete UTF-8 sequence, carried into the next block
+    std::string pendingBytes_;
+    std::wstring buffer_;
+    size_t pos_;
+    bool eof_;
+private:
+    DataStoreTextStream(const DataStoreTextStream& rhs);
+    void operator=(const DataStoreTextStream& rhs);
+
+    //Length of the prefix that ends on a complete UTF-8 sequence
+    static size_t completeUTF8Prefix(const std::string& bytes)
+    {
+        size_t size = bytes.size();
+        for (size_t back = 1; back <= 4 && back <= size; ++back)
+        {
+            unsigned char ch = static_cast<unsigned char>(bytes[size - back]);
+            if ((ch & 0xC0) == 0x80)continue;
+            size_t seqLen = (ch < 0x80) ? 1 : ((ch & 0xE0) == 0xC0) ? 2 : ((ch & 0xF0) == 0xE0) ? 3 : 4;
+            return((seqLen > back) ? size - back : size);
+        }
+        return(size);
+    }
+
+    bool fillBuffer()
+    {
+        if (eof_)return(false);
+        input_.read(&block_[0], block_.size());
+        size_t got = static_cast<size_t>(input_.gcount());
+        if (got < block_.size())eof_ = true;
+        pendingBytes_.append(&block_[0], got);
+        size_t complete = eof_ ? pendingBytes_.size() : completeUTF8Prefix(pendingBytes_);
+        //Drop the text already handed out before growing the buffer
+        if (pos_ > 0)
+        {
+            buffer_.erase(0, pos_);
+            pos_ = 0;
+        }
+        if (complete > 0)
+        {
+            buffer_ += rct::UTF8String(pendingBytes_.substr(0, complete)).str();
+            pendingBytes_.erase(0, complete);
+        }
+        return(true);
+    }
+public:
+    explicit DataStoreTextStream(size_t blockSize = DefaultBlockSize) :
+        block_(std::max<size_t>(blockSize, 16)),
+        pos_(0),
+        eof_(false)
+    {}
+
+    //Record header lines ("id|props|objs|") are the only lines that start with a digit
+    static size_t FindRecordBoundary(const std::wstring& text, size_t pos)
+    {
+        for (; pos + 1 < text.size(); ++pos)
+        {
+            if (text[pos] == L'\n' && text[pos + 1] >= L'0' && text[pos + 1] <= L'9')return(pos + 1);
+        }
+        return(text.size());
+    }
+
+    //Opens the file and reads the record count from the first line
+    bool Open(const std::string& fileName, unsigned long& recordCount)
+    {
+        Close();
+        input_.open(fileName.c_str(), std::ios::in | std::ios::binary);
+        if (!input_.is_open())return(false);
+        std::wstring firstLine;
+        if (!ReadLine(firstLine))return(false);
+        recordCount = 0;
+        size_t i = 0;
+        for (; i < firstLine.size() && firstLine[i] >= L'0' && firstLine[i] <= L'9'; ++i)
+        {
+            recordCount = recordCount * 10 + (firstLine[i] - L'0');
+        }
+        return(i > 0);
+    }
+
+    void Close()
+    {
+        if (input_.is_open())input_.close();
+        input_.clear();
+        pendingBytes_.clear();
+        buffer_.clear();
+        pos_ = 0;
+        eof_ = false;
+    }
+
+    bool ReadLine(std::wstring& line)
+    {
+        for (;;)
+        {
+            size_t lineEnd = buffer_.find(L'\n', pos_);
+            if (lineEnd != std::wstring::npos)
+            {
+                line.assign(buffer_, pos_, lineEnd - pos_);
+                if (!line.empty() && line[line.size() - 1] == L'\r')line.erase(line.size() - 1);
+                pos_ = lineEnd + 1;
+                return(true);
+            }
+            if (!fillBuffer())
+            {
+                if (pos_ >= buffer_.size())return(false);
+                line.assign(buffer_, pos_, std::wstring::npos);
+                pos_ = buffer_.size();
+                return(true);
+            }
+        }
+    }
+
+    //Hands out whole records, at least one and roughly maxChars worth; false once the file is exhausted
+    bool ReadRecords(std::wstring& text, size_t maxChars)
+    {
+        text.clear();
+        for (;;)
+        {
+            size_t start = buffer_.find_first_not_of(L" \t\r\n", pos_);
+            if (start == std::wstring::npos)
+            {
+                pos_ = buffer_.size();
+                if (!fillBuffer())return(false);
+                continue;
+            }
+            pos_ = start;
+            size_t cut = FindRecordBoundary(buffer_, pos_ + std::max<size_t>(maxChars, 1) - 1);
+            if (cut < buffer_.size())
+            {
+                text.assign(buffer_, pos_, cut - pos_);
+                pos_ = cut;
+                return(true);
+            }
+            if (!fillBuffer())
+            {
+                //End of file - the rest is the last record
+                text.assign(buffer_, pos_, std::wstring::npos);
+                pos_ = buffer_.size();
+                return(true);
+            }
+        }
+    }
+};
+
+} //namespace rct
+
+#endif //DATA_STORE_TEXT_STREAM_H_
@@ -0,0 +1,446 @@
+#ifndef POINT_DATA_INGEST_H_
+#define POINT_DATA_INGEST_H_
+
+#include "PointSeriesStore.h"
+#include "UTF8String.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <boost/cstdint.hpp>
+
+namespace rct {
+
+//!  Point Data Ingest
+/*!
+ * Streaming parser for the bulk point data payload of the point-data
+ * endpoint, {"pointData":[{"id":..,"value":..,"quality":..,"timestamp":..}]},
+ * the C++ counterpart of processPointDataBulkJSON in js/PointDataGen.js.
+ * Input arrives in pieces through Feed and every sample goes into the
+ * PointSeriesStore as soon as its object is complete, under the ingest's
+ * site and the sample's id as the point; no document tree is built and
+ * only an unfinished sample is carried between pieces.  Ids may be numbers
+ * or digit strings, values numbers or numeric strings, and timestamps
+ * YYYY-MM-DDTHH:mm:ss.SSS.  Samples missing any of them, or with a null
+ * value, are counted as skipped; quality and unknown keys are ignored.
+ */
+class PointDataIngest
+{
+public:
+    static const size_t ReadBlockSize = 256 * 1024;
+private:
+    typedef enum ParseStatus
+    {
+        PARSE_OK,
+        //The input ends inside the current token; wait for the next piece
+        PARSE_MORE,
+        PARSE_ERROR
+    };
+
+    typedef enum ParseState
+    {
+        STATE_START,
+        STATE_KEY,
+        STATE_AFTER_VALUE,
+        STATE_ARRAY,
+        STATE_AFTER_SAMPLE,
+        STATE_DONE,
+        STATE_ERROR
+    };
+private:
+    PointSeriesStore& store_;
+    boost::int64_t site_;
+    std::string buffer_;
+    size_t pos_;
+    ParseState state_;
+    //Set by Finish - a number may then end the input
+    bool lastPiece_;
+    size_t samples_;
+    size_t skipped_;
+private:
+    PointDataIngest(const PointDataIngest& rhs);
+    void operator=(const PointDataIngest& rhs);
+
+    static bool isSpace(char ch)
+    {
+        return(ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+    }
+
+    static bool isDigit(char ch)
+    {
+        return(ch >= '0' && ch <= '9');
+    }
+
+    void skipSpace(size_t& pos) const
+    {
+        while (pos < buffer_.size() && isSpace(buffer_[pos]))++pos;
+    }
+
+    //Moves past the next non space character if it is the expected one
+    ParseStatus expect(size_t& pos, char ch) const
+    {
+        skipSpace(pos);
+        if (pos >= buffer_.size())return(PARSE_MORE);
+        if (buffer_[pos] != ch)return(PARSE_ERROR);
+        ++pos;
+        return(PARSE_OK);
+    }
+
+    //String at pos; [begin, end) is its raw content, escapes left in place
+    ParseStatus scanString(size_t& pos, size_t& begin, size_t& end, bool& escaped) const
+    {
+        if (buffer_[pos] != '"')return(PARSE_ERROR);
+        escaped = false;
+        for (size_t cur = pos + 1; cur < buffer_.size(); ++cur)
+        {
+            if (buffer_[cur] == '\\')
+            {
+                escaped = true;
+                ++cur;
+            }
+            else if (buffer_[cur] == '"')
+            {
+                begin = pos + 1;
+                end = cur;
+                pos = cur + 1;
+                return(PARSE_OK);
+            }
+        }
+        return(PARSE_MORE);
+    }
+
+    //Number or literal at pos; it is only known to be complete once something follows it
+    ParseStatus scanScalar(size_t& pos, size_t& begin, size_t& end) const
+    {
+        size_t cur = pos;
+        while (cur < buffer_.size() && buffer_[cur] != 0 && (isDigit(buffer_[cur]) || std::strchr("+-.eEtrufalsn", buffer_[cur]) != nullptr))++cur;
+        if (cur == pos)return((cur < buffer_.size()) ? PARSE_ERROR : PARSE_MORE);
+        if (cur == buffer_.size() && !lastPiece_)return(PARSE_MORE);
+        begin = pos;
+        end = cur;
+        pos = cur;
+        return(PARSE_OK);
+    }
+
+    //Any value, nested objects and arrays included
+    ParseStatus skipValue(size_t& pos) const
+    {
+        skipSpace(pos);
+        if (pos >= buffer_.size())return(PARSE_MORE);
+        size_t begin, end;
+        bool escaped;
+        if (buffer_[pos] == '"')return(scanString(pos, begin, end, escaped));
+        if (buffer_[pos] != '{' && buffer_[pos] != '[')return(scanScalar(pos, begin, end));
+        size_t depth = 0;
+        while (pos < buffer_.size())
+        {
+            char ch = buffer_[pos];
+            if (ch == '"')
+            {
+                ParseStatus status = scanString(pos, begin, end, escaped);
+                if (status != PARSE_OK)return(status);
+                continue;
+            }
+            if (ch == '{' || ch == '[')++depth;
+            else if (ch == '}' || ch == ']')
+            {
+                if (--depth == 0)
+                {
+                    ++pos;
+                    return(PARSE_OK);
+                }
+            }
+            ++pos;
+        }
+        return(PARSE_MORE);
+    }
+
+    bool keyIs(size_t begin, size_t end, const char* key) const
+    {
+        size_t len = std::strlen(key);
+        return(end - begin == len && buffer_.compare(begin, len, key) == 0);
+    }
+
+    static bool parseInt64(const char* text, size_t size, boost::int64_t& val)
+    {
+        size_t pos = 0;
+        bool negative = (size > 0 && text[0] == '-');
+        if (negative)++pos;
+        if (pos == size || size - pos > 18)return(false);
+        boost::int64_t rt = 0;
+        for (; pos < size; ++pos)
+        {
+            if (!isDigit(text[pos]))return(false);
+            rt = rt * 10 + (text[pos] - '0');
+        }
+        val = negative ? -rt : rt;
+        return(true);
+    }
+
+    //The whole text must be the number
+    static bool parseDouble(const char* text, size_t size, double& val)
+    {
+        char local[64];
+        if (size == 0 || size >= sizeof(local))return(false);
+        std::memcpy(local, text, size);
+        local[size] = 0;
+        char* stop = nullptr;
+        val = std::strtod(local, &stop);
+        return(stop == local + size);
+    }
+
+    //One element of the pointData array; a well formed sample that cannot be stored is skipped
+    ParseStatus parseSample(size_t& pos)
+    {
+        ParseStatus status = expect(pos, '{');
+        if (status != PARSE_OK)return(status);
+        boost::int64_t id = 0, timestamp = 0;
+        double value = 0;
+        bool hasId = false, hasValue = false, hasTimestamp = false;
+        skipSpace(pos);
+        if (pos < buffer_.size() && buffer_[pos] == '}')
+        {
+            ++pos;
+            ++skipped_;
+            return(PARSE_OK);
+        }
+        for (;;)
+        {
+            skipSpace(pos);
+            if (pos >= buffer_.size())return(PARSE_MORE);
+            size_t keyBegin, keyEnd, begin, end;
+            bool escaped;
+            status = scanString(pos, keyBegin, keyEnd, escaped);
+            if (status != PARSE_OK)return(status);
+            if ((status = expect(pos, ':')) != PARSE_OK)return(status);
+            skipSpace(pos);
+            if (pos >= buffer_.size())return(PARSE_MORE);
+            bool isString = (buffer_[pos] == '"');
+            bool wanted = keyIs(keyBegin, keyEnd, "id") || keyIs(keyBegin, keyEnd, "value") || keyIs(keyBegin, keyEnd, "timestamp");
+            if (!wanted || buffer_[pos] == '{' || buffer_[pos] == '[')
+            {
+                if ((status = skipValue(pos)) != PARSE_OK)return(status);
+            }
+            else
+            {
+                status = isString ? scanString(pos, begin, end, escaped) : scanScalar(pos, begin, end);
+                if (status != PARSE_OK)return(status);
+                const char* text = buffer_.data() + begin;
+                if (keyIs(keyBegin, keyEnd, "id"))hasId = parseInt64(text, end - begin, id);
+                else if (keyIs(keyBegin, keyEnd, "value"))hasValue = parseDouble(text, end - begin, value);
+                else hasTimestamp = isString && ParseTimestamp(text, end - begin, timestamp);
+            }
+            skipSpace(pos);
+            if (pos >= buffer_.size())return(PARSE_MORE);
+            if (buffer_[pos] == ',')
+            {
+                ++pos;
+                continue;
+            }
+            if (buffer_[pos] != '}')return(PARSE_ERROR);
+            ++pos;
+            break;
+        }
+        if (hasId && hasValue && hasTimestamp)
+        {
+            store_.SetValue(site_, id, timestamp, value);
+            ++samples_;
+        }
+        else ++skipped_;
+        return(PARSE_OK);
+    }
+
+    //Consumes one token or one whole sample; on PARSE_MORE nothing is consumed
+    ParseStatus step(size_t& pos, ParseState& next)
+    {
+        skipSpace(pos);
+        if (pos >= buffer_.size())return(PARSE_MORE);
+        char ch = buffer_[pos];
+        switch (state_)
+        {
+        case STATE_START:
+            if (ch != '{')return(PARSE_ERROR);
+            ++pos;
+            next = STATE_KEY;
+            return(PARSE_OK);
+        case STATE_KEY:
+        {
+            if (ch == '}')
+            {
+                ++pos;
+                next = STATE_DONE;
+                return(PARSE_OK);
+            }
+            size_t begin, end;
+            bool escaped;
+            ParseStatus status = scanString(pos, begin, end, escaped);
+            if (status != PARSE_OK)return(status);
+            if ((status = expect(pos, ':')) != PARSE_OK)return(status);
+            skipSpace(pos);
+            if (pos >= buffer_.size())return(PARSE_MORE);
+            if (keyIs(begin, end, "pointData") && buffer_[pos] == '[')
+            {
+                ++pos;
+                next = STATE_ARRAY;
+                return(PARSE_OK);
+            }
+            next = STATE_AFTER_VALUE;
+            return(skipValue(pos));
+        }
+        case STATE_AFTER_VALUE:
+            if (ch != ',' && ch != '}')return(PARSE_ERROR);
+            ++pos;
+            next = (ch == ',') ? STATE_KEY : STATE_DONE;
+            return(PARSE_OK);
+        case STATE_ARRAY:
+            if (ch == ']')
+            {
+                ++pos;
+                next = STATE_AFTER_VALUE;
+                return(PARSE_OK);
+            }
+            next = STATE_AFTER_SAMPLE;
+            if (ch == '{')return(parseSample(pos));
+            //Nulls and other stray values in the array
+            ++skipped_;
+            return(skipValue(pos));
+        case STATE_AFTER_SAMPLE:
+            if (ch != ',' && ch != ']')return(PARSE_ERROR);
+            ++pos;
+            next = (ch == ',') ? STATE_ARRAY : STATE_AFTER_VALUE;
+            return(PARSE_OK);
+        default:
+            return(PARSE_ERROR);
+        }
+    }
+
+    bool run()
+    {
+        while (state_ != STATE_DONE && state_ != STATE_ERROR)
+        {
+            size_t pos = pos_;
+            ParseState next = state_;
+            size_t skipped = skipped_;
+            ParseStatus status = step(pos, next);
+            if (status == PARSE_MORE)
+            {
+                //A stray value counted before it turned out to be incomplete
+                skipped_ = skipped;
+                break;
+            }
+            if (status == PARSE_ERROR)state_ = STATE_ERROR;
+            else
+            {
+                pos_ = pos;
+                state_ = next;
+            }
+        }
+        if (state_ == STATE_DONE)
+        {
+            skipSpace(pos_);
+            if (pos_ < buffer_.size())state_ = STATE_ERROR;
+        }
+        //Drop what has been parsed once it is most of the buffer
+        if (pos_ > 0 && pos_ * 2 >= buffer_.size())
+        {
+            buffer_.erase(0, pos_);
+            pos_ = 0;
+        }
+        return(state_ != STATE_ERROR);
+    }
+public:
+    PointDataIngest(PointSeriesStore& store, boost::int64_t site) : store_(store), site_(site)
+    {
+        Reset();
+    }
+
+    //Ready for a new payload; the samples already stored stay in the store
+    void Reset()
+    {
+        buffer_.clear();
+        pos_ = 0;
+        state_ = STATE_START;
+        lastPiece_ = false;
+        samples_ = 0;
+        skipped_ = 0;
+    }
+
+    //False once the input is malformed; samples before the error are already stored
+    bool Feed(const char* data, size_t size)
+    {
+        if (state_ == STATE_ERROR)return(false);
+        buffer_.append(data, size);
+        return(run());
+    }
+
+    //True if the input formed a whole payload
+    bool Finish()
+    {
+        lastPiece_ = true;
+        run();
+        return(state_ == STATE_DONE);
+    }
+
+    bool IngestFile(const rct::UTF8String& fileName)
+    {
+        std::ifstream input(fileName.nstr().c_str(), std::ios::in | std::ios::binary);
+        if (!input.is_open())return(false);
+        std::vector<char> block(ReadBlockSize);
+        while (input)
+        {
+            input.read(&block[0], block.size());
+            size_t got = static_cast<size_t>(input.gcount());
+            if (got > 0 && !Feed(&block[0], got))return(false);
+        }
+        return(Finish());
+    }
+
+    size_t GetNumberSamples() const
+    {
+        return(samples_);
+    }
+
+    size_t GetNumberSkipped() const
+    {
+        return(skipped_);
+    }
+
+    //YYYY-MM-DDTHH:mm:ss.SSS, or without the milliseconds, as milliseconds since the epoch
+    static bool ParseTimestamp(const char* text, size_t size, boost::int64_t& timestamp)
+    {
+        if (size != 23 && size != 19)return(false);
+        static const char pattern[] = "dddd-dd-ddTdd:dd:dd.ddd";
+        int fields[7] = { 0 };
+        int field = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (pattern[i] != 'd')
+            {
+                if (text[i] != pattern[i])return(false);
+                ++field;
+                continue;
+            }
+            if (!isDigit(text[i]))return(false);
+            fields[field] = fields[field] * 10 + (text[i] - '0');
+        }
+        int year = fields[0], month = fields[1], day = fields[2];
+        static const int monthDays[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        if (month < 1 || month > 12 || day < 1 || day > monthDays[month - 1] || (month == 2 && day == 29 && !leap))return(false);
+        if (fields[3] > 23 || fields[4] > 59 || fields[5] > 59)return(false);
+        //Days since 1970-01-01, proleptic Gregorian
+        boost::int64_t y = year - (month <= 2 ? 1 : 0);
+        boost::int64_t era = (y >= 0 ? y : y - 399) / 400;
+        boost::int64_t yearOfEra = y - era * 400;
+        boost::int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        boost::int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        boost::int64_t days = era * 146097 + dayOfEra - 719468;
+        timestamp = ((days * 24 + fields[3]) * 60 + fields[4]) * 60000 + fields[5] * 1000 + fields[6];
+        return(true);
+    }
+};
+
+} //namespace rct
+
+#endif //POINT_DATA_INGEST_H_
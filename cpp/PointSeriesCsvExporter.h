@@ -0,0 +1,252 @@
+#ifndef POINT_SERIES_CSV_EXPORTER_H_
+#define POINT_SERIES_CSV_EXPORTER_H_
+
+#include "PointSeriesStore.h"
+#include "UTF8String.h"
+#include <queue>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <ostream>
+#include <functional>
+#include <boost/cstdint.hpp>
+
+namespace rct {
+
+//!  Point Series CSV Exporter
+/*!
+ * Writes several point series side by side as CSV, the C++ counterpart of
+ * ruby/point_data_csv_serializer.rb: one "time" column followed by one
+ * column per series, and one row for every timestamp any series has a
+ * value at; series without a value there leave their cell empty.  Series
+ * are read a day at a time and merged on timestamp through a min heap, so
+ * a row costs O(log series) and memory stays at a day per series however
+ * long the range.  Output is collected in a buffer of FlushSize bytes and
+ * written to the stream in large pieces.
+ */
+class PointSeriesCsvExporter
+{
+public:
+    typedef DataStore::DataStr DataStr;
+    static const size_t FlushSize = 1 << 20;
+private:
+    //Samples of one series in the export range, fetched a day at a time
+    struct Cursor
+    {
+        PointSeriesStore::SeriesId id_;
+        std::vector<boost::int64_t> days_;
+        size_t nextDay_;
+        std::vector<PointSeriesStore::Sample> samples_;
+        size_t pos_;
+    };
+
+    struct HeapEntry
+    {
+        boost::int64_t timestamp_;
+        size_t series_;
+
+        bool operator>(const HeapEntry& rhs) const
+        {
+            return(timestamp_ > rhs.timestamp_ || (timestamp_ == rhs.timestamp_ && series_ > rhs.series_));
+        }
+    };
+
+    typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> MergeHeap;
+private:
+    const PointSeriesStore& store_;
+    std::vector<PointSeriesStore::SeriesId> series_;
+    std::vector<DataStr> names_;
+    int precision_;
+    std::string buffer_;
+private:
+    PointSeriesCsvExporter(const PointSeriesCsvExporter& rhs);
+    void operator=(const PointSeriesCsvExporter& rhs);
+
+    //Moves the cursor to its next sample, loading the next day with samples in the range if needed
+    bool advance(Cursor& cursor, boost::int64_t from, boost::int64_t to) const
+    {
+        if (++cursor.pos_ < cursor.samples_.size())return(true);
+        while (cursor.nextDay_ < cursor.days_.size())
+        {
+            boost::int64_t dayStart = cursor.days_[cursor.nextDay_++];
+            cursor.samples_.clear();
+            cursor.pos_ = 0;
+            store_.GetRange(cursor.id_.site_, cursor.id_.point_, std::max(from, dayStart), std::min(to, dayStart + PointSeriesStore::MsPerDay), cursor.samples_);
+            if (!cursor.samples_.empty())return(true);
+        }
+        return(false);
+    }
+
+    void appendCell(const DataStr& text)
+    {
+        std::string utf8 = rct::UTF8String(text).nstr();
+        if (utf8.find_first_of(",\"\r\n") == std::string::npos)
+        {
+            buffer_ += utf8;
+            return;
+        }
+        buffer_ += '"';
+        for (size_t i = 0; i < utf8.size(); ++i)
+        {
+            if (utf8[i] == '"')buffer_ += '"';
+            buffer_ += utf8[i];
+        }
+        buffer_ += '"';
+    }
+
+    //YYYY-MM-DDTHH:mm:ss.SSS, the format of the point data feeds
+    void appendTimestamp(boost::int64_t timestamp)
+    {
+        boost::int64_t day = PointSeriesStore::DayStart(timestamp) / PointSeriesStore::MsPerDay;
+        boost::int64_t msOfDay = timestamp - day * PointSeriesStore::MsPerDay;
+        //Civil date from days since 1970-01-01, proleptic Gregorian
+        boost::int64_t shifted = day + 719468;
+        boost::int64_t era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+        boost::int64_t dayOfEra = shifted - era * 146097;
+        boost::int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        boost::int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        boost::int64_t monthIdx = (5 * dayOfYear + 2) / 153;
+        int dayOfMonth = static_cast<int>(dayOfYear - (153 * monthIdx + 2) / 5 + 1);
+        int month = static_cast<int>(monthIdx < 10 ? monthIdx + 3 : monthIdx - 9);
+        long long year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+        char text[48];
+        int len = std::snprintf(text, sizeof(text), "%04lld-%02d-%02dT%02d:%02d:%02d.%03d", year, month, dayOfMonth,
+            static_cast<int>(msOfDay / 3600000), static_cast<int>(msOfDay / 60000 % 60), static_cast<int>(msOfDay / 1000 % 60), static_cast<int>(msOfDay % 1000));
+        buffer_.append(text, len);
+    }
+
+    //Rounded to the precision without trailing zeros, as the Ruby export printed them.  Values too
+    //long for fixed notation, |value| around 1e60 and up or a large precision, come out in %g form
+    void appendValue(double value)
+    {
+        char text[64];
+        int len = std::snprintf(text, sizeof(text), "%.*f", precision_, value);
+        if (len >= static_cast<int>(sizeof(text)))
+        {
+            //15 digits when they read back as the same double, else the 17 that always do
+            len = std::snprintf(text, sizeof(text), "%.15g", value);
+            if (std::strtod(text, NULL) != value)len = std::snprintf(text, sizeof(text), "%.17g", value);
+            if (len > 0)buffer_.append(text, len);
+            return;
+        }
+        if (len <= 0)return;
+        if (precision_ > 0)
+        {
+            while (text[len - 1] == '0')--len;
+            if (text[len - 1] == '.')--len;
+        }
+        //Values that round to zero lose their sign
+        if (len == 2 && text[0] == '-' && text[1] == '0')
+        {
+            text[0] = '0';
+            len = 1;
+        }
+        buffer_.append(text, len);
+    }
+
+    bool flush(std::ostream& output, bool force)
+    {
+        if (buffer_.size() < FlushSize && !force)return(true);
+        output.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return(output.good());
+    }
+public:
+    explicit PointSeriesCsvExporter(const PointSeriesStore& store) : store_(store), precision_(2) {}
+
+    //Columns come out in the order the series were added
+    void AddSeries(boost::int64_t site, boost::int64_t point, const DataStr& name)
+    {
+        series_.push_back(PointSeriesStore::SeriesId(site, point));
+        names_.push_back(name);
+    }
+
+    //Decimal places values are rounded to, two by default
+    void SetPrecision(int precision)
+    {
+        precision_ = (precision < 0) ? 0 : precision;
+    }
+
+    //Rows for the timestamps with from <= timestamp < to
+    bool Export(std::ostream& output, boost::int64_t from, boost::int64_t to)
+    {
+        buffer_.clear();
+        buffer_.reserve(FlushSize + 4096);
+        buffer_ += "time";
+        for (size_t i = 0; i < names_.size(); ++i)
+        {
+            buffer_ += ',';
+            appendCell(names_[i]);
+        }
+        buffer_ += '\n';
+
+        std::vector<Cursor> cursors(series_.size());
+        MergeHeap heap;
+        for (size_t i = 0; i < series_.size(); ++i)
+        {
+            Cursor& cursor = cursors[i];
+            cursor.id_ = series_[i];
+            std::vector<boost::int64_t> days;
+            store_.GetDays(cursor.id_.site_, cursor.id_.point_, days);
+            for (size_t d = 0; d < days.size(); ++d)
+            {
+                if (days[d] + PointSeriesStore::MsPerDay > from && days[d] < to)cursor.days_.push_back(days[d]);
+            }
+            cursor.nextDay_ = 0;
+            cursor.pos_ = 0;
+            if (!advance(cursor, from, to))continue;
+            HeapEntry entry = { cursor.samples_[cursor.pos_].timestamp_, i };
+            heap.push(entry);
+        }
+
+        //Series with a value in the current row, in column order since the heap breaks ties by series
+        std::vector<size_t> rowSeries;
+        rowSeries.reserve(series_.size());
+        while (!heap.empty())
+        {
+            boost::int64_t timestamp = heap.top().timestamp_;
+            rowSeries.clear();
+            while (!heap.empty() && heap.top().timestamp_ == timestamp)
+            {
+                rowSeries.push_back(heap.top().series_);
+                heap.pop();
+            }
+            appendTimestamp(timestamp);
+            size_t next = 0;
+            for (size_t i = 0; i < series_.size(); ++i)
+            {
+                buffer_ += ',';
+                if (next < rowSeries.size() && rowSeries[next] == i)
+                {
+                    Cursor& cursor = cursors[i];
+                    appendValue(cursor.samples_[cursor.pos_].value_);
+                    ++next;
+                    if (advance(cursor, from, to))
+                    {
+                        HeapEntry entry = { cursor.samples_[cursor.pos_].timestamp_, i };
+                        heap.push(entry);
+                    }
+                }
+            }
+            buffer_ += '\n';
+            if (!flush(output, false))return(false);
+        }
+        return(flush(output, true));
+    }
+
+    bool Export(const rct::UTF8String& fileName, boost::int64_t from, boost::int64_t to)
+    {
+        std::ofstream output(fileName.nstr().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!output.is_open())return(false);
+        if (!Export(output, from, to))return(false);
+        output.close();
+        return(!output.fail());
+    }
+};
+
+} //namespace rct
+
+#endif //POINT_SERIES_CSV_EXPORTER_H_
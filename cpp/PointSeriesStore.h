@@ -0,0 +1,620 @@
+#ifndef POINT_SERIES_STORE_H_
+#define POINT_SERIES_STORE_H_
+
+#include "DataStore.h"
+#include "DataStoreBinaryFormat.h"
+#include "DataStoreSeriesCodec.h"
+#include <map>
+#include <set>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+
+namespace rct {
+
+//!  Point Series Store
+/*!
+ * Minute resolution values of building automation points, the in process
+ * counterpart of the point data documents built by js/PointDataGen.js.
+ * Every site/point/day gets one fixed size DayBlock holding a value and a
+ * presence bit for each of the 1440 minutes, so a sample write is a hash
+ * lookup and two stores and nothing is allocated once the day exists.
+ * Blocks are carved from chunks of BlocksPerChunk and stay put until
+ * Clear.  Timestamps are milliseconds since the Unix epoch, like DataStore
+ * timestamp columns, in the time zone of the feed; the seconds of a
+ * sample are dropped.  Save and Load go through a DataStore with one
+ * record per day block, the samples in an object column encoded with
+ * DataStoreSeriesCodec.
+ * With EnableRollups every day also keeps count, sum, min and max per 5
+ * minutes, per hour and for the whole day, updated as samples are
+ * written, and GetRollups answers from the coarsest tier that meets the
+ * requested resolution.
+ */
+class PointSeriesStore
+{
+public:
+    static const size_t MinutesPerDay = 1440;
+    static const size_t PresenceWords = (MinutesPerDay + 63) / 64;
+    static const boost::int64_t MsPerMinute = 60 * 1000;
+    static const boost::int64_t MsPerDay = static_cast<boost::int64_t>(MinutesPerDay) * MsPerMinute;
+    static const size_t BlocksPerChunk = 64;
+
+    //One site/point/day; values of absent minutes are zero
+    struct DayBlock
+    {
+        double values_[MinutesPerDay];
+        boost::uint64_t present_[PresenceWords];
+
+        bool HasValue(size_t minute) const
+        {
+            return((present_[minute / 64] >> (minute % 64)) & 1);
+        }
+
+        size_t GetNumberValues() const
+        {
+            size_t rt = 0;
+            for (size_t i = 0; i < PresenceWords; ++i)
+            {
+                for (boost::uint64_t word = present_[i]; word != 0; word &= word - 1)++rt;
+            }
+            return(rt);
+        }
+    };
+
+    struct SeriesId
+    {
+        boost::int64_t site_;
+        boost::int64_t point_;
+        SeriesId(boost::int64_t site = 0, boost::int64_t point = 0) : site_(site), point_(point) {}
+
+        bool operator<(const SeriesId& rhs) const
+        {
+            return(site_ < rhs.site_ || (site_ == rhs.site_ && point_ < rhs.point_));
+        }
+    };
+
+    struct Sample
+    {
+        boost::int64_t timestamp_;
+        double value_;
+    };
+
+    typedef enum RollupTier
+    {
+        ROLLUP_MINUTE,
+        ROLLUP_5_MINUTES,
+        ROLLUP_HOUR,
+        ROLLUP_DAY
+    };
+
+    //Summary of the samples in [timestamp_, timestamp_ + width_); min and max are only set with a count
+    struct Bucket
+    {
+        boost::int64_t timestamp_;
+        boost::int64_t width_;
+        size_t count_;
+        double sum_;
+        double min_;
+        double max_;
+
+        double GetAverage() const
+        {
+            return((count_ == 0) ? 0 : sum_ / static_cast<double>(count_));
+        }
+    };
+private:
+    struct Aggregate
+    {
+        boost::uint32_t count_;
+        double sum_;
+        double min_;
+        double max_;
+
+        void Add(double value)
+        {
+            if (count_ == 0 || value < min_)min_ = value;
+            if (count_ == 0 || value > max_)max_ = value;
+            sum_ += value;
+            ++count_;
+        }
+
+        void Merge(const Aggregate& other)
+        {
+            if (other.count_ == 0)return;
+            if (count_ == 0 || other.min_ < min_)min_ = other.min_;
+            if (count_ == 0 || other.max_ > max_)max_ = other.max_;
+            sum_ += other.sum_;
+            count_ += other.count_;
+        }
+    };
+
+    //Rollup tiers of one DayBlock
+    struct RollupBlock
+    {
+        Aggregate fiveMinutes_[MinutesPerDay / 5];
+        Aggregate hours_[24];
+        Aggregate day_;
+    };
+private:
+    //Days are counted from the epoch
+    struct DayKey
+    {
+        boost::int64_t site_;
+        boost::int64_t point_;
+        boost::int64_t day_;
+
+        bool operator==(const DayKey& rhs) const
+        {
+            return(site_ == rhs.site_ && point_ == rhs.point_ && day_ == rhs.day_);
+        }
+    };
+
+    struct DayKeyHash
+    {
+        size_t operator()(const DayKey& key) const
+        {
+            size_t seed = 0;
+            boost::hash_combine(seed, key.site_);
+            boost::hash_combine(seed, key.point_);
+            boost::hash_combine(seed, key.day_);
+            return(seed);
+        }
+    };
+
+    //Position of each block in the chunks
+    typedef std::unordered_map<DayKey, size_t, DayKeyHash> BlockMap;
+    typedef std::map<SeriesId, std::set<boost::int64_t>> SeriesMap;
+private:
+    BlockMap blocks_;
+    //Days of each series in order, for range reads and Save
+    SeriesMap series_;
+    std::vector<DayBlock*> chunks_;
+    size_t blockCount_;
+    //Rollups of each block at the same position as the block; empty unless EnableRollups was called
+    std::vector<RollupBlock*> rollupChunks_;
+    bool rollupsEnabled_;
+private:
+    PointSeriesStore(const PointSeriesStore& rhs);
+    void operator=(const PointSeriesStore& rhs);
+
+    static boost::int64_t floorDiv(boost::int64_t val, boost::int64_t div)
+    {
+        boost::int64_t rt = val / div;
+        if (val % div != 0 && val < 0)--rt;
+        return(rt);
+    }
+
+    static DayKey dayKey(boost::int64_t site, boost::int64_t point, boost::int64_t day)
+    {
+        DayKey key;
+        key.site_ = site;
+        key.point_ = point;
+        key.day_ = day;
+        return(key);
+    }
+
+    DayBlock* blockAt(size_t idx) const
+    {
+        return(&chunks_[idx / BlocksPerChunk][idx % BlocksPerChunk]);
+    }
+
+    RollupBlock* rollupAt(size_t idx) const
+    {
+        return(rollupsEnabled_ ? &rollupChunks_[idx / BlocksPerChunk][idx % BlocksPerChunk] : nullptr);
+    }
+
+    //False if the point has no block for the day
+    bool findBlock(boost::int64_t site, boost::int64_t point, boost::int64_t day, size_t& idx) const
+    {
+        BlockMap::const_iterator iFind = blocks_.find(dayKey(site, point, day));
+        if (iFind == blocks_.end())return(false);
+        idx = iFind->second;
+        return(true);
+    }
+
+    DayBlock* findBlock(boost::int64_t site, boost::int64_t point, boost::int64_t day) const
+    {
+        size_t idx = 0;
+        return(findBlock(site, point, day, idx) ? blockAt(idx) : nullptr);
+    }
+
+    size_t newBlock(boost::int64_t site, boost::int64_t point, boost::int64_t day)
+    {
+        if (blockCount_ == chunks_.size() * BlocksPerChunk)
+        {
+            chunks_.push_back(new DayBlock[BlocksPerChunk]);
+            if (rollupsEnabled_)rollupChunks_.push_back(new RollupBlock[BlocksPerChunk]);
+        }
+        size_t rt = blockCount_++;
+        std::memset(blockAt(rt), 0, sizeof(DayBlock));
+        if (rollupsEnabled_)std::memset(rollupAt(rt), 0, sizeof(RollupBlock));
+        blocks_[dayKey(site, point, day)] = rt;
+        series_[SeriesId(site, point)].insert(day);
+        return(rt);
+    }
+
+    static Aggregate rawAggregate(const DayBlock* block, size_t firstMinute, size_t minutes)
+    {
+        Aggregate rt = Aggregate();
+        for (size_t minute = firstMinute; minute < firstMinute + minutes; ++minute)
+        {
+            if (block->HasValue(minute))rt.Add(block->values_[minute]);
+        }
+        return(rt);
+    }
+
+    //Recomputes the buckets holding the minute after a value there was replaced or cleared
+    static void refreshRollups(const DayBlock* block, size_t minute, RollupBlock* rollup)
+    {
+        rollup->fiveMinutes_[minute / 5] = rawAggregate(block, minute / 5 * 5, 5);
+        size_t hour = minute / 60;
+        rollup->hours_[hour] = Aggregate();
+        for (size_t i = hour * 12; i < hour * 12 + 12; ++i)rollup->hours_[hour].Merge(rollup->fiveMinutes_[i]);
+        rollup->day_ = Aggregate();
+        for (size_t i = 0; i < 24; ++i)rollup->day_.Merge(rollup->hours_[i]);
+    }
+
+    static void buildRollups(const DayBlock* block, RollupBlock* rollup)
+    {
+        std::memset(rollup, 0, sizeof(RollupBlock));
+        for (size_t i = 0; i < MinutesPerDay / 5; ++i)
+        {
+            rollup->fiveMinutes_[i] = rawAggregate(block, i * 5, 5);
+            rollup->hours_[i / 12].Merge(rollup->fiveMinutes_[i]);
+        }
+        for (size_t i = 0; i < 24; ++i)rollup->day_.Merge(rollup->hours_[i]);
+    }
+
+    //False unless the column holds exactly count words
+    static bool decodeWords(const DataStore::DataStoreRecord* record, DataStoreSchema::ColumnId id, size_t count, boost::uint64_t* words)
+    {
+        DataStore::DataStoreRecord::RecordResult result(nullptr);
+        if (record->GetColumnType(id) != DATASTORE_VALUE_BYTES || !record->GetColumn(id, std::move(result)))return(false);
+        if (result.GetObjectSize() != count * 8)return(false);
+        const unsigned char* data = static_cast<const unsigned char*>(result.GetObjectData());
+        for (size_t i = 0; i < count; ++i)
+        {
+            words[i] = DataStoreBinaryFormat::DecodeFixed(data + i * 8, 8);
+        }
+        return(true);
+    }
+public:
+    PointSeriesStore() : blockCount_(0), rollupsEnabled_(false) {}
+
+    ~PointSeriesStore()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        for (size_t i = 0; i < chunks_.size(); ++i)
+        {
+            delete [] chunks_[i];
+        }
+        for (size_t i = 0; i < rollupChunks_.size(); ++i)
+        {
+            delete [] rollupChunks_[i];
+        }
+        chunks_.clear();
+        rollupChunks_.clear();
+        blocks_.clear();
+        series_.clear();
+        blockCount_ = 0;
+    }
+
+    //Keeps the rollup tiers of every day from now on, built here for the days already stored.  Stays
+    //on through Clear and Load
+    void EnableRollups()
+    {
+        if (rollupsEnabled_)return;
+        rollupsEnabled_ = true;
+        for (size_t i = 0; i < chunks_.size(); ++i)
+        {
+            rollupChunks_.push_back(new RollupBlock[BlocksPerChunk]);
+        }
+        for (size_t i = 0; i < blockCount_; ++i)
+        {
+            buildRollups(blockAt(i), rollupAt(i));
+        }
+    }
+
+    void DisableRollups()
+    {
+        for (size_t i = 0; i < rollupChunks_.size(); ++i)
+        {
+            delete [] rollupChunks_[i];
+        }
+        rollupChunks_.clear();
+        rollupsEnabled_ = false;
+    }
+
+    bool HasRollups() const
+    {
+        return(rollupsEnabled_);
+    }
+
+    //Start of the day holding the timestamp
+    static boost::int64_t DayStart(boost::int64_t timestamp)
+    {
+        return(floorDiv(timestamp, MsPerDay) * MsPerDay);
+    }
+
+    //Replaces any value already at the minute
+    bool SetValue(boost::int64_t site, boost::int64_t point, boost::int64_t timestamp, double value)
+    {
+        boost::int64_t day = floorDiv(timestamp, MsPerDay);
+        size_t minute = static_cast<size_t>((timestamp - day * MsPerDay) / MsPerMinute);
+        size_t idx = 0;
+        if (!findBlock(site, point, day, idx))idx = newBlock(site, point, day);
+        DayBlock* block = blockAt(idx);
+        bool replaced = block->HasValue(minute);
+        block->values_[minute] = value;
+        block->present_[minute / 64] |= boost::uint64_t(1) << (minute % 64);
+        RollupBlock* rollup = rollupAt(idx);
+        if (rollup == nullptr)return(true);
+        //A new value only adds to its buckets; a replaced one may have been a bucket's min or max
+        if (replaced)
+        {
+            refreshRollups(block, minute, rollup);
+            return(true);
+        }
+        rollup->fiveMinutes_[minute / 5].Add(value);
+        rollup->hours_[minute / 60].Add(value);
+        rollup->day_.Add(value);
+        return(true);
+    }
+
+    //False if the minute holds no value; the day block stays even when it empties
+    bool ClearValue(boost::int64_t site, boost::int64_t point, boost::int64_t timestamp)
+    {
+        boost::int64_t day = floorDiv(timestamp, MsPerDay);
+        size_t minute = static_cast<size_t>((timestamp - day * MsPerDay) / MsPerMinute);
+        size_t idx = 0;
+        if (!findBlock(site, point, day, idx) || !blockAt(idx)->HasValue(minute))return(false);
+        DayBlock* block = blockAt(idx);
+        block->values_[minute] = 0;
+        block->present_[minute / 64] &= ~(boost::uint64_t(1) << (minute % 64));
+        if (rollupAt(idx) != nullptr)refreshRollups(block, minute, rollupAt(idx));
+        return(true);
+    }
+
+    bool GetValue(boost::int64_t site, boost::int64_t point, boost::int64_t timestamp, double& value) const
+    {
+        boost::int64_t day = floorDiv(timestamp, MsPerDay);
+        size_t minute = static_cast<size_t>((timestamp - day * MsPerDay) / MsPerMinute);
+        const DayBlock* block = findBlock(site, point, day);
+        if (block == nullptr || !block->HasValue(minute))return(false);
+        value = block->values_[minute];
+        return(true);
+    }
+
+    //Block of the day holding the timestamp, null if the point has no values that day
+    const DayBlock* GetDay(boost::int64_t site, boost::int64_t point, boost::int64_t timestamp) const
+    {
+        return(findBlock(site, point, floorDiv(timestamp, MsPerDay)));
+    }
+
+    //Appends the samples with from <= timestamp < to in time order, returns how many were added
+    size_t GetRange(boost::int64_t site, boost::int64_t point, boost::int64_t from, boost::int64_t to, std::vector<Sample>& samples) const
+    {
+        SeriesMap::const_iterator sFind = series_.find(SeriesId(site, point));
+        if (sFind == series_.end() || from >= to)return(0);
+        size_t added = 0;
+        boost::int64_t firstDay = floorDiv(from, MsPerDay);
+        boost::int64_t lastDay = floorDiv(to - 1, MsPerDay);
+        const std::set<boost::int64_t>& days = sFind->second;
+        for (std::set<boost::int64_t>::const_iterator dIter = days.lower_bound(firstDay); dIter != days.end() && *dIter <= lastDay; ++dIter)
+        {
+            const DayBlock* block = findBlock(site, point, *dIter);
+            boost::int64_t dayStart = *dIter * MsPerDay;
+            //Minutes [first, end) of this day fall in the range
+            size_t first = (*dIter == firstDay) ? static_cast<size_t>((from - dayStart + MsPerMinute - 1) / MsPerMinute) : 0;
+            size_t end = (*dIter == lastDay) ? static_cast<size_t>((to - dayStart + MsPerMinute - 1) / MsPerMinute) : MinutesPerDay;
+            for (size_t minute = first; minute < end; ++minute)
+            {
+                boost::uint64_t word = block->present_[minute / 64];
+                if (word == 0)
+                {
+                    //Skip to the next word
+                    minute |= 63;
+                    continue;
+                }
+                if (!((word >> (minute % 64)) & 1))continue;
+                Sample sample;
+                sample.timestamp_ = dayStart + static_cast<boost::int64_t>(minute) * MsPerMinute;
+                sample.value_ = block->values_[minute];
+                samples.push_back(sample);
+                ++added;
+            }
+        }
+        return(added);
+    }
+
+    static boost::int64_t GetTierWidth(RollupTier tier)
+    {
+        static const boost::int64_t widths[] = { MsPerMinute, 5 * MsPerMinute, 60 * MsPerMinute, MsPerDay };
+        return(widths[tier]);
+    }
+
+    //Coarsest tier no wider than the resolution; below five minutes the minutes themselves
+    static RollupTier GetTierFor(boost::int64_t resolution)
+    {
+        if (resolution >= MsPerDay)return(ROLLUP_DAY);
+        if (resolution >= 60 * MsPerMinute)return(ROLLUP_HOUR);
+        if (resolution >= 5 * MsPerMinute)return(ROLLUP_5_MINUTES);
+        return(ROLLUP_MINUTE);
+    }
+
+    //Appends the non empty buckets of the tier that start in [from, to), in time order.  Without
+    //EnableRollups the buckets are computed from the minutes; returns how many were added
+    size_t GetRollups(boost::int64_t site, boost::int64_t point, boost::int64_t from, boost::int64_t to, RollupTier tier, std::vector<Bucket>& buckets) const
+    {
+        SeriesMap::const_iterator sFind = series_.find(SeriesId(site, point));
+        if (sFind == series_.end() || from >= to)return(0);
+        boost::int64_t width = GetTierWidth(tier);
+        size_t bucketMinutes = static_cast<size_t>(width / MsPerMinute);
+        size_t added = 0;
+        const std::set<boost::int64_t>& days = sFind->second;
+        for (std::set<boost::int64_t>::const_iterator dIter = days.lower_bound(floorDiv(from, MsPerDay)); dIter != days.end() && *dIter <= floorDiv(to - 1, MsPerDay); ++dIter)
+        {
+            size_t idx = 0;
+            findBlock(site, point, *dIter, idx);
+            const DayBlock* block = blockAt(idx);
+            const RollupBlock* rollup = rollupAt(idx);
+            boost::int64_t dayStart = *dIter * MsPerDay;
+            for (size_t b = 0; b < MinutesPerDay / bucketMinutes; ++b)
+            {
+                boost::int64_t start = dayStart + static_cast<boost::int64_t>(b) * width;
+                if (start < from)continue;
+                if (start >= to)break;
+                Aggregate aggregate;
+                if (rollup != nullptr && tier == ROLLUP_DAY)aggregate = rollup->day_;
+                else if (rollup != nullptr && tier == ROLLUP_HOUR)aggregate = rollup->hours_[b];
+                else if (rollup != nullptr && tier == ROLLUP_5_MINUTES)aggregate = rollup->fiveMinutes_[b];
+                else aggregate = rawAggregate(block, b * bucketMinutes, bucketMinutes);
+                if (aggregate.count_ == 0)continue;
+                Bucket bucket;
+                bucket.timestamp_ = start;
+                bucket.width_ = width;
+                bucket.count_ = aggregate.count_;
+                bucket.sum_ = aggregate.sum_;
+                bucket.min_ = aggregate.min_;
+                bucket.max_ = aggregate.max_;
+                buckets.push_back(bucket);
+                ++added;
+            }
+        }
+        return(added);
+    }
+
+    //Buckets of the coarsest tier that still resolves the requested resolution in milliseconds
+    size_t GetRollups(boost::int64_t site, boost::int64_t point, boost::int64_t from, boost::int64_t to, boost::int64_t resolution, std::vector<Bucket>& buckets) const
+    {
+        return(GetRollups(site, point, from, to, GetTierFor(resolution), buckets));
+    }
+
+    void GetSeries(std::vector<SeriesId>& series) const
+    {
+        for (SeriesMap::const_iterator sIter = series_.begin(); sIter != series_.end(); ++sIter)
+        {
+            series.push_back(sIter->first);
+        }
+    }
+
+    //Appends the start of every day the point has a block for, in order
+    void GetDays(boost::int64_t site, boost::int64_t point, std::vector<boost::int64_t>& dayStarts) const
+    {
+        SeriesMap::const_iterator sFind = series_.find(SeriesId(site, point));
+        if (sFind == series_.end())return;
+        for (std::set<boost::int64_t>::const_iterator dIter = sFind->second.begin(); dIter != sFind->second.end(); ++dIter)
+        {
+            dayStarts.push_back(*dIter * MsPerDay);
+        }
+    }
+
+    size_t GetNumberDays() const
+    {
+        return(blockCount_);
+    }
+
+    //One record per day block, by series and day: site, point, day (timestamp) and series, the
+    //samples of the day in DataStoreSeriesCodec form
+    bool Save(const rct::UTF8String& fileName, DataStore::StorageFormat format = DataStore::DATASTORE_FORMAT_BINARY) const
+    {
+        DataStore store(L"points");
+        DataStoreSchema::ColumnId siteId = store.GetSchema()->Intern(L"site");
+        DataStoreSchema::ColumnId pointId = store.GetSchema()->Intern(L"point");
+        DataStoreSchema::ColumnId dayId = store.GetSchema()->Intern(L"day");
+        DataStoreSchema::ColumnId seriesId = store.GetSchema()->Intern(L"series");
+        std::vector<DataStore::DataStoreRecord*> records;
+        store.CreateRecords(0, static_cast<DataStore::IndexType>(blockCount_), records);
+        DataStoreSeriesEncoder encoder;
+        std::vector<unsigned char> bytes;
+        size_t row = 0;
+        for (SeriesMap::const_iterator sIter = series_.begin(); sIter != series_.end(); ++sIter)
+        {
+            for (std::set<boost::int64_t>::const_iterator dIter = sIter->second.begin(); dIter != sIter->second.end(); ++dIter)
+            {
+                const DayBlock* block = findBlock(sIter->first.site_, sIter->first.point_, *dIter);
+                DataStore::DataStoreRecord* record = records[row++];
+                boost::int64_t dayStart = *dIter * MsPerDay;
+                record->AddInt64Column(siteId, sIter->first.site_);
+                record->AddInt64Column(pointId, sIter->first.point_);
+                record->AddTimestampColumn(dayId, dayStart);
+                for (size_t minute = 0; minute < MinutesPerDay; ++minute)
+                {
+                    if (block->HasValue(minute))encoder.Append(dayStart + static_cast<boost::int64_t>(minute) * MsPerMinute, block->values_[minute]);
+                }
+                encoder.Finish(bytes);
+                record->AddColumn(seriesId, static_cast<rct::Object<>::UnknownObjValType>(&bytes[0]), static_cast<rct::Object<>::UnknownObjSizeType>(bytes.size()));
+            }
+        }
+        if (!store.AddDataRecords(records))return(false);
+        return(store.Save(fileName, format));
+    }
+
+    //Replaces the contents with a file written by Save.  Files from before the series column keep
+    //every minute raw in values and present columns (little endian 8 byte words) and load as well
+    bool Load(const rct::UTF8String& fileName)
+    {
+        Clear();
+        DataStore store(L"points");
+        if (!store.Load(fileName))return(false);
+        DataStoreSchema::ColumnId siteId, pointId, dayId, seriesId, valuesId, presentId;
+        if (store.GetNumberRecords() == 0)return(true);
+        if (!store.GetColumnId(L"site", siteId) || !store.GetColumnId(L"point", pointId) || !store.GetColumnId(L"day", dayId))return(false);
+        bool encoded = store.GetColumnId(L"series", seriesId);
+        if (!encoded && (!store.GetColumnId(L"values", valuesId) || !store.GetColumnId(L"present", presentId)))return(false);
+        boost::uint64_t bits[MinutesPerDay];
+        DataStoreSeriesDecoder decoder;
+        for (DataStore::IndexType row = 0; row < store.GetNumberRecords(); ++row)
+        {
+            DataStore::DataStoreRecord* record = nullptr;
+            boost::int64_t site, point, dayStart;
+            if (!store.GetDataRecord(row, &record) || !record->GetInt64Column(siteId, site) || !record->GetInt64Column(pointId, point) ||
+                !record->GetTimestampColumn(dayId, dayStart) || dayStart % MsPerDay != 0 || findBlock(site, point, dayStart / MsPerDay) != nullptr)
+            {
+                Clear();
+                return(false);
+            }
+            size_t idx = newBlock(site, point, dayStart / MsPerDay);
+            DayBlock* block = blockAt(idx);
+            bool loaded = false;
+            if (encoded)
+            {
+                DataStore::DataStoreRecord::RecordResult result(nullptr);
+                loaded = record->GetColumnType(seriesId) == DATASTORE_VALUE_BYTES && record->GetColumn(seriesId, std::move(result)) &&
+                    decoder.Open(static_cast<const unsigned char*>(result.GetObjectData()), result.GetObjectSize());
+                boost::int64_t timestamp = 0;
+                double value = 0;
+                for (size_t i = 0; loaded && i < decoder.GetNumberSamples(); ++i)
+                {
+                    loaded = decoder.Next(timestamp, value) && timestamp >= dayStart && timestamp < dayStart + MsPerDay;
+                    if (!loaded)break;
+                    size_t minute = static_cast<size_t>((timestamp - dayStart) / MsPerMinute);
+                    block->values_[minute] = value;
+                    block->present_[minute / 64] |= boost::uint64_t(1) << (minute % 64);
+                }
+            }
+            else if (decodeWords(record, valuesId, MinutesPerDay, bits) && decodeWords(record, presentId, PresenceWords, block->present_))
+            {
+                for (size_t i = 0; i < MinutesPerDay; ++i)block->values_[i] = DataStoreBinaryFormat::BitsToDouble(bits[i]);
+                loaded = true;
+            }
+            if (!loaded)
+            {
+                Clear();
+                return(false);
+            }
+            if (rollupsEnabled_)buildRollups(block, rollupAt(idx));
+        }
+        return(true);
+    }
+};
+
+} //namespace rct
+
+#endif //POINT_SERIES_STORE_H_
@@ -0,0 +1,234 @@
+#ifndef SHARDED_DATA_STORE_H_
+#define SHARDED_DATA_STORE_H_
+
+#include "DataStore.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+
+namespace rct {
+
+//!  Sharded Data Store
+/*!
+ * Partitions records by record id across a fixed set of DataStores, one
+ * file per shard.  Hash partitioning spreads ids evenly over N shards;
+ * range partitioning gives shard i the ids below bounds[i] not claimed by
+ * an earlier shard, and the last shard everything else.  Load and Save run
+ * the shards in parallel, and single shards can be saved or reloaded on
+ * their own.  The partition function decides which file a record lives in,
+ * so it must stay the same for a set of shard files.
+ */
+class ShardedDataStore
+{
+public:
+    typedef DataStore::IndexType IndexType;
+    typedef DataStore::DataStr DataStr;
+
+    typedef enum PartitionKind
+    {
+        PARTITION_HASH,
+        PARTITION_RANGE
+    };
+private:
+    typedef std::unordered_map<IndexType, IndexType> RowMap;
+private:
+    PartitionKind kind_;
+    std::vector<IndexType> bounds_;
+    std::vector<DataStore*> shards_;
+    //Record id to row within the owning shard
+    std::vector<RowMap> rowsById_;
+    unsigned int ioThreads_;
+private:
+    ShardedDataStore(const ShardedDataStore& rhs);
+    void operator=(const ShardedDataStore& rhs);
+
+    void createShards(const DataStr& name, size_t shardCount)
+    {
+        if (shardCount == 0)shardCount = 1;
+        for (size_t i = 0; i < shardCount; ++i)
+        {
+            shards_.push_back(new DataStore(name + rct::UTF8String(boost::str(boost::format(".%d") % i)).str()));
+        }
+        rowsById_.resize(shardCount);
+        SetThreadCount(0);
+    }
+
+    //Fixed 64 bit finalizer - shard files depend on it, so it must never change
+    static boost::uint64_t mixId(boost::uint64_t id)
+    {
+        id ^= id >> 33;
+        id *= 0xff51afd7ed558ccdULL;
+        id ^= id >> 33;
+        id *= 0xc4ceb9fe1a85ec53ULL;
+        id ^= id >> 33;
+        return(id);
+    }
+
+    bool indexShard(size_t idx)
+    {
+        RowMap& rows = rowsById_[idx];
+        rows.clear();
+        //Ids only, so a lazily loaded shard is not parsed just to be indexed
+        IndexType id = 0;
+        for (IndexType row = 0; shards_[idx]->GetRecordId(row, id); ++row)
+        {
+            //Records filed under the wrong shard mean the files were written with another partitioning
+            if (GetShardFor(id) != idx || !rows.insert(std::make_pair(id, row)).second)return(false);
+        }
+        return(true);
+    }
+
+    bool loadShard(const rct::UTF8String* baseName, DataStore::StorageFormat format, size_t idx)
+    {
+        rowsById_[idx].clear();
+        if (!shards_[idx]->Load(ShardFileName(*baseName, idx), format))return(false);
+        return(this->indexShard(idx));
+    }
+
+    bool saveShard(const rct::UTF8String* baseName, DataStore::StorageFormat format, size_t idx)
+    {
+        return(shards_[idx]->Save(ShardFileName(*baseName, idx), format));
+    }
+public:
+    //Hash partitioning over shardCount shards
+    ShardedDataStore(const DataStr& name, size_t shardCount) :
+        kind_(PARTITION_HASH),
+        ioThreads_(0)
+    {
+        createShards(name, shardCount);
+    }
+
+    //Range partitioning; bounds must be ascending and give bounds.size() + 1 shards
+    ShardedDataStore(const DataStr& name, const std::vector<IndexType>& bounds) :
+        kind_(PARTITION_RANGE),
+        bounds_(bounds),
+        ioThreads_(0)
+    {
+        std::sort(bounds_.begin(), bounds_.end());
+        createShards(name, bounds_.size() + 1);
+    }
+
+    ~ShardedDataStore()
+    {
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            delete shards_[i];
+        }
+    }
+
+    //File of one shard, e.g. store.bin.3
+    static rct::UTF8String ShardFileName(const rct::UTF8String& baseName, size_t idx)
+    {
+        return(rct::UTF8String(baseName.nstr() + boost::str(boost::format(".%d") % idx)));
+    }
+
+    PartitionKind GetPartitionKind() const
+    {
+        return(kind_);
+    }
+
+    size_t GetShardCount() const
+    {
+        return(shards_.size());
+    }
+
+    size_t GetShardFor(IndexType recordId) const
+    {
+        if (kind_ == PARTITION_RANGE)
+        {
+            return(std::upper_bound(bounds_.begin(), bounds_.end(), recordId) - bounds_.begin());
+        }
+        return(static_cast<size_t>(mixId(recordId) % shards_.size()));
+    }
+
+    //Direct access for per shard work; rows of a shard are that shard's own row ids
+    DataStore* GetShard(size_t idx)
+    {
+        return((idx < shards_.size()) ? shards_[idx] : nullptr);
+    }
+
+    //Shards run in parallel; the threads left over are split between the shards' own Load and Save
+    void SetThreadCount(unsigned int threadCount)
+    {
+        ioThreads_ = threadCount;
+        unsigned int threads = (threadCount == 0) ? WorkerPool::DefaultThreadCount() : threadCount;
+        unsigned int perShard = std::max(1u, threads / static_cast<unsigned int>(shards_.size()));
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            shards_[i]->SetThreadCount(perShard);
+        }
+    }
+
+    //Created in the owning shard's arena - add it with AddDataRecord, do not delete it
+    DataStore::DataStoreRecord* CreateRecord(IndexType id)
+    {
+        return(shards_[GetShardFor(id)]->CreateRecord(id));
+    }
+
+    //Routes the record to its shard by record id; ids are unique across the store
+    bool AddDataRecord(DataStore::DataStoreRecord* record)
+    {
+        if (record == nullptr)return(false);
+        size_t idx = GetShardFor(record->GetId());
+        RowMap& rows = rowsById_[idx];
+        if (rows.find(record->GetId()) != rows.end())return(false);
+        IndexType row = shards_[idx]->GetNumberRecords();
+        if (!shards_[idx]->AddDataRecord(record))return(false);
+        rows.insert(std::make_pair(record->GetId(), row));
+        return(true);
+    }
+
+    //Looks a record up by record id in the shard that owns it
+    bool GetDataRecord(IndexType recordId, DataStore::DataStoreRecord** record)
+    {
+        size_t idx = GetShardFor(recordId);
+        RowMap::const_iterator rFind = rowsById_[idx].find(recordId);
+        if (rFind == rowsById_[idx].end())return(false);
+        return(shards_[idx]->GetDataRecord(rFind->second, record));
+    }
+
+    IndexType GetNumberRecords() const
+    {
+        IndexType rt = 0;
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            rt += shards_[i]->GetNumberRecords();
+        }
+        return(rt);
+    }
+
+    //Writes baseName.0 .. baseName.N-1 in parallel
+    bool Save(const rct::UTF8String& baseName, DataStore::StorageFormat format = DataStore::DATASTORE_FORMAT_BINARY)
+    {
+        return(WorkerPool::ParallelFor(shards_.size(), ioThreads_,
+            boost::bind(&ShardedDataStore::saveShard, this, &baseName, format, _1)));
+    }
+
+    //Loads every shard file in parallel; fails if a file holds records of another shard
+    bool Load(const rct::UTF8String& baseName, DataStore::StorageFormat format = DataStore::DATASTORE_FORMAT_AUTO)
+    {
+        return(WorkerPool::ParallelFor(shards_.size(), ioThreads_,
+            boost::bind(&ShardedDataStore::loadShard, this, &baseName, format, _1)));
+    }
+
+    //Rebuilds one shard from its file while the others stay as they are
+    bool LoadShard(size_t idx, const rct::UTF8String& baseName, DataStore::StorageFormat format = DataStore::DATASTORE_FORMAT_AUTO)
+    {
+        if (idx >= shards_.size())return(false);
+        return(this->loadShard(&baseName, format, idx));
+    }
+
+    bool SaveShard(size_t idx, const rct::UTF8String& baseName, DataStore::StorageFormat format = DataStore::DATASTORE_FORMAT_BINARY)
+    {
+        if (idx >= shards_.size())return(false);
+        return(this->saveShard(&baseName, format, idx));
+    }
+};
+
+} //namespace rct
+
+#endif //SHARDED_DATA_STORE_H_
@@ -0,0 +1,234 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+
+namespace rct {
+
+//!  Worker Pool
+/*!
+ * Runs a numbered set of tasks across the calling thread and helper threads
+ * of one process wide pool.  Pool threads are started the first time a
+ * call needs them, grow to the largest thread count asked for, and then
+ * wait for the next call instead of exiting, so a call costs a wake up
+ * rather than a thread start.  Tasks are claimed one at a time from a
+ * shared counter so uneven tasks balance out.  A task fails by returning
+ * false or throwing; the remaining tasks still run and ParallelFor reports
+ * the failure.  ParallelForWorkers gives each worker a contiguous run of
+ * tasks of its own and tells the task which worker runs it, so workers can
+ * keep per worker state without locking; a worker done with its run steals
+ * from the others.  The calling thread works through the tasks itself and
+ * only waits for helpers that joined, so a call made from inside a task
+ * still finishes when every pool thread is busy, just with fewer helpers.
+ */
+class WorkerPool
+{
+public:
+    typedef boost::function<bool (size_t)> TaskFunction;
+    //Called with the worker index, below the thread count, and the task index
+    typedef boost::function<bool (unsigned int, size_t)> WorkerTaskFunction;
+private:
+    typedef boost::function<void (unsigned int)> WorkerBody;
+
+    //One call waiting for helpers; helpers are worker 1 and up, the caller is worker zero
+    struct Job
+    {
+        WorkerBody body_;
+        //Helpers that may still join
+        unsigned int open_;
+        unsigned int joined_;
+        unsigned int running_;
+        boost::condition_variable finished_;
+    };
+
+    //Tasks [next_, end_) not yet claimed by anyone; padded so workers do not share a cache line
+    struct TaskRange
+    {
+        boost::atomic<size_t> next_;
+        size_t end_;
+        char padding_[64];
+    };
+
+    boost::mutex lock_;
+    boost::condition_variable wake_;
+    std::deque<Job*> jobs_;
+    boost::thread_group threads_;
+    unsigned int threadCount_;
+    bool stopping_;
+private:
+    WorkerPool() : threadCount_(0), stopping_(false) {}
+
+    ~WorkerPool()
+    {
+        {
+            boost::lock_guard<boost::mutex> guard(lock_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        threads_.join_all();
+    }
+
+    WorkerPool(const WorkerPool& rhs);
+    void operator=(const WorkerPool& rhs);
+
+    static WorkerPool& shared()
+    {
+        static WorkerPool pool;
+        return(pool);
+    }
+
+    void threadMain()
+    {
+        boost::unique_lock<boost::mutex> guard(lock_);
+        for (;;)
+        {
+            while (jobs_.empty() && !stopping_)wake_.wait(guard);
+            if (jobs_.empty())return;
+            Job* job = jobs_.front();
+            unsigned int worker = ++job->joined_;
+            ++job->running_;
+            if (--job->open_ == 0)jobs_.pop_front();
+            guard.unlock();
+            job->body_(worker);
+            guard.lock();
+            if (--job->running_ == 0)job->finished_.notify_all();
+        }
+    }
+
+    //Runs the body on the calling thread as worker zero and on up to helpers pool threads
+    void run(unsigned int helpers, const WorkerBody& body)
+    {
+        Job job;
+        job.body_ = body;
+        job.open_ = helpers;
+        job.joined_ = 0;
+        job.running_ = 0;
+        {
+            boost::lock_guard<boost::mutex> guard(lock_);
+            for (; threadCount_ < helpers; ++threadCount_)
+            {
+                threads_.create_thread(boost::bind(&WorkerPool::threadMain, this));
+            }
+            jobs_.push_back(&job);
+        }
+        wake_.notify_all();
+        body(0);
+        boost::unique_lock<boost::mutex> guard(lock_);
+        //Helpers that have not joined by now are not needed
+        if (job.open_ > 0)
+        {
+            std::deque<Job*>::iterator jFind = std::find(jobs_.begin(), jobs_.end(), &job);
+            if (jFind != jobs_.end())jobs_.erase(jFind);
+        }
+        while (job.running_ > 0)job.finished_.wait(guard);
+    }
+
+    static bool runTask(const WorkerTaskFunction* task, unsigned int worker, size_t taskIdx)
+    {
+        try
+        {
+            return((*task)(worker, taskIdx));
+        }
+        catch(std::exception& rEx)
+        {
+            return(false);
+        }
+        catch(...)
+        {
+            return(false);
+        }
+    }
+
+    static void runWorker(TaskRange* ranges, unsigned int workerCount, unsigned int worker, boost::atomic<bool>* failed, const WorkerTaskFunction* task)
+    {
+        //Own run first, then the other runs starting with the next worker's
+        for (unsigned int i = 0; i < workerCount; ++i)
+        {
+            TaskRange& range = ranges[(worker + i) % workerCount];
+            for (;;)
+            {
+                size_t taskIdx = range.next_.fetch_add(1);
+                if (taskIdx >= range.end_)break;
+                if (!runTask(task, worker, taskIdx))failed->store(true);
+            }
+        }
+    }
+
+    static void runTasks(boost::atomic<size_t>* nextTask, size_t taskCount, boost::atomic<bool>* failed, const TaskFunction* task)
+    {
+        for (;;)
+        {
+            size_t taskIdx = nextTask->fetch_add(1);
+            if (taskIdx >= taskCount)break;
+            try
+            {
+                if (!(*task)(taskIdx))failed->store(true);
+            }
+            catch(std::exception& rEx)
+            {
+                failed->store(true);
+            }
+            catch(...)
+            {
+                failed->store(true);
+            }
+        }
+    }
+public:
+    static unsigned int DefaultThreadCount()
+    {
+        unsigned int hwThreads = boost::thread::hardware_concurrency();
+        return((hwThreads == 0) ? 1 : hwThreads);
+    }
+
+    //A thread count of zero uses every hardware thread
+    static bool ParallelFor(size_t taskCount, unsigned int threadCount, const TaskFunction& task)
+    {
+        if (taskCount == 0)return(true);
+        if (threadCount == 0)threadCount = DefaultThreadCount();
+        if (threadCount > taskCount)threadCount = static_cast<unsigned int>(taskCount);
+        boost::atomic<size_t> nextTask(0);
+        boost::atomic<bool> failed(false);
+        if (threadCount <= 1)runTasks(&nextTask, taskCount, &failed, &task);
+        else shared().run(threadCount - 1, boost::bind(&WorkerPool::runTasks, &nextTask, taskCount, &failed, &task));
+        return(!failed.load());
+    }
+
+    //Workers, the calling thread included, ParallelFor and ParallelForWorkers use for the tasks
+    static unsigned int GetWorkerCount(size_t taskCount, unsigned int threadCount)
+    {
+        if (threadCount == 0)threadCount = DefaultThreadCount();
+        if (threadCount > taskCount)threadCount = static_cast<unsigned int>(taskCount);
+        return((threadCount == 0) ? 1 : threadCount);
+    }
+
+    //The calling thread is worker zero
+    static bool ParallelForWorkers(size_t taskCount, unsigned int threadCount, const WorkerTaskFunction& task)
+    {
+        if (taskCount == 0)return(true);
+        unsigned int workerCount = GetWorkerCount(taskCount, threadCount);
+        TaskRange* ranges = new TaskRange[workerCount];
+        for (unsigned int i = 0; i < workerCount; ++i)
+        {
+            ranges[i].next_.store(taskCount * i / workerCount);
+            ranges[i].end_ = taskCount * (i + 1) / workerCount;
+        }
+        boost::atomic<bool> failed(false);
+        if (workerCount == 1)runWorker(ranges, workerCount, 0, &failed, &task);
+        else shared().run(workerCount - 1, boost::bind(&WorkerPool::runWorker, ranges, workerCount, _1, &failed, &task));
+        delete [] ranges;
+        return(!failed.load());
+    }
+};
+
+} //namespace rct
+
+#endif //WORKER_POOL_H_
@@ -0,0 +1,156 @@
+//!  Hex Bench
+/*!
+ * Times the DataStoreHex codec against the CryptoPP HexEncoder/HexDecoder
+ * path the text format used before, and checks that both give the same
+ * digits and decode back to the same bytes.  Built without -msse2 on
+ * 32 bit x86 it times the scalar loop instead.
+ *
+ *   g++ -std=c++11 -O2 -I.. -I/usr/include/cryptopp HexBench.cpp -o HexBench -lcryptopp -lboost_chrono -lboost_system
+ */
+#include "DataStoreHex.h"
+#include <hex.h>
+#include <filters.h>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <cstdio>
+#include <boost/chrono.hpp>
+
+using namespace rct;
+
+namespace {
+
+const size_t TotalBytes = 64 * 1024 * 1024;
+
+int failures = 0;
+
+void check(bool passed, const char* what)
+{
+    if (passed)return;
+    std::printf("FAILED: %s\n", what);
+    ++failures;
+}
+
+double secondsSince(const boost::chrono::steady_clock::time_point& start)
+{
+    return(boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count());
+}
+
+double megabytesPerSecond(size_t bytes, double seconds)
+{
+    return(seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0);
+}
+
+//The old OutputToStream path: one encoder per column writing into a string sink
+void cryptoEncode(const unsigned char* data, size_t size, std::string& hex)
+{
+    hex.clear();
+    CryptoPP::HexEncoder hexEncoder;
+    hexEncoder.Attach(new CryptoPP::StringSink(hex));
+    hexEncoder.Put(data, size, true);
+    hexEncoder.MessageEnd();
+}
+
+//The old InputFromStream path: two digits at a time into the decoder
+void cryptoDecode(const std::string& hex, std::string& bytes)
+{
+    bytes.clear();
+    CryptoPP::HexDecoder hexDecoder;
+    hexDecoder.Attach(new CryptoPP::StringSink(bytes));
+    unsigned char buffer[2];
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    {
+        buffer[0] = static_cast<unsigned char>(hex[i]);
+        buffer[1] = static_cast<unsigned char>(hex[i + 1]);
+        hexDecoder.Put(buffer, 2);
+    }
+    hexDecoder.MessageEnd();
+}
+
+//Object sizes cover the scalar tail alone, a tail after SSE2 blocks and long runs
+void runSize(size_t objectSize)
+{
+    size_t objectCount = TotalBytes / objectSize;
+    std::vector<unsigned char> data(objectSize * objectCount);
+    for (size_t i = 0; i < data.size(); ++i)data[i] = static_cast<unsigned char>(std::rand());
+
+    std::string cryptoHex;
+    std::string cryptoBytes;
+    std::vector<char> hex(objectSize * 2);
+    std::vector<wchar_t> wideHex(objectSize * 2);
+    std::vector<unsigned char> bytes(objectSize);
+    bool sameHex = true;
+    bool sameWideHex = true;
+    bool sameBytes = true;
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const unsigned char* object = &data[i * objectSize];
+        cryptoEncode(object, objectSize, cryptoHex);
+        DataStoreHex::Encode(object, objectSize, &hex[0]);
+        DataStoreHex::Encode(object, objectSize, &wideHex[0]);
+        sameHex = sameHex && cryptoHex == std::string(hex.begin(), hex.end());
+        sameWideHex = sameWideHex && std::wstring(cryptoHex.begin(), cryptoHex.end()) == std::wstring(wideHex.begin(), wideHex.end());
+        cryptoDecode(cryptoHex, cryptoBytes);
+        sameBytes = sameBytes && DataStoreHex::Decode(&hex[0], objectSize, &bytes[0]);
+        sameBytes = sameBytes && cryptoBytes.size() == objectSize && std::memcmp(&bytes[0], cryptoBytes.data(), objectSize) == 0;
+        sameBytes = sameBytes && std::memcmp(&bytes[0], object, objectSize) == 0;
+    }
+    check(sameHex, "DataStoreHex digits match CryptoPP");
+    check(sameWideHex, "DataStoreHex wide digits match CryptoPP");
+    check(sameBytes, "both decoders return the original bytes");
+
+    //Lower case digits decode the same way
+    std::string lowerHex(cryptoHex);
+    for (size_t i = 0; i < lowerHex.size(); ++i)lowerHex[i] = static_cast<char>(std::tolower(lowerHex[i]));
+    cryptoDecode(lowerHex, cryptoBytes);
+    check(DataStoreHex::Decode(lowerHex.data(), objectSize, &bytes[0]) &&
+        cryptoBytes.size() == objectSize && std::memcmp(&bytes[0], cryptoBytes.data(), objectSize) == 0, "lower case digits decode like CryptoPP");
+
+    boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    for (size_t i = 0; i < objectCount; ++i)cryptoEncode(&data[i * objectSize], objectSize, cryptoHex);
+    double cryptoEncodeSecs = secondsSince(start);
+    start = boost::chrono::steady_clock::now();
+    for (size_t i = 0; i < objectCount; ++i)DataStoreHex::Encode(&data[i * objectSize], objectSize, &wideHex[0]);
+    double encodeSecs = secondsSince(start);
+
+    std::string allHex;
+    cryptoEncode(&data[0], data.size(), allHex);
+    start = boost::chrono::steady_clock::now();
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        cryptoDecode(allHex.substr(i * objectSize * 2, objectSize * 2), cryptoBytes);
+    }
+    double cryptoDecodeSecs = secondsSince(start);
+    std::wstring allWideHex(allHex.begin(), allHex.end());
+    bool decoded = true;
+    start = boost::chrono::steady_clock::now();
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        decoded = DataStoreHex::Decode(allWideHex.data() + i * objectSize * 2, objectSize, &bytes[0]) && decoded;
+    }
+    double decodeSecs = secondsSince(start);
+    check(decoded, "timed decode succeeded");
+
+    std::printf("%7lu byte objects  encode: CryptoPP %8.1f MB/s  DataStoreHex %8.1f MB/s   decode: CryptoPP %8.1f MB/s  DataStoreHex %8.1f MB/s\n",
+        static_cast<unsigned long>(objectSize),
+        megabytesPerSecond(data.size(), cryptoEncodeSecs), megabytesPerSecond(data.size(), encodeSecs),
+        megabytesPerSecond(data.size(), cryptoDecodeSecs), megabytesPerSecond(data.size(), decodeSecs));
+}
+
+}
+
+int main()
+{
+#ifdef DATA_STORE_HEX_SSE2
+    std::printf("DataStoreHex with SSE2, %lu MB per size\n", static_cast<unsigned long>(TotalBytes >> 20));
+#else
+    std::printf("DataStoreHex scalar, %lu MB per size\n", static_cast<unsigned long>(TotalBytes >> 20));
+#endif
+    size_t sizes[] = { 7, 40, 256, 4096, 65536 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)runSize(sizes[i]);
+    if (failures == 0)std::printf("all checks passed\n");
+    return(failures == 0 ? 0 : 1);
+}